@@ -8,4 +8,5 @@ fi
 
 QUESTION="$1"
 
-echo "$QUESTION" | ./bricllm | grep -A 100 "You: " | tail -n +2 | head -n 20
+# Logs go to stderr, so stdout holds only the answer
+./bricllm --single-query "$QUESTION" --log-level warn 2>/dev/null
@@ -0,0 +1,209 @@
+// Microbenchmarks for the hot paths of a request. Each case runs a warm-up,
+// then enough iterations to fill the time budget, and reports ns/op and
+// allocations/op. Allocations are counted by wrapping malloc and friends at
+// link time (see the bench target in the Makefile).
+//
+//   make bench                 all cases
+//   ./bench/bench cache        cases whose name contains "cache"
+#include "../include/bricllm.h"
+#include "../include/chat_engine.h"
+#include "../include/catalog.h"
+#include "../include/pattern_cache.h"
+#include "../include/conversation_context.h"
+#include "../include/route_types.h"
+#include "../include/json_io.h"
+#include <stdint.h>
+#include <time.h>
+
+#define WARMUP_NS 20000000ULL       // 20ms
+#define BUDGET_NS 200000000ULL      // 200ms per case
+
+static uint64_t allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+char *__real_strdup(const char *text);
+
+void *__wrap_malloc(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+    allocations++;
+    return __real_realloc(pointer, size);
+}
+
+char *__wrap_strdup(const char *text) {
+    allocations++;
+    return __real_strdup(text);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// Keeps results alive so the compiler cannot drop the work
+static volatile uintptr_t sink;
+
+static const char *messages[] = {
+    "How do I pay my rent this month?",
+    "where can I find my maintenance requests",
+    "hello there",
+    "the kitchen tap is broken and leaking everywhere",
+    "what's the weather like today?",
+    "thanks for the help"
+};
+#define MESSAGE_COUNT (sizeof(messages) / sizeof(messages[0]))
+
+static void bench_extract_words(uint64_t i) {
+    int count;
+    char **words = extract_words(messages[i % MESSAGE_COUNT], &count);
+    for (int w = 0; w < count; w++) engine_free(words[w]);
+    engine_free(words);
+    sink = (uintptr_t)count;
+}
+
+static void bench_levenshtein(uint64_t i) {
+    sink = (uintptr_t)levenshtein_distance(i & 1 ? "maintenance" : "payments", "maintenence");
+}
+
+static void bench_similarity(uint64_t i) {
+    float similarity = calculate_similarity(messages[i % MESSAGE_COUNT], "payment");
+    sink = (uintptr_t)(similarity * 1000.0f);
+}
+
+static void bench_find_matching_pattern(uint64_t i) {
+    ResponsePattern *pattern = find_matching_pattern(messages[i % MESSAGE_COUNT], "tenant", "en", "/tenant/payments");
+    sink = (uintptr_t)pattern;
+    free_pattern(pattern);
+}
+
+static ResponsePattern cached_pattern = {
+    NULL, 0, "You can manage your rent payments through the Payments section.", "payment", NULL, NULL, 0.9f
+};
+
+static void bench_cache_lookup(uint64_t i) {
+    ResponsePattern *pattern = cache_lookup(messages[i % MESSAGE_COUNT], "tenant", "en", 1);
+    sink = (uintptr_t)pattern;
+    if (pattern) {
+        engine_free(pattern->response);
+        engine_free(pattern->category);
+        engine_free(pattern);
+    }
+}
+
+// A new scope every time, so each store writes (and evicts) an entry
+static void bench_cache_store(uint64_t i) {
+    cache_store(messages[i % MESSAGE_COUNT], "tenant", "en", 2 + i, &cached_pattern);
+}
+
+static ConversationContext *context;
+
+static void bench_resolve_pronoun(uint64_t i) {
+    TokenStream tokens;
+    tokenize_message(i & 1 ? "how do I do it?" : "where can I pay my rent", &tokens);
+    char *resolved = resolve_pronoun(context, &tokens);
+    sink = (uintptr_t)resolved;
+    engine_free(resolved);
+}
+
+static const char *routes[] = {"/tenant/payments", "/tenant/requests/42", "/tenant/unknown/page", "/tenant"};
+
+static void bench_navigation_context(uint64_t i) {
+    catalog_acquire();
+    sink = (uintptr_t)get_navigation_context(routes[i % 4], "tenant");
+    catalog_release();
+}
+
+static OutputBuffer json;
+
+static void bench_json_string(uint64_t i) {
+    buffer_reset(&json);
+    json_append_string(&json, i & 1 ? "You can manage your rent payments through the \"Payments\" section.\n"
+                                    : messages[i % MESSAGE_COUNT]);
+    sink = (uintptr_t)json.length;
+}
+
+static void bench_process_message(uint64_t i) {
+    static ChatSession *session;
+    if (!session) session = create_detached_session("bench", "tenant", "en");
+    ChatResponse *response = process_message(session, messages[i % MESSAGE_COUNT]);
+    sink = (uintptr_t)response;
+    free_response(response);
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(uint64_t iteration);
+} BenchCase;
+
+static const BenchCase cases[] = {
+    {"extract_words", bench_extract_words},
+    {"levenshtein_distance", bench_levenshtein},
+    {"calculate_similarity", bench_similarity},
+    {"find_matching_pattern", bench_find_matching_pattern},
+    {"cache_lookup", bench_cache_lookup},
+    {"cache_store", bench_cache_store},
+    {"resolve_pronoun", bench_resolve_pronoun},
+    {"get_navigation_context", bench_navigation_context},
+    {"json_append_string", bench_json_string},
+    {"process_message", bench_process_message}
+};
+
+// Runs in batches that double until the budget is spent, so the clock is
+// read rarely even for cases that take a few nanoseconds
+static void run_case(const BenchCase *bench) {
+    uint64_t iteration = 0;
+    uint64_t started = now_ns();
+    while (now_ns() - started < WARMUP_NS) {
+        for (int i = 0; i < 64; i++) bench->run(iteration++);
+    }
+
+    uint64_t iterations = 0;
+    uint64_t batch = 64;
+    uint64_t allocations_before = allocations;
+    started = now_ns();
+    uint64_t elapsed = 0;
+    while (elapsed < BUDGET_NS) {
+        for (uint64_t i = 0; i < batch; i++) bench->run(iteration++);
+        iterations += batch;
+        elapsed = now_ns() - started;
+        if (batch < (1u << 20)) batch *= 2;
+    }
+
+    printf("%-24s %12llu %12.1f %12.2f\n", bench->name, (unsigned long long)iterations,
+           (double)elapsed / (double)iterations,
+           (double)(allocations - allocations_before) / (double)iterations);
+}
+
+int main(int argc, char **argv) {
+    const char *filter = argc > 1 ? argv[1] : NULL;
+    log_runtime_level = LOG_LEVEL_OFF;
+
+    init_chat_engine();
+    context = create_conversation_context();
+    update_context(context, "payment", "the Payments section", "pay rent");
+    buffer_init(&json);
+    for (size_t i = 0; i < MESSAGE_COUNT; i++) {
+        cache_store(messages[i], "tenant", "en", 1, &cached_pattern);
+    }
+
+    printf("%-24s %12s %12s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (filter && !strstr(cases[i].name, filter)) continue;
+        run_case(&cases[i]);
+    }
+
+    buffer_free(&json);
+    free_conversation_context(context);
+    return 0;
+}
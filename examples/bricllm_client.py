@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+"""Minimal pipelining client for `bricllm --socket <path>`.
+
+Requests are newline-delimited JSON objects; every reply echoes the request's
+"id", so many requests can be in flight on one connection and replies are
+matched up as they arrive.
+
+    ./bricllm --socket /tmp/bricllm.sock &
+    python3 examples/bricllm_client.py /tmp/bricllm.sock "How do I pay rent?" "hello"
+"""
+
+import itertools
+import json
+import socket
+import sys
+import threading
+from concurrent.futures import Future
+
+
+class BricllmClient:
+    def __init__(self, path):
+        self._sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self._sock.connect(path)
+        self._ids = itertools.count(1)
+        self._pending = {}
+        self._lock = threading.Lock()
+        self._send_lock = threading.Lock()
+        self._reader = threading.Thread(target=self._read_replies, daemon=True)
+        self._reader.start()
+
+    def chat(self, message, session_id=None, role=None, lang=None, route=None):
+        """Sends one request and returns a Future for its reply payload."""
+        request_id = next(self._ids)
+        request = {"id": request_id, "message": message}
+        for key, value in (("sessionId", session_id), ("role", role), ("lang", lang), ("route", route)):
+            if value is not None:
+                request[key] = value
+
+        future = Future()
+        with self._lock:
+            self._pending[request_id] = future
+        line = (json.dumps(request) + "\n").encode()
+        with self._send_lock:
+            self._sock.sendall(line)
+        return future
+
+    def close(self):
+        self._sock.close()
+
+    def _read_replies(self):
+        for line in self._sock.makefile("rb"):
+            reply = json.loads(line)
+            with self._lock:
+                future = self._pending.pop(reply.get("id"), None)
+            if future is None:
+                continue
+            if "error" in reply:
+                future.set_exception(RuntimeError(reply["error"]))
+            else:
+                future.set_result(reply)
+
+        with self._lock:
+            pending, self._pending = self._pending, {}
+        for future in pending.values():
+            future.set_exception(ConnectionError("connection closed"))
+
+
+def main(argv):
+    if len(argv) < 3:
+        print("Usage: bricllm_client.py <socket-path> <message> [message...]")
+        return 1
+
+    client = BricllmClient(argv[1])
+    # All messages are written before any reply is read
+    futures = [client.chat(message, session_id="example-session") for message in argv[2:]]
+    for message, future in zip(argv[2:], futures):
+        reply = future.result(timeout=5)
+        print(f"Q: {message}\nA: {reply['response']} (confidence {reply['confidence']})\n")
+    client.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
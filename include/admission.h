@@ -0,0 +1,53 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include "allocator.h"
+#include "json_io.h"
+#include "request_handler.h"
+#include <stdint.h>
+
+#define ADMISSION_BUCKET_SLOTS 4096
+
+typedef struct {
+    int max_queue;          // requests waiting for or running on workers; 0 = unbounded
+    double user_rate;       // sustained requests per second per userId; 0 = unlimited
+    double user_burst;      // bucket size; defaults to max(1, 2 * user_rate)
+} AdmissionConfig;
+
+typedef struct {
+    char user_id[CHAT_REQUEST_MAX_ID + 1];
+    double tokens;
+    uint64_t refilled_ns;
+} TokenBucket;
+
+typedef struct {
+    unsigned long requests;
+    unsigned long completed;
+    unsigned long shed;         // refused because the queue was full
+    unsigned long throttled;    // refused by the user's token bucket
+    int queued;
+    int queued_peak;
+    int connections;
+    uint64_t allocations;       // engine allocations made by completed requests
+    uint64_t allocated_bytes;
+} ServerMetrics;
+
+// Owned by one IO thread; nothing here is locked.
+typedef struct {
+    AdmissionConfig config;
+    ServerMetrics metrics;
+    TokenBucket *buckets;
+} Admission;
+
+bool admission_init(Admission *admission, const AdmissionConfig *config);
+void admission_destroy(Admission *admission);
+
+// REQUEST_OK reserves a queue slot that admission_finish releases.
+// Requests without a userId are only subject to the queue bound.
+RequestStatus admission_check(Admission *admission, const ChatRequest *request, bool queued);
+// used is what the request allocated on the thread that ran it
+void admission_finish(Admission *admission, bool queued, const AllocationCount *used);
+
+void append_metrics_json(OutputBuffer *out, const char *correlation_id, const ServerMetrics *metrics);
+
+#endif // ADMISSION_H
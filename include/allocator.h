@@ -0,0 +1,37 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Everything the engine allocates while answering a request goes through
+// here, so a host can supply its own allocator and every call is counted.
+
+typedef struct {
+    void *(*allocate)(size_t size, void *context);
+    void *(*reallocate)(void *pointer, size_t size, void *context);
+    void (*release)(void *pointer, void *context);
+    void *context;
+} EngineAllocator;
+
+typedef struct {
+    uint64_t allocations;   // malloc, calloc, realloc and strdup calls
+    uint64_t bytes;         // bytes those calls asked for
+} AllocationCount;
+
+// NULL restores the C library. Install before init_chat_engine and never
+// change it afterwards: engine_free hands every pointer to the allocator
+// installed at the time of the free, whichever one allocated it.
+void set_engine_allocator(const EngineAllocator *allocator);
+
+void *engine_malloc(size_t size);
+void *engine_calloc(size_t count, size_t size);
+void *engine_realloc(void *pointer, size_t size);
+char *engine_strdup(const char *text);
+void engine_free(void *pointer);
+
+// Running totals for the calling thread; a request's cost is the difference
+// between two readings taken on the thread that ran it
+void engine_allocations(AllocationCount *count);
+
+#endif // ALLOCATOR_H
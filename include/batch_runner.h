@@ -0,0 +1,14 @@
+#ifndef BATCH_RUNNER_H
+#define BATCH_RUNNER_H
+
+typedef struct {
+    const char *input_path;   // "-" reads stdin
+    const char *output_path;  // "-" writes stdout
+    int threads;              // 0 uses every online core
+} BatchConfig;
+
+// Answers every JSONL request line across a worker pool and writes one
+// payload line per input line, in input order. Returns the exit code.
+int run_batch(const BatchConfig *config);
+
+#endif // BATCH_RUNNER_H
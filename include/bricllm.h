@@ -6,6 +6,9 @@
 #include <string.h>
 #include <time.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include "logger.h"
+#include "allocator.h"
 
 // Forward declaration
 typedef struct ConversationContext ConversationContext;
@@ -53,6 +56,16 @@ typedef struct {
     ActionAllocationType allocation_type;
 } SuggestedAction;
 
+// Wall-clock time process_message spent in each step of answering
+typedef enum {
+    STAGE_NORMALIZE,    // length check, history and tokenizing
+    STAGE_RESOLVE,      // dialog follow-ups, context fingerprint and pronoun rewrite
+    STAGE_CACHE,        // cache lookup and store
+    STAGE_MATCH,        // pattern search after a miss
+    STAGE_RENDER,       // building the reply and its actions
+    STAGE_COUNT
+} ResponseStage;
+
 typedef struct {
     char *message_id;
     char *response;
@@ -61,6 +74,7 @@ typedef struct {
     bool escalation_needed;
     SuggestedAction **suggested_actions;
     int action_count;
+    uint64_t stage_ns[STAGE_COUNT];     // CLOCK_MONOTONIC nanoseconds per ResponseStage
 } ChatResponse;
 
 ChatSession *create_session(const char *user_id, const char *role, const char *language);
@@ -70,14 +84,19 @@ void free_message(ChatMessage *message);
 ChatResponse *process_message(ChatSession *session, const char *message);
 void free_response(ChatResponse *response);
 
-ResponsePattern *find_matching_pattern(const char *message, const char *role, const char *language);
+// route, when given, narrows the search to the rules its page lists first
+ResponsePattern *find_matching_pattern(const char *message, const char *role, const char *language, const char *route);
+// How many matches the page's own rules answered alone, and how many looked beyond them
+void match_counters(uint64_t *page_answers, uint64_t *full_searches);
 float calculate_similarity(const char *str1, const char *str2);
+int levenshtein_distance(const char *str1, const char *str2);
+// Lowercased words split on whitespace; the caller frees each word and the array
+char **extract_words(const char *text, int *word_count);
+void free_pattern(ResponsePattern *pattern);
 
 ChatSession *find_session(const char *session_id);
 void cleanup_expired_sessions(void);
 
 char *generate_uuid(void);
-char *get_timestamp(void);
-void log_message(const char *level, const char *format, ...);
 
 #endif // BRICLLM_H
\ No newline at end of file
@@ -0,0 +1,92 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include "route_types.h"
+#include "json_io.h"
+#include <stdint.h>
+
+// Readers pin the active catalog for the length of a request; a reload
+// builds its replacement off to the side and swaps the pointer. The old
+// catalog is freed once every reader that could have seen it has finished.
+
+typedef struct {
+    const char *category;
+    const char *role;               // NULL matches every role
+    float score;                    // strength of a keyword hit; the strongest rule wins
+    float confidence;               // confidence_threshold of the resulting pattern
+    int max_words;                  // only for messages this short; 0 for any length
+    const char *const *keywords;
+    int keyword_count;
+    const char *const *exclude;     // any of these words in the message disables the rule
+    int exclude_count;
+    const char *const *responses;   // one is picked at random
+    int response_count;
+} CatalogRule;
+
+typedef struct Catalog {
+    const CatalogRule *rules;
+    int rule_count;
+    const RouteGuide *routes;
+    int route_count;
+    const RouteIndex *route_index;
+    const uint64_t *route_candidates;   // per route, a bitset of the rules it lists in patterns
+    int candidate_words;                // uint64_t words per route
+    const float *route_outside_scores;  // per route, the best score of a rule for its role that is not a candidate
+    const int *rules_by_score;          // rule ids, highest score first
+    const NavigationGraph *navigation;  // NULL past NAV_GRAPH_MAX_ROUTES routes
+    uint32_t version;               // 1 at startup, +1 per successful reload
+    uint64_t checksum;              // of the content; tags pattern cache entries
+    time_t loaded_at;
+    long load_us;
+    void *storage;                  // NULL for the built-in catalog
+    uint64_t retired_epoch;
+    struct Catalog *next_retired;
+} Catalog;
+
+typedef struct {
+    uint32_t version;
+    uint64_t checksum;
+    int rule_count;
+    int route_count;
+    time_t loaded_at;
+    long load_us;
+    unsigned long reloads;
+    unsigned long reload_failures;
+    int retired;                    // replaced catalogs still pinned by a reader
+} CatalogStatus;
+
+// Catalog file used at startup and by every reload; NULL for the built-in data
+void set_catalog_path(const char *path);
+const char *get_catalog_path(void);
+
+// Loads the initial catalog. Returns false when the catalog file is unusable.
+bool catalog_init(void);
+
+// Reloads from the catalog file. On failure the active catalog is kept and
+// the reason is written to error.
+bool catalog_reload(char *error, size_t error_size);
+
+// Pins the active catalog for this thread until the matching release.
+// Nested calls return the catalog pinned by the outermost one.
+const Catalog *catalog_acquire(void);
+void catalog_release(void);
+
+// Frees replaced catalogs that no reader can still hold
+void catalog_collect(void);
+
+// Rules a page is about, as a bitset over rule ids; NULL when it lists none
+const uint64_t *catalog_route_candidates(const Catalog *catalog, const RouteGuide *guide);
+// A boosted candidate scoring at least this cannot lose to the rest of the catalog
+float catalog_route_outside_score(const Catalog *catalog, const RouteGuide *guide);
+
+void catalog_status(CatalogStatus *status);
+// Appends "catalogVersion":..., fields (no braces) for metrics and reload replies
+void append_catalog_json(OutputBuffer *out);
+
+// Writes a catalog in the file format catalog_reload reads
+bool catalog_dump(const Catalog *catalog, OutputBuffer *out);
+
+// Filled in by the pattern matcher and route tables
+void load_builtin_rules(const CatalogRule **rules, int *count);
+
+#endif // CATALOG_H
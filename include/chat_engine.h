@@ -6,10 +6,30 @@
 void init_chat_engine(void);
 
 ChatSession *create_session(const char *user_id, const char *role, const char *language);
+// Not registered for find_session; the caller frees it with free_session
+ChatSession *create_detached_session(const char *user_id, const char *role, const char *language);
 ChatSession *find_session(const char *session_id);
+ChatSession *get_or_create_session(const char *session_id, const char *user_id,
+                                   const char *role, const char *language, bool *created);
 void free_session(ChatSession *session);
 void cleanup_expired_sessions(void);
 
+// Prefork workers own the sessions whose id hashes to their index; ids
+// generated here always hash to this process. Also reseeds the id generator,
+// whose state forked workers would otherwise share.
+void set_session_shard(int index, int count);
+int session_shard(const char *session_id, int count);
+
+bool is_valid_role(const char *role);
+bool is_valid_language(const char *language);
+
+#define DEFAULT_MAX_MESSAGE_LENGTH 1024
+
+// Longer messages are refused before any matching work. Set at startup.
+void set_max_message_length(size_t length);
+size_t get_max_message_length(void);
+
+// Returns NULL for messages over the maximum length
 ChatResponse *process_message(ChatSession *session, const char *message);
 void free_response(ChatResponse *response);
 
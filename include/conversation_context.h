@@ -1,6 +1,10 @@
 #ifndef CONVERSATION_CONTEXT_H
 #define CONVERSATION_CONTEXT_H
 
+#include "tokenizer.h"
+#include "dialog.h"
+#include <stdint.h>
+
 #define MAX_HISTORY 5
 #define MAX_CONTEXT_STRING 128
 
@@ -9,11 +13,9 @@ struct ConversationContext {
     char *last_topic;          // "payment", "maintenance", "navigation"
     char *last_entity;         // "Payments section", "rent", "maintenance request"
     char *last_action;         // "pay", "report", "navigate", "find"
-    char **last_options;       // ["Card", "Bank", "Cash"] for "which one?"
-    int option_count;
     char *message_history[MAX_HISTORY];  // Last 5 messages
     int history_count;
-    char *last_intent;         // "pay_rent", "report_maintenance", "navigate"
+    DialogState dialog;        // open intent and its slots, for "which one?"
 };
 
 typedef struct ConversationContext ConversationContext;
@@ -23,7 +25,12 @@ void free_conversation_context(ConversationContext *ctx);
 void update_context(ConversationContext *ctx, const char *topic, 
                    const char *entity, const char *action);
 void add_to_history(ConversationContext *ctx, const char *message);
-void set_context_options(ConversationContext *ctx, char **options, int count);
-char *resolve_pronoun(ConversationContext *ctx, const char *message);
+// Rewrites a message that refers back to the conversation ("how do I do it?",
+// "where is that?"); NULL, without allocating, when there is nothing to rewrite
+char *resolve_pronoun(ConversationContext *ctx, const TokenStream *tokens);
+// Identifies the context a rewrite would read (which reference, and the
+// topic, action or entity it names) without making it; 0 when the message
+// stands on its own. Equal fingerprints mean equal rewrites.
+uint64_t context_fingerprint(const ConversationContext *ctx, const TokenStream *tokens);
 
 #endif // CONVERSATION_CONTEXT_H
@@ -0,0 +1,63 @@
+#ifndef DIALOG_H
+#define DIALOG_H
+
+#include "tokenizer.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Multi-turn intents (pay rent, report maintenance, navigate) as one table of
+// transitions. An answer that starts an intent leaves the session waiting for
+// a slot; the next message is classified into an event and looked up against
+// the waiting state, so "which one?" or "by card" resolve without matching.
+
+typedef enum {
+    DIALOG_IDLE,
+    DIALOG_PAY_METHOD,          // pay rent: which method
+    DIALOG_REPORT_ISSUE,        // report maintenance: what kind of issue
+    DIALOG_REPORT_URGENCY,      // report maintenance: urgent or not
+    DIALOG_NAVIGATE_PAGE,       // navigate: which page
+    DIALOG_STATES
+} DialogStateId;
+
+typedef enum {
+    SLOT_METHOD,                // PaymentMethod
+    SLOT_ISSUE,                 // IssueType
+    SLOT_URGENCY,               // Urgency
+    DIALOG_SLOTS
+} DialogSlot;
+
+// Slot values; 0 is unfilled
+typedef enum { METHOD_CARD = 1, METHOD_BANK, METHOD_CASH, METHODS } PaymentMethod;
+typedef enum { ISSUE_PLUMBING = 1, ISSUE_ELECTRICAL, ISSUE_APPLIANCE, ISSUE_BUILDING, ISSUES } IssueType;
+typedef enum { URGENCY_URGENT = 1, URGENCY_ROUTINE, URGENCIES } Urgency;
+
+// All a session keeps between turns
+typedef struct {
+    uint8_t state;              // DialogStateId
+    uint8_t slots[DIALOG_SLOTS];
+} DialogState;
+
+typedef enum {
+    DIALOG_PASS,                // not a follow-up; match the message as usual
+    DIALOG_ANSWER,              // text holds the reply
+    DIALOG_DIRECTIONS,          // the message names a page; answer with directions to it
+    DIALOG_PAGES                // asked which pages there are; answer with the page's buttons
+} DialogOutcome;
+
+// Enters the intent an answer of category opened, with the slots the message
+// already fills. names_page says whether it named a navigation destination.
+void dialog_start(DialogState *dialog, const char *category, const char *role, const TokenStream *tokens,
+                  bool names_page);
+
+// The waiting intent's category when the message is a short cancel or
+// "which" follow-up, else NULL. It only counts as one when it matches no
+// rule of another category, which the caller checks.
+const char *dialog_control_category(const DialogState *dialog, const TokenStream *tokens);
+
+// Feeds the next message to the waiting state. control says whether cancel
+// and "which" words count (see dialog_control_category). For DIALOG_ANSWER
+// the reply is written to text; category is the intent's response category.
+DialogOutcome dialog_follow_up(DialogState *dialog, const TokenStream *tokens, bool names_page, bool control,
+                               char *text, size_t text_size, const char **category);
+
+#endif // DIALOG_H
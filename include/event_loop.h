@@ -0,0 +1,116 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include "admission.h"
+#include "json_io.h"
+#include "request_handler.h"
+#include "worker_pool.h"
+#include <stdint.h>
+
+typedef struct EventLoop EventLoop;
+
+typedef enum {
+    IO_BACKEND_EPOLL,
+    IO_BACKEND_URING   // falls back to epoll when the kernel lacks support
+} IoBackend;
+
+// One process of a prefork server. Connections whose session belongs to
+// another worker are passed to it over that worker's inbox socket.
+typedef struct {
+    int index;
+    int count;
+    int inbox_fd;           // receives connections handed to this worker
+    const int *peer_fds;    // send side of every worker's inbox, by index
+} WorkerShard;
+
+typedef struct {
+    int workers;            // 0 answers requests on the IO thread
+    IoBackend backend;
+    AdmissionConfig admission;
+    const WorkerShard *shard;   // NULL outside prefork mode
+} ServerOptions;
+
+typedef struct EventConnection {
+    int fd;
+    OutputBuffer in;
+    OutputBuffer out;
+    OutputBuffer sending;       // io_uring: bytes owned by the send in flight
+    uint32_t interest;
+    bool close_after_write;
+    int inflight;
+    int io_pending;             // io_uring: operations still referencing conn
+    bool closed;
+    bool retired;
+    int handoff_to;             // worker taking over the connection, or -1
+    bool pinned;                // a handoff failed; serve everything here
+    bool read_paused;           // too much owed or buffered; see event_loop_backpressured
+    bool receiving;             // io_uring: a recv is outstanding
+    bool recv_cancelling;       // io_uring: that recv is being cancelled
+    EventLoop *loop;
+    struct EventConnection *next_closed;
+    struct EventConnection *next_handoff;
+} EventConnection;
+
+// A chat request handed from the IO thread to a worker and back.
+typedef struct ServerJob {
+    Task task;
+    EventConnection *conn;
+    ChatRequest request;
+    OutputBuffer reply;
+    RequestStatus status;
+    AllocationCount allocations;    // made while the request ran
+    StreamSink sink;
+    bool stream_started;        // protocol framing has begun on reply
+    bool close_after_reply;     // set by the protocol before dispatch
+    struct ServerJob *next;
+} ServerJob;
+
+typedef struct {
+    const char *name;
+    // Consumes one complete request from data. Replies are either queued on
+    // conn->out directly or produced by a dispatched job. Returns bytes
+    // consumed, 0 when more input is needed, or -1 to close the connection
+    // once the queued output has been flushed.
+    long (*process)(EventConnection *conn, const char *data, size_t length);
+    // Runs on the IO thread when a dispatched job has finished.
+    void (*complete)(EventConnection *conn, ServerJob *job);
+    // Frames one streamed event onto job->reply from the worker thread.
+    // NULL when the protocol only sends whole replies.
+    void (*stream_event)(ServerJob *job, const char *type, const char *json, size_t length);
+    // Hold further input while a request is in flight so replies keep request order
+    bool ordered;
+} ServerProtocol;
+
+// reuse_port lets several listeners share the address; the kernel spreads
+// incoming connections across them
+int create_tcp_listener(const char *host, int port, bool reuse_port);
+int create_unix_listener(const char *path);
+
+// Serves listen_fd until SIGINT or SIGTERM, running chat requests on a
+// worker pool sized by options. SIGHUP reloads the catalog. Returns the
+// exit code.
+int run_event_loop(int listen_fd, const ServerProtocol *protocol, const ServerOptions *options);
+
+ServerJob *event_loop_new_job(EventConnection *conn);
+// Returns a job that will not be dispatched
+void event_loop_release_job(ServerJob *job);
+// Runs job->request, streaming it when request.stream is set and the protocol
+// can frame events; protocol->complete receives the job afterwards. Jobs
+// refused by admission control complete at once with REQUEST_BUSY or
+// REQUEST_THROTTLED and a JSON error reply.
+void event_loop_dispatch(ServerJob *job);
+
+const ServerMetrics *event_loop_metrics(const EventConnection *conn);
+
+// Admin reload: swaps in the catalog file and, in prefork mode, has the
+// supervisor reload every other worker. Appends the JSON reply to out and
+// returns false, keeping the old catalog, when the file is unusable.
+bool event_loop_reload(EventConnection *conn, OutputBuffer *out, const char *correlation_id);
+
+// In prefork mode, starts moving conn to the worker that owns session_id and
+// returns true; the protocol then leaves the request unconsumed so it travels
+// with the socket. False when the session is local or conn has replies
+// pending, in which case the request is served here.
+bool event_loop_route_session(EventConnection *conn, const char *session_id);
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,18 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include "event_loop.h"
+
+typedef struct {
+    const char *host;
+    int port;
+    int processes;          // above 1, forks SO_REUSEPORT worker processes
+    ServerOptions options;
+} HttpServerConfig;
+
+// Runs the HTTP/1.1 listener until SIGINT or SIGTERM. Returns the exit code.
+// In prefork mode a request naming another worker's session moves its
+// connection to that worker, so multi-turn context stays in one process.
+int run_http_server(const HttpServerConfig *config);
+
+#endif // HTTP_SERVER_H
@@ -0,0 +1,80 @@
+#ifndef IO_BACKEND_H
+#define IO_BACKEND_H
+
+// Interface between the event loop core (event_loop.c) and the socket IO
+// backends that drive it. Not for use outside src/server.
+
+#include "event_loop.h"
+#include <pthread.h>
+
+typedef struct ServerChunk ServerChunk;
+
+typedef struct {
+    const char *name;
+    // Starts sending conn->out. Returns false once the connection has
+    // nothing left to do and should be closed.
+    bool (*flush)(EventLoop *loop, EventConnection *conn);
+    // Detaches conn from the backend and marks it closed
+    void (*close)(EventLoop *loop, EventConnection *conn);
+    // Starts IO on a connection that did not come from the listener
+    bool (*attach)(EventLoop *loop, EventConnection *conn);
+    // Stops IO on conn without touching the socket, then calls
+    // event_loop_detached once no operation refers to it
+    void (*detach)(EventLoop *loop, EventConnection *conn);
+} IoBackendOps;
+
+struct EventLoop {
+    int listen_fd;
+    int signal_fd;
+    int completion_fd;
+    const ServerProtocol *protocol;
+    WorkerPool *pool;
+    const IoBackendOps *ops;
+    Admission admission;
+    const WorkerShard *shard;
+    EventConnection *handoffs;  // detached, waiting to be sent to their owner
+    char *handoff_buffer;
+    int epoll_fd;
+    void *uring;
+
+    // Finished jobs and streamed output waiting for the IO thread. Both lists
+    // are taken under one lock so a job's chunks are never seen after it.
+    pthread_mutex_t completion_lock;
+    ServerJob *completed;
+    ServerChunk *chunks;
+
+    // Recycled jobs keep their reply buffers; only touched by the IO thread
+    ServerJob *free_jobs;
+
+    // Freed after each event batch, which may still hold their pointers
+    EventConnection *closed;
+};
+
+EventConnection *event_loop_add_connection(EventLoop *loop, int fd);
+// Runs every complete request buffered on conn
+void event_loop_process_input(EventLoop *loop, EventConnection *conn);
+// Reads the completion eventfd and delivers finished jobs and chunks
+void event_loop_drain_completions(EventLoop *loop);
+// Whether to stop reading from conn. Pauses once its unprocessed input and
+// unsent output pass a high-water mark, and resumes when they drop below a
+// low one, so a client that pipelines without reading its replies cannot
+// grow the server without limit.
+bool event_loop_backpressured(EventConnection *conn);
+// Retires a closed connection once no job or backend operation refers to it
+void event_loop_release_connection(EventLoop *loop, EventConnection *conn);
+void event_loop_free_closed(EventLoop *loop);
+// Drains the signalfd. SIGHUP reloads the catalog; returns false once
+// SIGINT or SIGTERM has arrived.
+bool event_loop_handle_signals(EventLoop *loop);
+
+void event_loop_detached(EventLoop *loop, EventConnection *conn);
+// Sends detached connections to their owners; any that cannot go resume here
+void event_loop_finish_handoffs(EventLoop *loop);
+// Adopts connections waiting on the shard inbox
+void event_loop_accept_handoffs(EventLoop *loop);
+
+// Serves until a signal arrives. Returns -1 without serving when the kernel
+// lacks the required io_uring features, otherwise the exit code.
+int run_uring_backend(EventLoop *loop);
+
+#endif // IO_BACKEND_H
@@ -0,0 +1,32 @@
+#ifndef JSON_IO_H
+#define JSON_IO_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} OutputBuffer;
+
+void buffer_init(OutputBuffer *buffer);
+void buffer_free(OutputBuffer *buffer);
+void buffer_reset(OutputBuffer *buffer);
+bool buffer_reserve(OutputBuffer *buffer, size_t additional);
+bool buffer_append(OutputBuffer *buffer, const char *data, size_t length);
+bool buffer_append_str(OutputBuffer *buffer, const char *str);
+bool buffer_appendf(OutputBuffer *buffer, const char *format, ...);
+void buffer_consume(OutputBuffer *buffer, size_t length);
+// Writes the whole buffer to fd, retrying short writes
+bool buffer_write(const OutputBuffer *buffer, int fd);
+
+bool json_append_string(OutputBuffer *buffer, const char *value);
+
+// Flat-object field lookup for request bodies. Nested values are skipped.
+// json_get_string returns 1 when found, 0 when missing, -1 when the value
+// is not a string or does not fit in out_size.
+int json_get_string(const char *json, size_t length, const char *key, char *out, size_t out_size);
+bool json_get_raw(const char *json, size_t length, const char *key, const char **value, size_t *value_length);
+
+#endif // JSON_IO_H
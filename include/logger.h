@@ -0,0 +1,52 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdbool.h>
+
+typedef enum {
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_OFF
+} LogLevel;
+
+// Records below the compile-time floor are compiled out (make LOG_LEVEL=LOG_LEVEL_WARN)
+#ifndef BRICLLM_LOG_LEVEL
+#ifdef DEBUG
+#define BRICLLM_LOG_LEVEL LOG_LEVEL_DEBUG
+#else
+#define BRICLLM_LOG_LEVEL LOG_LEVEL_INFO
+#endif
+#endif
+
+// Runtime threshold; only changed at startup, before other threads exist
+extern LogLevel log_runtime_level;
+
+#define LOG_ENABLED(level) ((level) >= BRICLLM_LOG_LEVEL && (level) >= log_runtime_level)
+
+// Arguments are not evaluated unless the level is enabled
+#define LOG_AT(level, ...)                                  \
+    do {                                                    \
+        if (LOG_ENABLED(level)) log_record(level, __VA_ARGS__); \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+// Formats the message into the calling thread's ring buffer. A background
+// thread adds the timestamp and writes records to stderr or the log file.
+// Records are dropped (and counted) rather than blocking when a ring is full.
+void log_record(LogLevel level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+bool parse_log_level(const char *name, LogLevel *level);
+// Appends records to path instead of stderr; call before logging starts
+bool logger_set_file(const char *path);
+// Writes every record queued so far
+void logger_flush(void);
+// Stops the background writer after a final flush; also runs at exit
+void logger_shutdown(void);
+
+#endif // LOGGER_H
@@ -0,0 +1,43 @@
+#ifndef NAV_GRAPH_H
+#define NAV_GRAPH_H
+
+#include "route_types.h"
+#include <stdint.h>
+
+// Routes are nodes; every button or page action that opens another page of
+// the same role is an edge. A label opens the page whose last path segment
+// is the label or its last word ("Check Schedule" -> /caretaker/schedule);
+// "Home" and "Dashboard" open the role's top-level page.
+
+// next_hop is route_count squared, so larger catalogs go without a graph
+#define NAV_GRAPH_MAX_ROUTES 2048
+
+struct NavigationGraph {
+    int route_count;
+    const int *item_offset;     // per route, its first entry in item_target
+    const int *item_target;     // per button then action, the route it opens or -1
+    const int16_t *next_hop;    // [from * route_count + to]: item to tap first, -1 if unreachable
+};
+
+typedef struct {
+    const char *label;          // button or action to tap
+    const RouteGuide *page;     // where it leads
+} NavigationStep;
+
+// item_count bounds the buttons and actions over all guides
+size_t navigation_graph_size(int route_count, int item_count);
+// NULL when there are more than NAV_GRAPH_MAX_ROUTES guides. The graph
+// refers to nothing, but is only meaningful for the guides it was built from.
+const NavigationGraph *build_navigation_graph(void *memory, const RouteGuide *guides, int count);
+
+// The role's page the length bytes of word name ("payments", "payment", "home"), or -1
+int find_navigation_page(const RouteGuide *guides, int count, const char *word, int length, const char *role);
+// Fills steps with the shortest way from one route to another. Returns the
+// step count, 0 when already there, or -1 when unreachable or longer than max.
+int find_navigation_path(const NavigationGraph *graph, const RouteGuide *guides, int from, int to,
+                         NavigationStep *steps, int max);
+// The buttons on a page that lead somewhere else, up to max
+int find_navigation_exits(const NavigationGraph *graph, const RouteGuide *guides, int from,
+                          NavigationStep *steps, int max);
+
+#endif // NAV_GRAPH_H
@@ -2,30 +2,53 @@
 #define PATTERN_CACHE_H
 
 #include "bricllm.h"
-#include <time.h>
+#include <stdatomic.h>
+#include <stdint.h>
 
-#define CACHE_SIZE 50
+#define CACHE_SLOTS 256         // power of two
+#define CACHE_PROBE 4
+#define CACHE_QUERY_MAX 256
+#define CACHE_RESPONSE_MAX 1024
+#define CACHE_CATEGORY_MAX 64
+#define CACHE_KEYWORD_MAX 128
 
+// Entries live in a shared mapping, so they hold text rather than pointers.
+// Writers make sequence odd while copying in; readers retry or give up when
+// it changes underneath them.
 typedef struct {
-    char *query;
-    char *role;
-    char *language;
-    ResponsePattern *pattern;
-    time_t timestamp;
-    int hit_count;
+    _Atomic uint32_t sequence;
+    _Atomic uint32_t hit_count;
+    _Atomic int64_t last_used;
+    _Atomic uint64_t key_hash;      // 0 marks an empty slot
+    uint64_t scope;                 // what the answer depended on besides the query; see cache_lookup
+    float confidence_threshold;
+    char query[CACHE_QUERY_MAX];
+    char role[16];
+    char language[8];
+    char response[CACHE_RESPONSE_MAX];
+    char category[CACHE_CATEGORY_MAX];
+    char keyword[CACHE_KEYWORD_MAX];    // first pattern keyword, scored against the message
 } CacheEntry;
 
 typedef struct {
-    CacheEntry entries[CACHE_SIZE];
-    int next_slot;
-    int total_hits;
-    int total_misses;
+    _Atomic uint64_t total_hits;
+    _Atomic uint64_t total_misses;
+    CacheEntry entries[CACHE_SLOTS];
 } PatternCache;
 
+// Maps the cache into shared memory; processes forked afterwards share it
 void init_pattern_cache(void);
-ResponsePattern *cache_lookup(const char *query, const char *role, const char *language);
-void cache_store(const char *query, const char *role, const char *language, ResponsePattern *pattern);
+// Hits are returned as a copy; the caller frees its response, category and itself.
+// Entries only match the scope they were stored under: the catalog checksum
+// mixed with the page the answer was matched for and the conversation context
+// a follow-up was resolved against, so a reload invalidates everything cached
+// before it. Queries of CACHE_QUERY_MAX bytes or more are never cached.
+ResponsePattern *cache_lookup(const char *query, const char *role, const char *language, uint64_t scope);
+void cache_store(const char *query, const char *role, const char *language, uint64_t scope,
+                 ResponsePattern *pattern);
 void cache_stats(void);
+// Lookups since the cache was mapped, summed over every process sharing it
+void cache_counters(uint64_t *hits, uint64_t *misses);
 void cleanup_cache(void);
 
 #endif // PATTERN_CACHE_H
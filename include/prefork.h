@@ -0,0 +1,16 @@
+#ifndef PREFORK_H
+#define PREFORK_H
+
+#include "event_loop.h"
+
+#define PREFORK_MAX_PROCESSES 64
+
+typedef int (*PreforkServe)(const WorkerShard *shard, void *context);
+
+// Forks processes workers that each run serve with their own shard and
+// supervises them until SIGINT or SIGTERM. Crashed workers are restarted;
+// one that fails straight after starting stops the server. SIGHUP reloads
+// the catalog here and in every worker. Returns the exit code.
+int run_prefork(int processes, PreforkServe serve, void *context);
+
+#endif // PREFORK_H
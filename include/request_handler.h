@@ -0,0 +1,74 @@
+#ifndef REQUEST_HANDLER_H
+#define REQUEST_HANDLER_H
+
+#include "bricllm.h"
+#include "json_io.h"
+
+#define CHAT_REQUEST_MAX_MESSAGE 4096
+#define CHAT_REQUEST_MAX_ID 64
+
+typedef struct {
+    char correlation_id[CHAT_REQUEST_MAX_ID + 1];  // raw JSON token echoed back as "id"
+    char session_id[CHAT_REQUEST_MAX_ID + 1];
+    char user_id[CHAT_REQUEST_MAX_ID + 1];
+    char message[CHAT_REQUEST_MAX_MESSAGE];
+    char role[16];
+    char language[8];
+    char route[256];
+    bool stream;                                   // "stream":true asks for incremental events
+    bool timings;                                  // "timings":true adds per-stage microseconds
+} ChatRequest;
+
+typedef enum {
+    REQUEST_OK,
+    REQUEST_INVALID,
+    REQUEST_UNAVAILABLE,
+    REQUEST_BUSY,       // shed by admission control
+    REQUEST_THROTTLED   // over the user's rate limit
+} RequestStatus;
+
+// Parses a JSON request body. On failure *error names the offending field.
+bool parse_chat_request(const char *body, size_t length, ChatRequest *request, const char **error);
+// Reads the optional "id" token; false when it is not a plain string or number
+bool parse_correlation_id(const char *body, size_t length, char *out, size_t out_size);
+
+// Runs the request against its registered session and appends the JSON payload to out.
+RequestStatus handle_chat_request(const ChatRequest *request, OutputBuffer *out);
+// Same, against a session the caller owns. created applies the role's default route.
+RequestStatus run_chat_request(ChatSession *session, bool created, const ChatRequest *request, OutputBuffer *out);
+
+// Receives a streamed answer as single-line JSON events: "meta" (category,
+// confidence, suggested actions), "text", then "done" with ttfbUs/totalUs,
+// plus "timings" when the request asked for them, or a lone "error". flush
+// marks where the bytes so far should be sent.
+typedef struct StreamSink {
+    void (*event)(struct StreamSink *sink, const char *type, const char *json, size_t length);
+    void (*flush)(struct StreamSink *sink);
+    void *context;
+} StreamSink;
+
+RequestStatus handle_chat_stream(const ChatRequest *request, StreamSink *sink);
+RequestStatus run_chat_stream(ChatSession *session, bool created, const ChatRequest *request, StreamSink *sink);
+
+// Request fields with their defaults applied
+const char *request_role(const ChatRequest *request);
+const char *request_language(const ChatRequest *request);
+const char *request_user_id(const ChatRequest *request);
+
+typedef struct {
+    const char *correlation_id;
+    const char *response_text;
+    float confidence;
+    long response_time_ms;
+    long response_time_us;      // omitted when negative
+    const char *language;
+    const char *role;
+    const char *session_id;
+    const ChatResponse *response;  // optional: adds messageId, category and suggestedActions
+    bool timings;                  // with response, adds its "timings" object
+} JsonPayload;
+
+void append_json_payload(OutputBuffer *out, const JsonPayload *payload);
+void append_json_error(OutputBuffer *out, const char *correlation_id, const char *message);
+
+#endif // REQUEST_HANDLER_H
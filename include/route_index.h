@@ -0,0 +1,29 @@
+#ifndef ROUTE_INDEX_H
+#define ROUTE_INDEX_H
+
+// Layout of the route index, shared by route_index.c and the tables that
+// tools/routegen generates. Everything else goes through route_types.h.
+
+#include "route_types.h"
+
+// Compressed radix tree over route paths. Static edges are labelled with the
+// longest run of characters their routes share; a ":name" segment becomes a
+// param node that matches any one segment.
+typedef struct {
+    const char *label;
+    int label_length;
+    bool param;
+    int first_child;    // static children, each starting with a different character
+    int next_sibling;
+    int param_child;
+    int first_guide;    // guides for this exact path, one per role in file order
+} RouteNode;
+
+struct RouteIndex {
+    const RouteGuide *guides;
+    const int *next_guide;
+    const RouteNode *nodes;
+    int node_count;
+};
+
+#endif // ROUTE_INDEX_H
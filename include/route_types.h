@@ -2,18 +2,11 @@
 #define ROUTE_TYPES_H
 
 #include "bricllm.h"
+#include <stdint.h>
 
+// What a page offers. Counts sit next to their arrays and are always exact.
 typedef struct {
-    char *route;
-    char *user_role;
-    ResponsePattern **patterns;
-    int pattern_count;
-    char **navigation_buttons;
-    char **page_actions;
-} RouteGuide;
-
-typedef struct {
-    char *current_route;
+    char *route;                    // as listed, e.g. "/tenant/requests/:id"
     char *user_role;
     char **available_buttons;
     int button_count;
@@ -21,13 +14,40 @@ typedef struct {
     int action_count;
 } NavigationContext;
 
+typedef struct {
+    NavigationContext navigation;
+    char **patterns;                // categories of the rules this page is about
+    int pattern_count;
+    uint32_t hash;                  // route_hash(navigation.route)
+} RouteGuide;
+
+// Resolves paths against a table of guides in time proportional to the path
+typedef struct RouteIndex RouteIndex;
+// Next hops between a role's pages, see nav_graph.h
+typedef struct NavigationGraph NavigationGraph;
+
 void init_route_system(void);
-RouteGuide *find_route_guide(const char *route, const char *user_role);
-NavigationContext *get_navigation_context(const char *route, const char *user_role);
-void free_navigation_context(NavigationContext *ctx);
-void load_tenant_routes(void);
-void load_caretaker_routes(void);
-void load_manager_routes(void);
-void load_admin_routes(void);
+const char *default_route_for_role(const char *role);
+// Guides belong to the active catalog; callers hold catalog_acquire while using them.
+// Matches "/tenant/requests/:id" style params, ignores a trailing slash or query,
+// and falls back to the longest leading run of segments with a guide for the role.
+const RouteGuide *find_route_guide(const char *route, const char *user_role);
+// Borrowed view of the page for route, falling back to the role's home page.
+// Points into the catalog, so the same catalog_acquire rule applies.
+const NavigationContext *get_navigation_context(const char *route, const char *user_role);
+// Generated from src/routes/routes.manifest by tools/routegen, index and graph included
+void load_builtin_routes(const RouteGuide **guides, int *count, const RouteIndex **index,
+                         const NavigationGraph **graph);
+
+// Builds the index for guides in memory of route_index_size bytes, given the
+// route count and the sum of route_params over them. The index refers to the
+// guides and their strings, which must outlive it.
+int route_params(const char *route);
+size_t route_index_size(int route_count, int params);
+const RouteIndex *build_route_index(void *memory, const RouteGuide *guides, int count);
+const RouteGuide *match_route_index(const RouteIndex *index, const char *path, const char *role);
+int route_index_nodes(const RouteIndex *index);
+// FNV-1a of the route without a trailing slash or query
+uint32_t route_hash(const char *route);
 
 #endif // ROUTE_TYPES_H
\ No newline at end of file
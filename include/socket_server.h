@@ -0,0 +1,11 @@
+#ifndef SOCKET_SERVER_H
+#define SOCKET_SERVER_H
+
+#include "event_loop.h"
+
+// Serves newline-delimited JSON requests on an AF_UNIX stream socket until
+// SIGINT or SIGTERM. A line of {"op":"metrics"} returns the server counters
+// instead of a chat reply. Returns the exit code.
+int run_socket_server(const char *path, const ServerOptions *options);
+
+#endif // SOCKET_SERVER_H
@@ -0,0 +1,26 @@
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <stdbool.h>
+
+// A message split once into words that later stages share. Tokens point into
+// the message, which must outlive the stream; nothing is copied or allocated.
+
+#define MAX_MESSAGE_TOKENS 256
+
+typedef struct {
+    const char *text;
+    int length;
+} Token;
+
+typedef struct {
+    Token tokens[MAX_MESSAGE_TOKENS];
+    int count;                  // words past MAX_MESSAGE_TOKENS are dropped
+} TokenStream;
+
+// Words are runs of letters and digits, with apostrophes inside them ("what's")
+void tokenize_message(const char *message, TokenStream *stream);
+// Case-insensitive whole-word comparison
+bool token_is(const Token *token, const char *word);
+
+#endif // TOKENIZER_H
@@ -0,0 +1,28 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct Task Task;
+typedef void (*TaskFunction)(Task *task);
+
+// Embedded in the caller's own work item; the pool never allocates per task.
+struct Task {
+    TaskFunction run;
+    Task *next;
+};
+
+typedef struct WorkerPool WorkerPool;
+
+WorkerPool *worker_pool_create(int thread_count);
+// Stops the workers once their current task returns. Queued tasks are dropped.
+void worker_pool_destroy(WorkerPool *pool);
+int worker_pool_size(const WorkerPool *pool);
+
+// Safe from any thread. Tasks submitted by a worker go to its own deque.
+void worker_pool_submit(WorkerPool *pool, Task *task);
+// Tasks sharing a key run one at a time in submission order.
+void worker_pool_submit_keyed(WorkerPool *pool, uint64_t key, Task *task);
+
+#endif // WORKER_POOL_H
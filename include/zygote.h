@@ -0,0 +1,22 @@
+#ifndef ZYGOTE_H
+#define ZYGOTE_H
+
+#include <stdbool.h>
+
+// Set to the zygote's socket path to have one-shot queries answered by it
+#define ZYGOTE_ENV "BRICLLM_ZYGOTE"
+
+typedef int (*ZygoteMain)(int argc, char **argv);
+
+// Serves path until SIGINT or SIGTERM. Each client's argv runs through run in
+// a child forked from this already initialized process, writing straight to
+// the client's stdin, stdout and stderr; its wait status goes back to the
+// client. SIGHUP reloads the catalog for later queries. Returns the exit code.
+int run_zygote(const char *path, ZygoteMain run);
+
+// Hands argv and this process's stdio to the zygote at path. Returns false,
+// having run nothing, when no zygote takes the query; otherwise exit_code is
+// what running it here would have returned.
+bool zygote_forward(const char *path, int argc, char **argv, int *exit_code);
+
+#endif // ZYGOTE_H
@@ -2,11 +2,19 @@
 #include "include/chat_engine.h"
 #include "include/route_types.h"
 #include "include/pattern_cache.h"
+#include "include/catalog.h"
+#include "include/request_handler.h"
+#include "include/http_server.h"
+#include "include/prefork.h"
+#include "include/socket_server.h"
+#include "include/batch_runner.h"
+#include "include/zygote.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <time.h>
+#include <unistd.h>
 
 static void print_usage(const char *program_name) {
     printf("Usage: %s [options]\n", program_name);
@@ -16,6 +24,24 @@ static void print_usage(const char *program_name) {
     printf("  --lang <lang>                             Set language (en, zu)\n");
     printf("  --route <path>                            Set current route context\n");
     printf("  --json-output, -j                         Output responses as JSON\n");
+    printf("  --stream                                  Stream responses as NDJSON events (meta, text, done)\n");
+    printf("  --timings                                 Add per-stage microseconds to --json-output and --stream\n");
+    printf("  --serve <[host:]port>                     Run the HTTP server (POST /chat)\n");
+    printf("  --socket <path>                           Serve newline-delimited JSON on a Unix socket\n");
+    printf("  --batch <in.jsonl> --out <out.jsonl>      Answer a JSONL file of requests in parallel\n");
+    printf("  --threads <n>                             Worker threads for --batch (default: all cores)\n");
+    printf("  --workers <n>                             Worker threads for --serve/--socket (default: all cores, 0 = inline)\n");
+    printf("  --io-backend <epoll|uring>                Socket IO for --serve/--socket (default: epoll)\n");
+    printf("  --prefork <n>                             Serve --serve from n SO_REUSEPORT worker processes\n");
+    printf("  --max-queue <n>                           Requests queued for workers before shedding with 503 (default: 1024, 0 = unbounded)\n");
+    printf("  --user-rate <r>                           Requests per second allowed per userId before 429 (default: 0 = unlimited)\n");
+    printf("  --user-burst <n>                          Requests a userId may send at once (default: twice --user-rate)\n");
+    printf("  --zygote <path>                           Stay initialized and answer --single-query runs forked off here\n");
+    printf("  --max-message-length <n>                  Longest accepted message in bytes (default: 1024)\n");
+    printf("  --catalog <path>                          Load patterns and routes from a catalog file; SIGHUP reloads it\n");
+    printf("  --dump-catalog                            Print the active catalog in catalog file format and exit\n");
+    printf("  --log-level <level>                       Log threshold: debug, info, warn, error, off (default: info)\n");
+    printf("  --log-file <path>                         Append logs to a file instead of stderr\n");
     printf("  --help, -h                                Show this help message\n");
 }
 
@@ -28,6 +54,7 @@ void show_help(void) {
     printf("/route <path>         - Set current route context\n");
     printf("/status               - Show current session status\n");
     printf("/stats                - Show cache statistics\n");
+    printf("/reload               - Reload the --catalog file\n");
     printf("/quit                 - Exit the application\n");
     printf("\n");
     printf("Natural language examples:\n");
@@ -55,24 +82,6 @@ void clear_screen(void) {
     printf("\033[2J\033[H");
 }
 
-static bool is_valid_role(const char *role) {
-    if (!role) return false;
-    return strcmp(role, "tenant") == 0 || strcmp(role, "caretaker") == 0 || strcmp(role, "manager") == 0 || strcmp(role, "admin") == 0;
-}
-
-static bool is_valid_language(const char *language) {
-    if (!language) return false;
-    return strcmp(language, "en") == 0 || strcmp(language, "zu") == 0;
-}
-
-static const char *default_route_for_role(const char *role) {
-    if (!role) return "/";
-    if (strcmp(role, "caretaker") == 0) return "/caretaker";
-    if (strcmp(role, "manager") == 0) return "/manager";
-    if (strcmp(role, "admin") == 0) return "/admin";
-    return "/tenant";
-}
-
 bool process_command(const char *input, ChatSession **session) {
     if (!input || input[0] != '/') return false;
 
@@ -98,8 +107,8 @@ bool process_command(const char *input, ChatSession **session) {
                      strcmp(role, "caretaker") == 0 ||
                      strcmp(role, "manager") == 0 ||
                      strcmp(role, "admin") == 0)) {
-            free((*session)->role);
-            (*session)->role = strdup(role);
+            engine_free((*session)->role);
+            (*session)->role = engine_strdup(role);
             printf("Role changed to: %s\n", role);
         } else {
             printf("Invalid role. Use: tenant, caretaker, manager, or admin\n");
@@ -107,8 +116,8 @@ bool process_command(const char *input, ChatSession **session) {
     } else if (strcmp(token, "/lang") == 0) {
         char *lang = strtok(NULL, " ");
         if (lang && (strcmp(lang, "en") == 0 || strcmp(lang, "zu") == 0)) {
-            free((*session)->language);
-            (*session)->language = strdup(lang);
+            engine_free((*session)->language);
+            (*session)->language = engine_strdup(lang);
             printf("Language changed to: %s\n", lang);
         } else {
             printf("Invalid language. Use: en or zu\n");
@@ -116,11 +125,13 @@ bool process_command(const char *input, ChatSession **session) {
     } else if (strcmp(token, "/route") == 0) {
         char *route = strtok(NULL, " ");
         if (route) {
-            free((*session)->context);
-            (*session)->context = strdup(route);
+            engine_free((*session)->context);
+            (*session)->context = engine_strdup(route);
             printf("Current route set to: %s\n", route);
 
-            NavigationContext *nav_ctx = get_navigation_context(route, (*session)->role);
+            // The buttons belong to the catalog
+            catalog_acquire();
+            const NavigationContext *nav_ctx = get_navigation_context(route, (*session)->role);
             if (nav_ctx) {
                 printf("Available buttons: ");
                 for (int i = 0; i < nav_ctx->button_count; i++) {
@@ -128,8 +139,8 @@ bool process_command(const char *input, ChatSession **session) {
                     if (i < nav_ctx->button_count - 1) printf(" ");
                 }
                 printf("\n");
-                free_navigation_context(nav_ctx);
             }
+            catalog_release();
         } else {
             printf("Usage: /route <path> (e.g., /tenant/payments)\n");
         }
@@ -137,6 +148,16 @@ bool process_command(const char *input, ChatSession **session) {
         show_status(*session);
     } else if (strcmp(token, "/stats") == 0) {
         cache_stats();
+    } else if (strcmp(token, "/reload") == 0) {
+        char error[256];
+        if (catalog_reload(error, sizeof(error))) {
+            CatalogStatus status;
+            catalog_status(&status);
+            printf("Catalog version %u loaded: %d patterns, %d routes\n",
+                   status.version, status.rule_count, status.route_count);
+        } else {
+            printf("Reload failed: %s\n", error);
+        }
     } else {
         printf("Unknown command: %s\n", token);
         printf("Type /help for available commands\n");
@@ -146,56 +167,143 @@ bool process_command(const char *input, ChatSession **session) {
     return false;
 }
 
-static void emit_json_string(const char *value) {
-    putchar('"');
-    if (value) {
-        for (const unsigned char *ptr = (const unsigned char *)value; *ptr; ptr++) {
-            if (*ptr == '"' || *ptr == '\\') {
-                printf("\\%c", *ptr);
-            } else if (*ptr <= 0x1F) {
-                printf("\\u%04x", *ptr);
-            } else {
-                putchar(*ptr);
-            }
-        }
-    }
-    putchar('"');
+// Reused across responses; each payload leaves in a single write
+static OutputBuffer json_output_buffer;
+
+static void print_json_payload(const ChatResponse *response, const char *fallback_text, long response_time_us,
+                               bool timings, const char *language, const char *role) {
+    JsonPayload payload;
+    payload.correlation_id = NULL;
+    payload.response_text = response && response->response ? response->response : fallback_text;
+    payload.confidence = response ? response->confidence : 0.0f;
+    payload.response_time_ms = (response_time_us + 500) / 1000;
+    payload.response_time_us = response_time_us;
+    payload.language = language;
+    payload.role = role;
+    payload.session_id = NULL;
+    payload.response = response;
+    payload.timings = timings;
+
+    buffer_reset(&json_output_buffer);
+    append_json_payload(&json_output_buffer, &payload);
+    // Prompts and text replies still go through stdio
+    fflush(stdout);
+    buffer_write(&json_output_buffer, STDOUT_FILENO);
 }
 
-static void print_json_payload(const char *response_text, float confidence, long response_time_ms, const char *language, const char *role) {
-    printf("{");
-    printf("\"response\":");
-    emit_json_string(response_text ? response_text : "");
-    printf(",\"confidence\":%.2f", confidence);
-    printf(",\"responseTime\":%ld", response_time_ms);
-    printf(",\"language\":");
-    emit_json_string(language ? language : "");
-    printf(",\"role\":");
-    emit_json_string(role ? role : "");
-    printf("}\n");
+static void write_stream_event(StreamSink *sink, const char *type, const char *json, size_t length) {
+    (void)sink;
+    (void)type;
+    fwrite(json, 1, length, stdout);
+    fputc('\n', stdout);
 }
 
-static long calculate_response_time_ms(clock_t start_clock, clock_t end_clock) {
-    if (start_clock == (clock_t)-1 || end_clock == (clock_t)-1) {
-        return 0;
+static void flush_stream(StreamSink *sink) {
+    (void)sink;
+    fflush(stdout);
+}
+
+static int stream_query(ChatSession *session, const char *message, bool timings) {
+    ChatRequest request;
+    memset(&request, 0, sizeof(request));
+    if (strlen(message) >= sizeof(request.message)) {
+        fprintf(stderr, "Error: Message too long\n");
+        return 1;
     }
-    double elapsed_seconds = (double)(end_clock - start_clock) / (double)CLOCKS_PER_SEC;
-    if (elapsed_seconds < 0) {
-        return 0;
+    strcpy(request.message, message);
+    request.timings = timings;
+
+    StreamSink sink = {write_stream_event, flush_stream, NULL};
+    return run_chat_stream(session, false, &request, &sink) == REQUEST_OK ? 0 : 1;
+}
+
+static bool parse_listen_address(const char *value, HttpServerConfig *config) {
+    static char host[256];
+    const char *colon = strrchr(value, ':');
+    const char *port_text = value;
+
+    config->host = "127.0.0.1";
+    if (colon) {
+        size_t host_length = (size_t)(colon - value);
+        if (host_length >= sizeof(host)) return false;
+        memcpy(host, value, host_length);
+        host[host_length] = '\0';
+        if (host_length > 0) config->host = host;
+        port_text = colon + 1;
     }
-    double elapsed_ms = elapsed_seconds * 1000.0;
-    if (elapsed_ms < 0) {
-        return 0;
+
+    char *end;
+    long port = strtol(port_text, &end, 10);
+    if (*port_text == '\0' || *end != '\0' || port <= 0 || port > 65535) return false;
+    config->port = (int)port;
+    return true;
+}
+
+// Wall-clock time, so replies that block count in full
+static long elapsed_us(const struct timespec *start, const struct timespec *end) {
+    long long elapsed_ns = (long long)(end->tv_sec - start->tv_sec) * 1000000000LL + (end->tv_nsec - start->tv_nsec);
+    return elapsed_ns > 0 ? (long)(elapsed_ns / 1000) : 0;
+}
+
+static LogLevel startup_log_level;
+
+static int run_cli(int argc, char **argv);
+
+// Puts back what the zygote's own options changed, so a query sees the
+// state a fresh process would have
+static int run_zygote_child(int argc, char **argv) {
+    log_runtime_level = startup_log_level;
+    set_max_message_length(DEFAULT_MAX_MESSAGE_LENGTH);
+    srand((unsigned int)time(NULL) ^ (unsigned int)getpid());
+    return run_cli(argc, argv);
+}
+
+// Only one-shot queries that touch nothing but the zygote's own state
+static bool zygote_can_run(int argc, char **argv) {
+    static const char *const local_options[] = {
+        "--zygote", "--serve", "--socket", "--batch", "--out", "--catalog", "--dump-catalog", "--log-file"
+    };
+    bool single_query = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--single-query") == 0 || strcmp(argv[i], "-q") == 0) {
+            single_query = true;
+        }
+        for (size_t j = 0; j < sizeof(local_options) / sizeof(local_options[0]); j++) {
+            if (strcmp(argv[i], local_options[j]) == 0) return false;
+        }
     }
-    return (long)(elapsed_ms + 0.5);
+    return single_query;
 }
 
 int main(int argc, char **argv) {
+    startup_log_level = log_runtime_level;
+
+    const char *zygote_path = getenv(ZYGOTE_ENV);
+    if (zygote_path && zygote_path[0] && zygote_can_run(argc, argv)) {
+        int exit_code;
+        if (zygote_forward(zygote_path, argc, argv, &exit_code)) return exit_code;
+    }
+    return run_cli(argc, argv);
+}
+
+static int run_cli(int argc, char **argv) {
     const char *role = "tenant";
     const char *language = "en";
     const char *route = NULL;
     const char *single_query = NULL;
     bool json_output = false;
+    bool stream_output = false;
+    bool timings = false;
+    bool serve = false;
+    bool dump_catalog = false;
+    const char *socket_path = NULL;
+    const char *zygote_path = NULL;
+    BatchConfig batch_config = {NULL, "-", 0};
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    ServerOptions server_options = {cores > 0 ? (int)cores : 1, IO_BACKEND_EPOLL, {1024, 0, 0}, NULL};
+    bool workers_set = false;
+    int processes = 1;
+    HttpServerConfig server_config;
 
     for (int i = 1; i < argc; i++) {
         const char *arg = argv[i];
@@ -236,6 +344,152 @@ int main(int argc, char **argv) {
             route = argv[++i];
         } else if (strcmp(arg, "--json-output") == 0 || strcmp(arg, "-j") == 0) {
             json_output = true;
+        } else if (strcmp(arg, "--io-backend") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing value for --io-backend\n");
+                return 1;
+            }
+            const char *name = argv[++i];
+            if (strcmp(name, "epoll") == 0) {
+                server_options.backend = IO_BACKEND_EPOLL;
+            } else if (strcmp(name, "uring") == 0 || strcmp(name, "io_uring") == 0) {
+                server_options.backend = IO_BACKEND_URING;
+            } else {
+                fprintf(stderr, "Error: Invalid IO backend '%s'\n", name);
+                return 1;
+            }
+        } else if (strcmp(arg, "--log-level") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing value for --log-level\n");
+                return 1;
+            }
+            if (!parse_log_level(argv[++i], &log_runtime_level)) {
+                fprintf(stderr, "Error: Invalid log level '%s'\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(arg, "--log-file") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing path for --log-file\n");
+                return 1;
+            }
+            if (!logger_set_file(argv[++i])) {
+                fprintf(stderr, "Error: Cannot open log file '%s'\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(arg, "--catalog") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing path for --catalog\n");
+                return 1;
+            }
+            set_catalog_path(argv[++i]);
+        } else if (strcmp(arg, "--dump-catalog") == 0) {
+            dump_catalog = true;
+        } else if (strcmp(arg, "--stream") == 0) {
+            stream_output = true;
+        } else if (strcmp(arg, "--timings") == 0) {
+            timings = true;
+        } else if (strcmp(arg, "--serve") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing address for --serve\n");
+                return 1;
+            }
+            if (!parse_listen_address(argv[++i], &server_config)) {
+                fprintf(stderr, "Error: Invalid address '%s'\n", argv[i]);
+                return 1;
+            }
+            serve = true;
+        } else if (strcmp(arg, "--socket") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing path for --socket\n");
+                return 1;
+            }
+            socket_path = argv[++i];
+        } else if (strcmp(arg, "--zygote") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing path for --zygote\n");
+                return 1;
+            }
+            zygote_path = argv[++i];
+        } else if (strcmp(arg, "--batch") == 0 || strcmp(arg, "--out") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing path for %s\n", arg);
+                return 1;
+            }
+            if (strcmp(arg, "--batch") == 0) {
+                batch_config.input_path = argv[++i];
+            } else {
+                batch_config.output_path = argv[++i];
+            }
+        } else if (strcmp(arg, "--workers") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing value for --workers\n");
+                return 1;
+            }
+            char *end;
+            long value = strtol(argv[++i], &end, 10);
+            if (*argv[i] == '\0' || *end != '\0' || value < 0 || value > 1024) {
+                fprintf(stderr, "Error: Invalid worker count '%s'\n", argv[i]);
+                return 1;
+            }
+            server_options.workers = (int)value;
+            workers_set = true;
+        } else if (strcmp(arg, "--prefork") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing value for --prefork\n");
+                return 1;
+            }
+            char *end;
+            long value = strtol(argv[++i], &end, 10);
+            if (*argv[i] == '\0' || *end != '\0' || value < 1 || value > PREFORK_MAX_PROCESSES) {
+                fprintf(stderr, "Error: Invalid process count '%s'\n", argv[i]);
+                return 1;
+            }
+            processes = (int)value;
+        } else if (strcmp(arg, "--max-queue") == 0 || strcmp(arg, "--max-message-length") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing value for %s\n", arg);
+                return 1;
+            }
+            bool queue = strcmp(arg, "--max-queue") == 0;
+            char *end;
+            long value = strtol(argv[++i], &end, 10);
+            long low = queue ? 0 : 1;
+            long high = queue ? 1000000 : CHAT_REQUEST_MAX_MESSAGE - 1;
+            if (*argv[i] == '\0' || *end != '\0' || value < low || value > high) {
+                fprintf(stderr, "Error: Invalid value '%s' for %s (%ld-%ld)\n", argv[i], arg, low, high);
+                return 1;
+            }
+            if (queue) {
+                server_options.admission.max_queue = (int)value;
+            } else {
+                set_max_message_length((size_t)value);
+            }
+        } else if (strcmp(arg, "--user-rate") == 0 || strcmp(arg, "--user-burst") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing value for %s\n", arg);
+                return 1;
+            }
+            char *end;
+            double value = strtod(argv[++i], &end);
+            if (*argv[i] == '\0' || *end != '\0' || !(value >= 0) || value > 1e6) {
+                fprintf(stderr, "Error: Invalid value '%s' for %s\n", argv[i], arg);
+                return 1;
+            }
+            if (strcmp(arg, "--user-rate") == 0) {
+                server_options.admission.user_rate = value;
+            } else {
+                server_options.admission.user_burst = value;
+            }
+        } else if (strcmp(arg, "--threads") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing value for --threads\n");
+                return 1;
+            }
+            batch_config.threads = atoi(argv[++i]);
+            if (batch_config.threads <= 0) {
+                fprintf(stderr, "Error: Invalid thread count '%s'\n", argv[i]);
+                return 1;
+            }
         } else {
             fprintf(stderr, "Error: Unknown option '%s'\n", arg);
             print_usage(argv[0]);
@@ -252,6 +506,51 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    if ((serve ? 1 : 0) + (socket_path ? 1 : 0) + (batch_config.input_path ? 1 : 0) + (zygote_path ? 1 : 0) > 1) {
+        fprintf(stderr, "Error: --serve, --socket, --batch and --zygote cannot be combined\n");
+        return 1;
+    }
+
+    if (processes > 1 && !serve) {
+        fprintf(stderr, "Error: --prefork requires --serve\n");
+        return 1;
+    }
+    // Split the cores between processes unless told otherwise
+    if (processes > 1 && !workers_set) {
+        server_options.workers = server_options.workers / processes > 0 ? server_options.workers / processes : 1;
+    }
+
+    if (dump_catalog) {
+        init_chat_engine();
+        OutputBuffer dump;
+        buffer_init(&dump);
+        const Catalog *catalog = catalog_acquire();
+        bool dumped = catalog_dump(catalog, &dump) && buffer_write(&dump, STDOUT_FILENO);
+        catalog_release();
+        buffer_free(&dump);
+        return dumped ? 0 : 1;
+    }
+
+    if (batch_config.input_path) {
+        init_chat_engine();
+        init_route_system();
+        return run_batch(&batch_config);
+    }
+
+    if (zygote_path) {
+        init_chat_engine();
+        init_route_system();
+        return run_zygote(zygote_path, run_zygote_child);
+    }
+
+    if (serve || socket_path) {
+        init_chat_engine();
+        init_route_system();
+        server_config.processes = processes;
+        server_config.options = server_options;
+        return serve ? run_http_server(&server_config) : run_socket_server(socket_path, &server_options);
+    }
+
     if (!single_query) {
         printf("=== Bricllm - Briconomy Navigation Assistant ===\n");
         printf("High-performance console chatbot for Briconomy app navigation\n");
@@ -268,8 +567,8 @@ int main(int argc, char **argv) {
     }
 
     const char *initial_route = route ? route : default_route_for_role(role);
-    free(current_session->context);
-    current_session->context = strdup(initial_route);
+    engine_free(current_session->context);
+    current_session->context = engine_strdup(initial_route);
     if (!current_session->context) {
         fprintf(stderr, "Error: Failed to set session route\n");
         free_session(current_session);
@@ -281,24 +580,38 @@ int main(int argc, char **argv) {
         printf("Use /role to change role, /route to set current page context\n\n");
     }
 
+    if (single_query && strlen(single_query) > get_max_message_length()) {
+        fprintf(stderr, "Error: Message exceeds %zu bytes\n", get_max_message_length());
+        free_session(current_session);
+        return 1;
+    }
+
+    if (single_query && stream_output) {
+        int exit_code = stream_query(current_session, single_query, timings);
+        free_session(current_session);
+        return exit_code;
+    }
+
     if (single_query) {
-        clock_t start_clock = clock();
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
         ChatResponse *response = process_message(current_session, single_query);
-        clock_t end_clock = clock();
-        long response_time_ms = calculate_response_time_ms(start_clock, end_clock);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        long response_time_us = elapsed_us(&start, &end);
 
         if (!response) {
             if (json_output) {
-                print_json_payload("Unable to process request", 0.0f, response_time_ms, language, role);
+                print_json_payload(NULL, "Unable to process request", response_time_us, timings, language, role);
             } else {
                 printf("Bricllm: Unable to process request\n");
             }
+            buffer_free(&json_output_buffer);
             free_session(current_session);
             return 1;
         }
 
         if (json_output) {
-            print_json_payload(response->response ? response->response : "", response->confidence, response_time_ms, language, role);
+            print_json_payload(response, "", response_time_us, timings, language, role);
         } else {
             printf("Bricllm: %s\n", response->response ? response->response : "");
             if (response->suggested_actions && response->action_count > 0) {
@@ -318,6 +631,7 @@ int main(int argc, char **argv) {
 
         int exit_code = response->escalation_needed ? 2 : 0;
         free_response(response);
+        buffer_free(&json_output_buffer);
         free_session(current_session);
         return exit_code;
     }
@@ -343,14 +657,26 @@ int main(int argc, char **argv) {
             continue;
         }
 
-        clock_t start_clock = clock();
+        if (strlen(input) > get_max_message_length()) {
+            printf("Bricllm: That message is too long. Please keep it under %zu characters.\n\n", get_max_message_length());
+            continue;
+        }
+
+        if (stream_output) {
+            stream_query(current_session, input, timings);
+            continue;
+        }
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
         ChatResponse *response = process_message(current_session, input);
-        clock_t end_clock = clock();
-        long response_time_ms = calculate_response_time_ms(start_clock, end_clock);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        long response_time_us = elapsed_us(&start, &end);
 
         if (response) {
             if (json_output) {
-                print_json_payload(response->response ? response->response : "", response->confidence, response_time_ms, current_session->language, current_session->role);
+                print_json_payload(response, "", response_time_us, timings, current_session->language,
+                                   current_session->role);
             } else {
                 printf("Bricllm: %s\n", response->response ? response->response : "");
 
@@ -375,7 +701,8 @@ int main(int argc, char **argv) {
             free_response(response);
         } else {
             if (json_output) {
-                print_json_payload("I'm sorry, I didn't understand that", 0.0f, response_time_ms, current_session->language, current_session->role);
+                print_json_payload(NULL, "I'm sorry, I didn't understand that", response_time_us, timings,
+                                   current_session->language, current_session->role);
             } else {
                 printf("Bricllm: I'm sorry, I didn't understand that. Could you please rephrase your question?\n");
                 printf("You can ask about rent payments, maintenance requests, navigation help, or type /help for commands.\n");
@@ -388,6 +715,7 @@ int main(int argc, char **argv) {
     }
 
     printf("\nGoodbye! Thank you for using Bricllm.\n");
+    buffer_free(&json_output_buffer);
     free_session(current_session);
 
     return 0;
@@ -0,0 +1,405 @@
+#include "../../include/batch_runner.h"
+#include "../../include/request_handler.h"
+#include "../../include/chat_engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BATCH_BLOCK_LINES 4096
+#define MAX_BATCH_THREADS 256
+
+typedef struct {
+    size_t start;
+    size_t length;
+} LineSpan;
+
+typedef struct {
+    char *id;
+    ChatSession *session;
+    long tail;          // last line of this session in the current block, or -1
+} BatchSession;
+
+typedef struct {
+    BatchSession *slots;
+    size_t capacity;
+    size_t count;
+} SessionMap;
+
+typedef struct {
+    size_t offset;
+    size_t length;
+    int worker;
+} LineResult;
+
+typedef struct BatchBlock BatchBlock;
+
+typedef struct {
+    BatchBlock *block;
+    int index;
+    OutputBuffer out;
+    pthread_t thread;
+    bool running;
+} BatchWorker;
+
+// Lines of one session form a chain that a single worker runs in order, so
+// multi-turn context sees its messages in sequence without extra locking.
+struct BatchBlock {
+    const char *data;
+    const LineSpan *lines;
+    long first;
+    long count;
+    long *heads;
+    long head_count;
+    long *next;              // next line of the same session, or -1
+    ChatSession **sessions;  // NULL for one-off lines
+    bool *created;
+    LineResult *results;
+    atomic_long next_head;
+};
+
+static uint64_t hash_id(const char *id) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (const unsigned char *ptr = (const unsigned char *)id; *ptr; ptr++) {
+        hash ^= *ptr;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool session_map_grow(SessionMap *map) {
+    size_t capacity = map->capacity ? map->capacity * 2 : 1024;
+    BatchSession *slots = calloc(capacity, sizeof(BatchSession));
+    if (!slots) return false;
+
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (!map->slots[i].id) continue;
+        size_t slot = hash_id(map->slots[i].id) & (capacity - 1);
+        while (slots[slot].id) slot = (slot + 1) & (capacity - 1);
+        slots[slot] = map->slots[i];
+    }
+
+    free(map->slots);
+    map->slots = slots;
+    map->capacity = capacity;
+    return true;
+}
+
+// Returns the entry for id, creating its session on first use.
+static BatchSession *session_map_get(SessionMap *map, const char *id, bool *is_new) {
+    *is_new = false;
+    if ((map->count + 1) * 2 > map->capacity && !session_map_grow(map)) {
+        return NULL;
+    }
+
+    size_t slot = hash_id(id) & (map->capacity - 1);
+    while (map->slots[slot].id) {
+        if (strcmp(map->slots[slot].id, id) == 0) return &map->slots[slot];
+        slot = (slot + 1) & (map->capacity - 1);
+    }
+
+    BatchSession *entry = &map->slots[slot];
+    entry->session = create_detached_session("batch_user", "tenant", "en");
+    entry->id = strdup(id);
+    if (!entry->session || !entry->id) {
+        free_session(entry->session);
+        free(entry->id);
+        entry->session = NULL;
+        entry->id = NULL;
+        return NULL;
+    }
+
+    // Replies report the caller's session id rather than a generated one
+    engine_free(entry->session->id);
+    entry->session->id = engine_strdup(id);
+    if (!entry->session->id) {
+        free_session(entry->session);
+        free(entry->id);
+        entry->session = NULL;
+        entry->id = NULL;
+        return NULL;
+    }
+
+    entry->tail = -1;
+    map->count++;
+    *is_new = true;
+    return entry;
+}
+
+static void session_map_free(SessionMap *map) {
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (map->slots[i].id) {
+            free(map->slots[i].id);
+            free_session(map->slots[i].session);
+        }
+    }
+    free(map->slots);
+}
+
+static void run_line(BatchWorker *worker, long line, ChatRequest *request) {
+    BatchBlock *block = worker->block;
+    const LineSpan *span = &block->lines[line];
+    const char *text = block->data + span->start;
+    long local = line - block->first;
+
+    size_t offset = worker->out.length;
+    const char *error = NULL;
+
+    if (span->length == 0) {
+        append_json_error(&worker->out, NULL, "empty line");
+    } else if (!parse_chat_request(text, span->length, request, &error)) {
+        append_json_error(&worker->out, request->correlation_id, error);
+    } else if (block->sessions[local]) {
+        run_chat_request(block->sessions[local], block->created[local], request, &worker->out);
+    } else {
+        ChatSession *session = create_detached_session(request_user_id(request), request_role(request),
+                                                       request_language(request));
+        if (session) {
+            run_chat_request(session, true, request, &worker->out);
+            free_session(session);
+        } else {
+            append_json_error(&worker->out, request->correlation_id, "Out of memory");
+        }
+    }
+
+    block->results[local].offset = offset;
+    block->results[local].length = worker->out.length - offset;
+    block->results[local].worker = worker->index;
+}
+
+static void *batch_worker_main(void *arg) {
+    BatchWorker *worker = arg;
+    BatchBlock *block = worker->block;
+
+    ChatRequest *request = malloc(sizeof(ChatRequest));
+    if (!request) return NULL;
+
+    for (;;) {
+        long head = atomic_fetch_add(&block->next_head, 1);
+        if (head >= block->head_count) break;
+
+        for (long line = block->heads[head]; line >= 0; line = block->next[line - block->first]) {
+            run_line(worker, line, request);
+        }
+    }
+
+    free(request);
+    return NULL;
+}
+
+static bool read_all(const char *path, OutputBuffer *data) {
+    FILE *file = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (!file) return false;
+
+    bool ok = true;
+    for (;;) {
+        if (!buffer_reserve(data, 65536)) {
+            ok = false;
+            break;
+        }
+        size_t read = fread(data->data + data->length, 1, 65536, file);
+        data->length += read;
+        if (read < 65536) {
+            ok = !ferror(file);
+            break;
+        }
+    }
+
+    if (file != stdin) fclose(file);
+    return ok;
+}
+
+static bool split_lines(const OutputBuffer *data, LineSpan **lines_out, long *count_out) {
+    long capacity = 1024;
+    long count = 0;
+    LineSpan *lines = malloc((size_t)capacity * sizeof(LineSpan));
+    if (!lines) return false;
+
+    size_t start = 0;
+    while (start < data->length) {
+        const char *newline = memchr(data->data + start, '\n', data->length - start);
+        size_t end = newline ? (size_t)(newline - data->data) : data->length;
+
+        if (count == capacity) {
+            capacity *= 2;
+            LineSpan *grown = realloc(lines, (size_t)capacity * sizeof(LineSpan));
+            if (!grown) {
+                free(lines);
+                return false;
+            }
+            lines = grown;
+        }
+
+        size_t length = end - start;
+        if (length > 0 && data->data[end - 1] == '\r') length--;
+        lines[count].start = start;
+        lines[count].length = length;
+        count++;
+
+        start = end + 1;
+    }
+
+    *lines_out = lines;
+    *count_out = count;
+    return true;
+}
+
+static bool plan_block(BatchBlock *block, SessionMap *map) {
+    block->head_count = 0;
+    atomic_store(&block->next_head, 0);
+
+    for (long i = 0; i < block->count; i++) {
+        long line = block->first + i;
+        const LineSpan *span = &block->lines[line];
+        char session_id[CHAT_REQUEST_MAX_ID + 1];
+
+        block->next[i] = -1;
+        block->sessions[i] = NULL;
+        block->created[i] = false;
+
+        if (span->length == 0 ||
+            json_get_string(block->data + span->start, span->length, "sessionId", session_id, sizeof(session_id)) != 1 ||
+            session_id[0] == '\0') {
+            block->heads[block->head_count++] = line;
+            continue;
+        }
+
+        bool is_new;
+        BatchSession *entry = session_map_get(map, session_id, &is_new);
+        if (!entry) return false;
+
+        block->sessions[i] = entry->session;
+        block->created[i] = is_new;
+
+        if (entry->tail >= block->first) {
+            block->next[entry->tail - block->first] = line;
+        } else {
+            block->heads[block->head_count++] = line;
+        }
+        entry->tail = line;
+    }
+
+    return true;
+}
+
+static int online_cores(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+}
+
+int run_batch(const BatchConfig *config) {
+    int thread_count = config->threads > 0 ? config->threads : online_cores();
+    if (thread_count > MAX_BATCH_THREADS) thread_count = MAX_BATCH_THREADS;
+
+    OutputBuffer input;
+    buffer_init(&input);
+    if (!read_all(config->input_path, &input)) {
+        fprintf(stderr, "Error: Cannot read '%s'\n", config->input_path);
+        buffer_free(&input);
+        return 1;
+    }
+
+    LineSpan *lines = NULL;
+    long line_count = 0;
+    if (!split_lines(&input, &lines, &line_count)) {
+        fprintf(stderr, "Error: Out of memory reading '%s'\n", config->input_path);
+        buffer_free(&input);
+        return 1;
+    }
+
+    FILE *output = strcmp(config->output_path, "-") == 0 ? stdout : fopen(config->output_path, "wb");
+    if (!output) {
+        fprintf(stderr, "Error: Cannot write '%s'\n", config->output_path);
+        free(lines);
+        buffer_free(&input);
+        return 1;
+    }
+
+    BatchBlock block;
+    block.data = input.data;
+    block.lines = lines;
+    block.heads = malloc(BATCH_BLOCK_LINES * sizeof(long));
+    block.next = malloc(BATCH_BLOCK_LINES * sizeof(long));
+    block.sessions = malloc(BATCH_BLOCK_LINES * sizeof(ChatSession *));
+    block.created = malloc(BATCH_BLOCK_LINES * sizeof(bool));
+    block.results = malloc(BATCH_BLOCK_LINES * sizeof(LineResult));
+
+    BatchWorker *workers = calloc((size_t)thread_count, sizeof(BatchWorker));
+
+    SessionMap map = {NULL, 0, 0};
+    int exit_code = 0;
+
+    if (!block.heads || !block.next || !block.sessions || !block.created || !block.results || !workers) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit_code = 1;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int w = 0; w < thread_count && exit_code == 0; w++) {
+        workers[w].block = &block;
+        workers[w].index = w;
+        buffer_init(&workers[w].out);
+    }
+
+    // Blocks run one after another, so a session's chains stay ordered across blocks
+    for (long first = 0; first < line_count && exit_code == 0; first += BATCH_BLOCK_LINES) {
+        block.first = first;
+        block.count = line_count - first < BATCH_BLOCK_LINES ? line_count - first : BATCH_BLOCK_LINES;
+
+        if (!plan_block(&block, &map)) {
+            fprintf(stderr, "Error: Out of memory creating sessions\n");
+            exit_code = 1;
+            break;
+        }
+
+        // Any worker that fails to start just leaves its share to the others
+        for (int w = 0; w < thread_count; w++) {
+            buffer_reset(&workers[w].out);
+            workers[w].running = w > 0 &&
+                                 pthread_create(&workers[w].thread, NULL, batch_worker_main, &workers[w]) == 0;
+        }
+        batch_worker_main(&workers[0]);
+        for (int w = 1; w < thread_count; w++) {
+            if (workers[w].running) pthread_join(workers[w].thread, NULL);
+        }
+
+        for (long i = 0; i < block.count; i++) {
+            const LineResult *result = &block.results[i];
+            fwrite(workers[result->worker].out.data + result->offset, 1, result->length, output);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+
+    if (fflush(output) != 0) {
+        fprintf(stderr, "Error: Failed writing '%s'\n", config->output_path);
+        exit_code = 1;
+    }
+    if (output != stdout) fclose(output);
+
+    if (exit_code == 0) {
+        fprintf(stderr, "Batch complete: %ld lines in %.3fs (%.0f lines/s, %d threads)\n",
+                line_count, elapsed, elapsed > 0 ? (double)line_count / elapsed : 0.0, thread_count);
+    }
+
+    for (int w = 0; workers && w < thread_count; w++) {
+        buffer_free(&workers[w].out);
+    }
+    session_map_free(&map);
+    free(workers);
+    free(block.heads);
+    free(block.next);
+    free(block.sessions);
+    free(block.created);
+    free(block.results);
+    free(lines);
+    buffer_free(&input);
+    return exit_code;
+}
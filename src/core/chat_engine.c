@@ -1,89 +1,186 @@
 #include "../../include/bricllm.h"
 #include "../../include/chat_engine.h"
 #include "../../include/pattern_cache.h"
+#include "../../include/catalog.h"
+#include "../../include/nav_graph.h"
 #include "../../include/conversation_context.h"
+#include "../../include/dialog.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
 
+static pthread_mutex_t session_lock = PTHREAD_MUTEX_INITIALIZER;
 static ChatSession **sessions = NULL;
 static int session_count = 0;
 static int max_sessions = 1000;
+static size_t max_message_length = DEFAULT_MAX_MESSAGE_LENGTH;
+static int shard_index = 0;
+static int shard_count = 1;
 
-static ResponsePattern *patterns = NULL;
-static int pattern_count = 0;
-
-static void load_response_patterns(void);
 static char *generate_session_id(void);
-static ChatResponse *create_response_from_pattern(ResponsePattern *pattern, const char *message);
+static ChatResponse *create_response_from_pattern(ResponsePattern *pattern, const char *message,
+                                                  const TokenStream *tokens, const ChatSession *session);
+static ChatResponse *dialog_response(ChatSession *session, const char *message, const TokenStream *tokens);
+static bool names_page(const ChatSession *session, const TokenStream *tokens);
 
 void init_chat_engine(void) {
+    // Queries forked from a zygote arrive already initialized
+    if (sessions) return;
+
     srand(time(NULL));
 
-    sessions = malloc(max_sessions * sizeof(ChatSession *));
+    sessions = engine_malloc(max_sessions * sizeof(ChatSession *));
     if (!sessions) {
-        log_message("ERROR", "Failed to allocate memory for sessions");
+        LOG_ERROR("Failed to allocate memory for sessions");
         exit(1);
     }
 
     init_pattern_cache();
-    load_response_patterns();
-    log_message("INFO", "Chat engine initialized with %d patterns", pattern_count);
+    if (!catalog_init()) {
+        exit(1);
+    }
+
+    const Catalog *catalog = catalog_acquire();
+    LOG_INFO("Chat engine initialized with %d patterns", catalog->rule_count);
+    catalog_release();
+}
+
+void set_max_message_length(size_t length) {
+    max_message_length = length;
+}
+
+size_t get_max_message_length(void) {
+    return max_message_length;
+}
+
+// Answers depend on the page only through its candidate rules
+static uint64_t cache_scope(const Catalog *catalog, const char *route, const char *role) {
+    const RouteGuide *guide = find_route_guide(route, role);
+    if (!catalog_route_candidates(catalog, guide)) return catalog->checksum;
+    return catalog->checksum ^ ((uint64_t)guide->hash * 0x9e3779b97f4a7c15ULL);
+}
+
+static uint64_t monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// Charges the time since the last lap to stage
+static uint64_t lap(uint64_t *stage_ns, ResponseStage stage, uint64_t since) {
+    uint64_t now = monotonic_ns();
+    stage_ns[stage] += now - since;
+    return now;
+}
+
+static ChatResponse *with_timings(ChatResponse *response, const uint64_t *stage_ns) {
+    if (response) memcpy(response->stage_ns, stage_ns, sizeof(response->stage_ns));
+    return response;
 }
 
 ChatResponse *process_message(ChatSession *session, const char *message) {
     if (!session || !message) {
         return NULL;
     }
+    uint64_t stage_ns[STAGE_COUNT] = {0};
+    uint64_t mark = monotonic_ns();
+    AllocationCount allocated_before;
+    engine_allocations(&allocated_before);
+
+    // Fuzzy matching is quadratic in message length
+    if (strnlen(message, max_message_length + 1) > max_message_length) {
+        LOG_WARN("Rejected %zu byte message from user %s", strlen(message), session->user_id);
+        return NULL;
+    }
 
     session->last_activity = time(NULL);
     session->message_count++;
 
-    log_message("INFO", "Processing message from user %s: %.50s",
+    LOG_DEBUG("Processing message from user %s: %.50s",
                 session->user_id, message);
 
     if (session->conv_context) {
         add_to_history(session->conv_context, message);
     }
 
-    char *resolved_message = NULL;
-    const char *query_message = message;
-    
+    // Split once; the dialog, pronoun resolver and directions read the same tokens
+    TokenStream tokens;
+    tokenize_message(message, &tokens);
+    mark = lap(stage_ns, STAGE_NORMALIZE, mark);
+
     if (session->conv_context) {
-        resolved_message = resolve_pronoun(session->conv_context, message);
-        if (resolved_message) {
-            query_message = resolved_message;
-            log_message("INFO", "Resolved message: '%s' -> '%s'", message, resolved_message);
+        ChatResponse *reply = dialog_response(session, message, &tokens);
+        if (reply) {
+            lap(stage_ns, STAGE_RESOLVE, mark);
+            return with_timings(reply, stage_ns);
         }
     }
 
-    ResponsePattern *pattern = cache_lookup(query_message, session->role, session->language);
-    bool from_cache = (pattern != NULL);
-    
+    // Follow-ups are cached under what the user typed plus a fingerprint of
+    // the context their rewrite reads, so a hit needs no rewrite at all
+    uint64_t fingerprint = context_fingerprint(session->conv_context, &tokens);
+    char *resolved_message = NULL;
+    const char *query_message = message;
+    mark = lap(stage_ns, STAGE_RESOLVE, mark);
+
+    // Cache hits are private copies, so the pattern is always ours to free.
+    // The lookup, match and store all see the catalog pinned here.
+    const Catalog *catalog = catalog_acquire();
+    uint64_t scope = cache_scope(catalog, session->context, session->role) ^ (fingerprint * 0xc2b2ae3d27d4eb4fULL);
+    ResponsePattern *pattern = cache_lookup(message, session->role, session->language, scope);
+    mark = lap(stage_ns, STAGE_CACHE, mark);
+
     if (!pattern) {
-        pattern = find_matching_pattern(query_message, session->role, session->language);
-        
+        if (fingerprint) {
+            resolved_message = resolve_pronoun(session->conv_context, &tokens);
+            if (resolved_message) {
+                query_message = resolved_message;
+                LOG_DEBUG("Resolved message: '%s' -> '%s'", message, resolved_message);
+            }
+            mark = lap(stage_ns, STAGE_RESOLVE, mark);
+        }
+        pattern = find_matching_pattern(query_message, session->role, session->language, session->context);
+        mark = lap(stage_ns, STAGE_MATCH, mark);
+
         if (pattern) {
-            cache_store(query_message, session->role, session->language, pattern);
+            cache_store(message, session->role, session->language, scope, pattern);
         }
     }
+    catalog_release();
+    mark = lap(stage_ns, STAGE_CACHE, mark);
 
     ChatResponse *response;
     if (pattern) {
-        response = create_response_from_pattern(pattern, query_message);
+        // Directions read the page out of the rewritten question ("Where is
+        // Payments section?"), so hits that need them rewrite after all
+        bool navigation = strcmp(pattern->category, "navigation") == 0;
+        if (navigation && fingerprint && !resolved_message) {
+            resolved_message = resolve_pronoun(session->conv_context, &tokens);
+            if (resolved_message) query_message = resolved_message;
+            mark = lap(stage_ns, STAGE_RESOLVE, mark);
+        }
+        TokenStream query_tokens;
+        const TokenStream *answer_tokens = &tokens;
+        if (navigation && resolved_message) {
+            tokenize_message(resolved_message, &query_tokens);
+            answer_tokens = &query_tokens;
+        }
+
+        response = create_response_from_pattern(pattern, query_message, answer_tokens, session);
         if (!response) {
-            if (!from_cache) {
-                free(pattern->response);
-                free(pattern->category);
-                free(pattern);
-            }
-            free(resolved_message);
+            engine_free(pattern->response);
+            engine_free(pattern->category);
+            engine_free(pattern);
+            engine_free(resolved_message);
             return NULL;
         }
 
-        log_message("INFO", "Found matching pattern: %s (confidence: %.2f)",
+        LOG_DEBUG("Found matching pattern: %s (confidence: %.2f)",
                     pattern->category, response->confidence);
 
         if (session->conv_context) {
@@ -91,15 +188,15 @@ ChatResponse *process_message(ChatSession *session, const char *message) {
                           pattern->category,
                           NULL,
                           pattern->category);
+            dialog_start(&session->conv_context->dialog, pattern->category, session->role, answer_tokens,
+                         navigation && names_page(session, answer_tokens));
         }
         
-        if (!from_cache && pattern) {
-            if (pattern->response) free(pattern->response);
-            if (pattern->category) free(pattern->category);
-            free(pattern);
-        }
+        engine_free(pattern->response);
+        engine_free(pattern->category);
+        engine_free(pattern);
     } else {
-        response = malloc(sizeof(ChatResponse));
+        response = engine_malloc(sizeof(ChatResponse));
         if (!response) return NULL;
 
         response->message_id = generate_uuid();
@@ -163,109 +260,122 @@ ChatResponse *process_message(ChatSession *session, const char *message) {
             selected_response = default_responses[variation];
         }
         
-        response->response = strdup(selected_response);
-        response->response_type = strdup("text");
+        response->response = engine_strdup(selected_response);
+        response->response_type = engine_strdup("text");
 
-        log_message("WARN", "No matching pattern found for user %s", session->user_id);
+        LOG_WARN("No matching pattern found for user %s", session->user_id);
     }
 
-    free(resolved_message);
-    return response;
+    engine_free(resolved_message);
+    lap(stage_ns, STAGE_RENDER, mark);
+    AllocationCount allocated_after;
+    engine_allocations(&allocated_after);
+    LOG_DEBUG("Answered user %s with %llu allocations (%llu bytes)", session->user_id,
+              (unsigned long long)(allocated_after.allocations - allocated_before.allocations),
+              (unsigned long long)(allocated_after.bytes - allocated_before.bytes));
+    return with_timings(response, stage_ns);
 }
 
-ChatSession *create_session(const char *user_id, const char *role, const char *language) {
+ChatSession *create_detached_session(const char *user_id, const char *role, const char *language) {
     if (!user_id || !role || !language) {
         return NULL;
     }
 
-    if (session_count >= max_sessions) {
-        cleanup_expired_sessions();
-        if (session_count >= max_sessions) {
-            log_message("ERROR", "Maximum session limit reached");
-            return NULL;
-        }
-    }
-
-    ChatSession *session = malloc(sizeof(ChatSession));
+    ChatSession *session = engine_malloc(sizeof(ChatSession));
     if (!session) return NULL;
 
     session->id = generate_session_id();
     if (!session->id) {
-        free(session);
+        engine_free(session);
         return NULL;
     }
 
-    session->user_id = strdup(user_id);
+    session->user_id = engine_strdup(user_id);
     if (!session->user_id) {
-        free(session->id);
-        free(session);
+        engine_free(session->id);
+        engine_free(session);
         return NULL;
     }
 
-    session->role = strdup(role);
+    session->role = engine_strdup(role);
     if (!session->role) {
-        free(session->id);
-        free(session->user_id);
-        free(session);
+        engine_free(session->id);
+        engine_free(session->user_id);
+        engine_free(session);
         return NULL;
     }
 
-    session->language = strdup(language);
+    session->language = engine_strdup(language);
     if (!session->language) {
-        free(session->id);
-        free(session->user_id);
-        free(session->role);
-        free(session);
+        engine_free(session->id);
+        engine_free(session->user_id);
+        engine_free(session->role);
+        engine_free(session);
         return NULL;
     }
 
     session->created_at = time(NULL);
     session->last_activity = time(NULL);
     session->message_count = 0;
-    session->context = strdup("/");
+    session->context = engine_strdup("/");
     if (!session->context) {
-        free(session->id);
-        free(session->user_id);
-        free(session->role);
-        free(session->language);
-        free(session);
+        engine_free(session->id);
+        engine_free(session->user_id);
+        engine_free(session->role);
+        engine_free(session->language);
+        engine_free(session);
         return NULL;
     }
 
     session->conv_context = create_conversation_context();
     if (!session->conv_context) {
-        free(session->id);
-        free(session->user_id);
-        free(session->role);
-        free(session->language);
-        free(session->context);
-        free(session);
+        engine_free(session->id);
+        engine_free(session->user_id);
+        engine_free(session->role);
+        engine_free(session->language);
+        engine_free(session->context);
+        engine_free(session);
         return NULL;
     }
 
+    return session;
+}
+
+static void cleanup_expired_sessions_locked(void);
+
+// Caller holds session_lock
+static ChatSession *register_new_session(const char *user_id, const char *role, const char *language) {
+    if (session_count >= max_sessions) {
+        cleanup_expired_sessions_locked();
+        if (session_count >= max_sessions) {
+            LOG_ERROR("Maximum session limit reached");
+            return NULL;
+        }
+    }
+
+    ChatSession *session = create_detached_session(user_id, role, language);
+    if (!session) return NULL;
+
     sessions[session_count++] = session;
 
-    log_message("INFO", "Created new session %s for user %s (role: %s)",
+    LOG_INFO("Created new session %s for user %s (role: %s)",
                 session->id, user_id, role);
 
     return session;
 }
 
-void free_session(ChatSession *session) {
-    if (!session) return;
+ChatSession *create_session(const char *user_id, const char *role, const char *language) {
+    if (!user_id || !role || !language) {
+        return NULL;
+    }
 
-    free(session->id);
-    free(session->user_id);
-    free(session->role);
-    free(session->language);
-    free(session->context);
-    free_conversation_context(session->conv_context);
-    free(session);
+    pthread_mutex_lock(&session_lock);
+    ChatSession *session = register_new_session(user_id, role, language);
+    pthread_mutex_unlock(&session_lock);
+    return session;
 }
 
-ChatSession *find_session(const char *session_id) {
-    if (!session_id) return NULL;
-
+static ChatSession *find_session_locked(const char *session_id) {
     for (int i = 0; i < session_count; i++) {
         if (sessions[i] && strcmp(sessions[i]->id, session_id) == 0) {
             return sessions[i];
@@ -274,13 +384,83 @@ ChatSession *find_session(const char *session_id) {
     return NULL;
 }
 
+ChatSession *get_or_create_session(const char *session_id, const char *user_id,
+                                   const char *role, const char *language, bool *created) {
+    if (created) *created = false;
+    if (!user_id || !role || !language) return NULL;
+
+    pthread_mutex_lock(&session_lock);
+
+    ChatSession *session = session_id ? find_session_locked(session_id) : NULL;
+    if (session) {
+        // Touched under the lock so expiry cannot free it before the caller runs
+        session->last_activity = time(NULL);
+        pthread_mutex_unlock(&session_lock);
+        return session;
+    }
+
+    session = register_new_session(user_id, role, language);
+    if (session && session_id) {
+        char *id = engine_strdup(session_id);
+        if (id) {
+            engine_free(session->id);
+            session->id = id;
+        } else {
+            // Still registered under its generated id; it expires like any other
+            session = NULL;
+        }
+    }
+
+    pthread_mutex_unlock(&session_lock);
+
+    if (session && created) *created = true;
+    return session;
+}
+
+bool is_valid_role(const char *role) {
+    if (!role) return false;
+    return strcmp(role, "tenant") == 0 || strcmp(role, "caretaker") == 0 || strcmp(role, "manager") == 0 || strcmp(role, "admin") == 0;
+}
+
+bool is_valid_language(const char *language) {
+    if (!language) return false;
+    return strcmp(language, "en") == 0 || strcmp(language, "zu") == 0;
+}
+
+void free_session(ChatSession *session) {
+    if (!session) return;
+
+    engine_free(session->id);
+    engine_free(session->user_id);
+    engine_free(session->role);
+    engine_free(session->language);
+    engine_free(session->context);
+    free_conversation_context(session->conv_context);
+    engine_free(session);
+}
+
+ChatSession *find_session(const char *session_id) {
+    if (!session_id) return NULL;
+
+    pthread_mutex_lock(&session_lock);
+    ChatSession *session = find_session_locked(session_id);
+    pthread_mutex_unlock(&session_lock);
+    return session;
+}
+
 void cleanup_expired_sessions(void) {
+    pthread_mutex_lock(&session_lock);
+    cleanup_expired_sessions_locked();
+    pthread_mutex_unlock(&session_lock);
+}
+
+static void cleanup_expired_sessions_locked(void) {
     time_t now = time(NULL);
     int timeout = 3600;
 
     for (int i = 0; i < session_count; i++) {
         if (sessions[i] && (now - sessions[i]->last_activity) > timeout) {
-            log_message("INFO", "Cleaning up expired session %s", sessions[i]->id);
+            LOG_INFO("Cleaning up expired session %s", sessions[i]->id);
             free_session(sessions[i]);
             sessions[i] = NULL;
         }
@@ -295,58 +475,174 @@ void cleanup_expired_sessions(void) {
     session_count = write_index;
 }
 
-static void load_response_patterns(void) {
-    static char *nav_keywords[] = {"where", "find", "navigate", "how to"};
-    static char *payment_keywords[] = {"rent", "pay", "payment", "due"};
-
-    pattern_count = 2;
-    patterns = malloc(pattern_count * sizeof(ResponsePattern));
-    if (!patterns) {
-        log_message("ERROR", "Failed to allocate memory for patterns");
-        return;
-    }
-
-    patterns[0].keywords = nav_keywords;
-    patterns[0].keyword_count = 4;
-    patterns[0].response = "I can help you navigate. Use the bottom navigation buttons to access different sections of the app.";
-    patterns[0].category = "navigation";
-    patterns[0].user_role = "all";
-    patterns[0].language = "en";
-    patterns[0].confidence_threshold = 0.7f;
-
-    patterns[1].keywords = payment_keywords;
-    patterns[1].keyword_count = 4;
-    patterns[1].response = "To pay your rent: 1) Go to Payments section 2) Select your property 3) Choose payment method 4) Confirm payment";
-    patterns[1].category = "payment";
-    patterns[1].user_role = "tenant";
-    patterns[1].language = "en";
-    patterns[1].confidence_threshold = 0.8f;
-
-    log_message("INFO", "Loaded %d response patterns", pattern_count);
+void set_session_shard(int index, int count) {
+    shard_index = index;
+    shard_count = count > 0 ? count : 1;
+    srand((unsigned int)time(NULL) ^ (unsigned int)getpid());
+}
+
+int session_shard(const char *session_id, int count) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *ptr = (const unsigned char *)session_id; *ptr; ptr++) {
+        hash ^= *ptr;
+        hash *= 16777619u;
+    }
+    return (int)(hash % (uint32_t)count);
 }
 
 static char *generate_session_id(void) {
-    char *session_id = malloc(33);
+    char *session_id = engine_malloc(33);
     if (!session_id) return NULL;
 
-    snprintf(session_id, 33, "%08x%04x%04x%04x%012llx",
-             (unsigned int)rand(), (unsigned int)rand() % 0xFFFF, (unsigned int)rand() % 0xFFFF,
-             (unsigned int)rand() % 0xFFFF, (long long)((long long)rand() << 32) | rand());
+    // Expected shard_count attempts; the id must route back to this worker
+    do {
+        snprintf(session_id, 33, "%08x%04x%04x%04x%012llx",
+                 (unsigned int)rand(), (unsigned int)rand() % 0xFFFF, (unsigned int)rand() % 0xFFFF,
+                 (unsigned int)rand() % 0xFFFF, (long long)((long long)rand() << 32) | rand());
+    } while (shard_count > 1 && session_shard(session_id, shard_count) != shard_index);
 
     return session_id;
 }
 
-static ChatResponse *create_response_from_pattern(ResponsePattern *pattern, const char *message) {
-    static char action_type_nav[] = "navigation";
-    static char action_label_dash[] = "View Dashboard";
-    static char action_target_dash[] = "/dashboard";
+#define MAX_DIRECTIONS 8
 
-    ChatResponse *response = malloc(sizeof(ChatResponse));
+// The last page of the role that the message names, or -1
+static int mentioned_page(const Catalog *catalog, const TokenStream *tokens, const char *role) {
+    int page = -1;
+    for (int i = 0; i < tokens->count; i++) {
+        int found = find_navigation_page(catalog->routes, catalog->route_count, tokens->tokens[i].text,
+                                         tokens->tokens[i].length, role);
+        if (found >= 0) page = found;
+    }
+    return page;
+}
+
+static char *directions_text(const NavigationStep *steps, int count) {
+    OutputBuffer text;
+    buffer_init(&text);
+    bool ok = true;
+    if (count == 0) {
+        ok = buffer_append_str(&text, "You're already there.");
+    }
+    for (int i = 0; i < count && ok; i++) {
+        ok = buffer_appendf(&text, "%s%s", i == 0 ? "Tap " : ", then ", steps[i].label);
+    }
+    if (ok && count > 0) ok = buffer_append_str(&text, ".");
+    if (!ok || !buffer_append(&text, "", 1)) {
+        buffer_free(&text);
+        return NULL;
+    }
+    return text.data;
+}
+
+static bool attach_steps(ChatResponse *response, const NavigationStep *steps, int count) {
+    if (count == 0) return true;
+    response->suggested_actions = engine_calloc((size_t)count, sizeof(SuggestedAction *));
+    if (!response->suggested_actions) return false;
+
+    for (int i = 0; i < count; i++) {
+        SuggestedAction *action = engine_malloc(sizeof(SuggestedAction));
+        if (!action) return false;
+        action->type = engine_strdup("navigation");
+        action->label = engine_strdup(steps[i].label);
+        action->target = engine_strdup(steps[i].page->navigation.route);
+        action->allocation_type = ACTION_ALLOCATED;
+        response->suggested_actions[response->action_count++] = action;
+        if (!action->type || !action->label || !action->target) return false;
+    }
+    return true;
+}
+
+// Directions from the current page to the one the message names, by lookup in
+// the catalog's next-hop table; without a destination, where this page's
+// buttons lead. The steps are copied, so the response outlives the catalog.
+static bool add_directions(ChatResponse *response, const ChatSession *session, const TokenStream *tokens) {
+    const Catalog *catalog = catalog_acquire();
+    const RouteGuide *here = find_route_guide(session->context, session->role);
+    int from = here ? (int)(here - catalog->routes)
+                    : find_navigation_page(catalog->routes, catalog->route_count, "home", 4, session->role);
+    int to = mentioned_page(catalog, tokens, session->role);
+
+    NavigationStep steps[MAX_DIRECTIONS];
+    int count = to >= 0 ? find_navigation_path(catalog->navigation, catalog->routes, from, to, steps, MAX_DIRECTIONS) : -1;
+    bool ok = true;
+    if (count >= 0) {
+        char *text = directions_text(steps, count);
+        if (text) {
+            engine_free(response->response);
+            response->response = text;
+        } else {
+            ok = false;
+        }
+    } else {
+        count = find_navigation_exits(catalog->navigation, catalog->routes, from, steps, MAX_DIRECTIONS);
+    }
+    if (ok) ok = attach_steps(response, steps, count);
+    catalog_release();
+    return ok;
+}
+
+static bool names_page(const ChatSession *session, const TokenStream *tokens) {
+    const Catalog *catalog = catalog_acquire();
+    bool named = mentioned_page(catalog, tokens, session->role) >= 0;
+    catalog_release();
+    return named;
+}
+
+// A short "cancel" or "which one?" steers the waiting intent, unless another
+// rule answers it ("stop the leak" is a maintenance question)
+static bool is_control(const ChatSession *session, const char *message, const TokenStream *tokens) {
+    const char *intent = dialog_control_category(&session->conv_context->dialog, tokens);
+    if (!intent) return false;
+    ResponsePattern *pattern = find_matching_pattern(message, session->role, session->language, session->context);
+    bool other = pattern && pattern->category && strcmp(pattern->category, intent) != 0;
+    free_pattern(pattern);
+    return !other;
+}
+
+// Follow-ups to an open intent ("which one?", "by card") are answered from
+// the dialog table without matching; NULL when the message is not one
+static ChatResponse *dialog_response(ChatSession *session, const char *message, const TokenStream *tokens) {
+    DialogState *dialog = &session->conv_context->dialog;
+    bool page = dialog->state == DIALOG_NAVIGATE_PAGE && names_page(session, tokens);
+    bool control = is_control(session, message, tokens);
+    char text[512];
+    const char *category = NULL;
+    DialogOutcome outcome = dialog_follow_up(dialog, tokens, page, control, text, sizeof(text), &category);
+    if (outcome == DIALOG_PASS) return NULL;
+
+    if (outcome == DIALOG_DIRECTIONS) {
+        snprintf(text, sizeof(text), "I can't find a way there from this page.");
+    } else if (outcome == DIALOG_PAGES) {
+        snprintf(text, sizeof(text), "These are the pages you can open from here.");
+    }
+
+    ChatResponse *response = engine_malloc(sizeof(ChatResponse));
+    if (!response) return NULL;
+    response->message_id = generate_uuid();
+    response->response = engine_strdup(text);
+    response->response_type = engine_strdup(category);
+    response->confidence = 0.9f;
+    response->escalation_needed = false;
+    response->suggested_actions = NULL;
+    response->action_count = 0;
+
+    if (outcome != DIALOG_ANSWER && !add_directions(response, session, tokens)) {
+        free_response(response);
+        return NULL;
+    }
+    LOG_DEBUG("Dialog answered follow-up from user %s (%s)", session->user_id, category);
+    return response;
+}
+
+static ChatResponse *create_response_from_pattern(ResponsePattern *pattern, const char *message,
+                                                  const TokenStream *tokens, const ChatSession *session) {
+    ChatResponse *response = engine_malloc(sizeof(ChatResponse));
     if (!response) return NULL;
 
     response->message_id = generate_uuid();
-    response->response = strdup(pattern->response);
-    response->response_type = strdup(pattern->category);
+    response->response = engine_strdup(pattern->response);
+    response->response_type = engine_strdup(pattern->category);
 
     if (pattern->keywords && pattern->keyword_count > 0) {
         response->confidence = calculate_similarity(message, pattern->keywords[0]);
@@ -358,17 +654,9 @@ static ChatResponse *create_response_from_pattern(ResponsePattern *pattern, cons
     response->suggested_actions = NULL;
     response->action_count = 0;
 
-    if (strcmp(pattern->category, "navigation") == 0) {
-        response->suggested_actions = malloc(2 * sizeof(SuggestedAction *));
-        response->action_count = 1;
-
-        SuggestedAction *action = malloc(sizeof(SuggestedAction));
-        action->type = action_type_nav;
-        action->label = action_label_dash;
-        action->target = action_target_dash;
-        action->allocation_type = ACTION_STATIC;
-
-        response->suggested_actions[0] = action;
+    if (strcmp(pattern->category, "navigation") == 0 && !add_directions(response, session, tokens)) {
+        free_response(response);
+        return NULL;
     }
 
     return response;
@@ -377,24 +665,24 @@ static ChatResponse *create_response_from_pattern(ResponsePattern *pattern, cons
 void free_response(ChatResponse *response) {
     if (!response) return;
 
-    free(response->message_id);
-    free(response->response);
-    free(response->response_type);
+    engine_free(response->message_id);
+    engine_free(response->response);
+    engine_free(response->response_type);
 
     if (response->suggested_actions) {
         for (int i = 0; i < response->action_count; i++) {
             if (response->suggested_actions[i]) {
                 SuggestedAction *action = response->suggested_actions[i];
                 if (action->allocation_type == ACTION_ALLOCATED) {
-                    if (action->type) free(action->type);
-                    if (action->label) free(action->label);
-                    if (action->target) free(action->target);
+                    if (action->type) engine_free(action->type);
+                    if (action->label) engine_free(action->label);
+                    if (action->target) engine_free(action->target);
                 }
-                free(action);
+                engine_free(action);
             }
         }
-        free(response->suggested_actions);
+        engine_free(response->suggested_actions);
     }
 
-    free(response);
+    engine_free(response);
 }
\ No newline at end of file
@@ -0,0 +1,254 @@
+#include "../../include/dialog.h"
+#include <stdio.h>
+#include <string.h>
+
+typedef enum {
+    EVENT_OTHER,                // anything else ends the dialog
+    EVENT_FILL,                 // fills the slot the state waits for
+    EVENT_WHICH,                // "which one?", "what are my options?"
+    EVENT_CANCEL,
+    DIALOG_EVENTS
+} DialogEvent;
+
+typedef enum {
+    REPLY_NONE,
+    REPLY_LIST_METHODS,
+    REPLY_PAY,
+    REPLY_LIST_ISSUES,
+    REPLY_ASK_URGENCY,
+    REPLY_LIST_URGENCY,
+    REPLY_REPORT,
+    REPLY_DIRECTIONS,
+    REPLY_PAGES,
+    REPLY_CANCELLED
+} DialogReply;
+
+typedef struct {
+    uint8_t next;               // DialogStateId
+    uint8_t reply;              // DialogReply
+} DialogTransition;
+
+static const DialogTransition transitions[DIALOG_STATES][DIALOG_EVENTS] = {
+    //                          OTHER                    FILL                                      WHICH                                        CANCEL
+    [DIALOG_IDLE] =           {{DIALOG_IDLE, REPLY_NONE}, {DIALOG_IDLE, REPLY_NONE},                 {DIALOG_IDLE, REPLY_NONE},                   {DIALOG_IDLE, REPLY_NONE}},
+    [DIALOG_PAY_METHOD] =     {{DIALOG_IDLE, REPLY_NONE}, {DIALOG_IDLE, REPLY_PAY},                  {DIALOG_PAY_METHOD, REPLY_LIST_METHODS},     {DIALOG_IDLE, REPLY_CANCELLED}},
+    [DIALOG_REPORT_ISSUE] =   {{DIALOG_IDLE, REPLY_NONE}, {DIALOG_REPORT_URGENCY, REPLY_ASK_URGENCY}, {DIALOG_REPORT_ISSUE, REPLY_LIST_ISSUES},    {DIALOG_IDLE, REPLY_CANCELLED}},
+    [DIALOG_REPORT_URGENCY] = {{DIALOG_IDLE, REPLY_NONE}, {DIALOG_IDLE, REPLY_REPORT},               {DIALOG_REPORT_URGENCY, REPLY_LIST_URGENCY}, {DIALOG_IDLE, REPLY_CANCELLED}},
+    [DIALOG_NAVIGATE_PAGE] =  {{DIALOG_IDLE, REPLY_NONE}, {DIALOG_IDLE, REPLY_DIRECTIONS},           {DIALOG_NAVIGATE_PAGE, REPLY_PAGES},         {DIALOG_IDLE, REPLY_CANCELLED}}
+};
+
+// What each state waits for; -1 for the page, which the caller resolves
+static const struct {
+    const char *category;
+    int8_t slot;
+} waiting[DIALOG_STATES] = {
+    [DIALOG_IDLE] = {NULL, -1},
+    [DIALOG_PAY_METHOD] = {"payment", SLOT_METHOD},
+    [DIALOG_REPORT_ISSUE] = {"maintenance", SLOT_ISSUE},
+    [DIALOG_REPORT_URGENCY] = {"maintenance", SLOT_URGENCY},
+    [DIALOG_NAVIGATE_PAGE] = {"navigation", -1}
+};
+
+static const struct {
+    const char *word;
+    uint8_t slot;
+    uint8_t value;
+} slot_words[] = {
+    {"card", SLOT_METHOD, METHOD_CARD}, {"credit", SLOT_METHOD, METHOD_CARD}, {"debit", SLOT_METHOD, METHOD_CARD},
+    {"visa", SLOT_METHOD, METHOD_CARD}, {"mastercard", SLOT_METHOD, METHOD_CARD},
+    {"bank", SLOT_METHOD, METHOD_BANK}, {"eft", SLOT_METHOD, METHOD_BANK}, {"transfer", SLOT_METHOD, METHOD_BANK},
+    {"deposit", SLOT_METHOD, METHOD_BANK},
+    {"cash", SLOT_METHOD, METHOD_CASH},
+
+    {"plumbing", SLOT_ISSUE, ISSUE_PLUMBING}, {"leak", SLOT_ISSUE, ISSUE_PLUMBING}, {"leaking", SLOT_ISSUE, ISSUE_PLUMBING},
+    {"pipe", SLOT_ISSUE, ISSUE_PLUMBING}, {"tap", SLOT_ISSUE, ISSUE_PLUMBING}, {"toilet", SLOT_ISSUE, ISSUE_PLUMBING},
+    {"drain", SLOT_ISSUE, ISSUE_PLUMBING}, {"geyser", SLOT_ISSUE, ISSUE_PLUMBING}, {"water", SLOT_ISSUE, ISSUE_PLUMBING},
+    {"electrical", SLOT_ISSUE, ISSUE_ELECTRICAL}, {"electricity", SLOT_ISSUE, ISSUE_ELECTRICAL},
+    {"power", SLOT_ISSUE, ISSUE_ELECTRICAL}, {"light", SLOT_ISSUE, ISSUE_ELECTRICAL}, {"lights", SLOT_ISSUE, ISSUE_ELECTRICAL},
+    {"plug", SLOT_ISSUE, ISSUE_ELECTRICAL}, {"socket", SLOT_ISSUE, ISSUE_ELECTRICAL},
+    {"appliance", SLOT_ISSUE, ISSUE_APPLIANCE}, {"fridge", SLOT_ISSUE, ISSUE_APPLIANCE}, {"stove", SLOT_ISSUE, ISSUE_APPLIANCE},
+    {"oven", SLOT_ISSUE, ISSUE_APPLIANCE}, {"washing", SLOT_ISSUE, ISSUE_APPLIANCE}, {"microwave", SLOT_ISSUE, ISSUE_APPLIANCE},
+    {"building", SLOT_ISSUE, ISSUE_BUILDING}, {"door", SLOT_ISSUE, ISSUE_BUILDING}, {"window", SLOT_ISSUE, ISSUE_BUILDING},
+    {"wall", SLOT_ISSUE, ISSUE_BUILDING}, {"roof", SLOT_ISSUE, ISSUE_BUILDING}, {"ceiling", SLOT_ISSUE, ISSUE_BUILDING},
+    {"lock", SLOT_ISSUE, ISSUE_BUILDING},
+
+    {"urgent", SLOT_URGENCY, URGENCY_URGENT}, {"emergency", SLOT_URGENCY, URGENCY_URGENT},
+    {"yes", SLOT_URGENCY, URGENCY_URGENT}, {"asap", SLOT_URGENCY, URGENCY_URGENT}, {"flooding", SLOT_URGENCY, URGENCY_URGENT},
+    {"no", SLOT_URGENCY, URGENCY_ROUTINE}, {"routine", SLOT_URGENCY, URGENCY_ROUTINE},     // "no" only alone, see slot_value
+    {"later", SLOT_URGENCY, URGENCY_ROUTINE}, {"wait", SLOT_URGENCY, URGENCY_ROUTINE}
+};
+
+static const char *which_words[] = {"which", "options", "choices", "kinds", "types", "list"};
+static const char *cancel_words[] = {"cancel", "nevermind", "stop", "forget"};
+// Longer messages with a cancel or "which" word are new questions ("my tap won't stop leaking")
+#define CONTROL_MAX_WORDS 4
+// Turn an urgent word into a routine one: "not urgent", "isn't an emergency"
+static const char *negations[] = {"not", "isn't", "isnt"};
+
+#define COUNT(array) (int)(sizeof(array) / sizeof((array)[0]))
+
+static bool has_word(const TokenStream *tokens, const char *const *words, int count) {
+    for (int i = 0; i < tokens->count; i++) {
+        for (int w = 0; w < count; w++) {
+            if (token_is(&tokens->tokens[i], words[w])) return true;
+        }
+    }
+    return false;
+}
+
+static bool negated(const TokenStream *tokens, int index) {
+    for (int i = index - 2; i < index; i++) {
+        if (i < 0) continue;
+        for (int w = 0; w < COUNT(negations); w++) {
+            if (token_is(&tokens->tokens[i], negations[w])) return true;
+        }
+    }
+    return false;
+}
+
+static bool is_slot_word(const Token *token, int slot) {
+    for (int w = 0; w < COUNT(slot_words); w++) {
+        if (slot_words[w].slot == slot && token_is(token, slot_words[w].word)) return true;
+    }
+    return false;
+}
+
+// First value the message gives for slot, or 0. A bare "no" declines the
+// urgency question, but "no power" or "no water" is an outage, so urgent.
+static uint8_t slot_value(const TokenStream *tokens, int slot) {
+    for (int i = 0; i < tokens->count; i++) {
+        for (int w = 0; w < COUNT(slot_words); w++) {
+            if (slot_words[w].slot != slot || !token_is(&tokens->tokens[i], slot_words[w].word)) continue;
+            if (token_is(&tokens->tokens[i], "no") && tokens->count > 1) {
+                if (i + 1 < tokens->count && is_slot_word(&tokens->tokens[i + 1], SLOT_ISSUE)) return URGENCY_URGENT;
+                continue;
+            }
+            if (slot_words[w].value == URGENCY_URGENT && negated(tokens, i)) return URGENCY_ROUTINE;
+            return slot_words[w].value;
+        }
+    }
+    return 0;
+}
+
+static bool fills_state(DialogState *dialog, const TokenStream *tokens, bool names_page) {
+    if (dialog->state == DIALOG_NAVIGATE_PAGE) return names_page;
+    int slot = waiting[dialog->state].slot;
+    if (slot < 0) return false;
+    uint8_t value = slot_value(tokens, slot);
+    if (value) dialog->slots[slot] = value;
+    return value != 0;
+}
+
+// Keeps taking the fill transition while the message also answers the next
+// question, so "my tap is leaking, it's urgent" skips asking about urgency
+static DialogReply fill_ahead(DialogState *dialog, const TokenStream *tokens, bool names_page, DialogReply reply) {
+    while (fills_state(dialog, tokens, names_page)) {
+        const DialogTransition *transition = &transitions[dialog->state][EVENT_FILL];
+        dialog->state = transition->next;
+        reply = transition->reply;
+    }
+    return reply;
+}
+
+void dialog_start(DialogState *dialog, const char *category, const char *role, const TokenStream *tokens,
+                  bool names_page) {
+    memset(dialog, 0, sizeof(*dialog));
+    if (!category) return;
+
+    // Paying rent and reporting issues are tenant tasks; every role navigates
+    bool tenant = role && strcmp(role, "tenant") == 0;
+    if (tenant && strcmp(category, "payment") == 0) {
+        dialog->state = DIALOG_PAY_METHOD;
+    } else if (tenant && strcmp(category, "maintenance") == 0) {
+        dialog->state = DIALOG_REPORT_ISSUE;
+    } else if (strcmp(category, "navigation") == 0) {
+        dialog->state = DIALOG_NAVIGATE_PAGE;
+    }
+    // The matched answer already replied to this message
+    fill_ahead(dialog, tokens, names_page, REPLY_NONE);
+}
+
+static const char *const pay_replies[METHODS] = {
+    [METHOD_CARD] = "To pay by card, open Payments, tap Pay Rent and choose Card. The receipt shows under View History straight away.",
+    [METHOD_BANK] = "To pay by bank transfer, open Payments, tap Pay Rent and choose EFT, using your unit number as the reference. Transfers can take two working days to reflect.",
+    [METHOD_CASH] = "Cash is paid at the property office. Ask for a receipt; the payment shows under View History once it is captured."
+};
+static const char *const issue_names[ISSUES] = {
+    [ISSUE_PLUMBING] = "plumbing", [ISSUE_ELECTRICAL] = "electrical",
+    [ISSUE_APPLIANCE] = "appliance", [ISSUE_BUILDING] = "building"
+};
+
+static void write_reply(const DialogState *dialog, DialogReply reply, char *text, size_t text_size) {
+    switch (reply) {
+    case REPLY_LIST_METHODS:
+        snprintf(text, text_size, "You can pay rent by card, bank transfer (EFT) or cash at the property office. Which would you like to use?");
+        break;
+    case REPLY_PAY:
+        snprintf(text, text_size, "%s", pay_replies[dialog->slots[SLOT_METHOD]]);
+        break;
+    case REPLY_LIST_ISSUES:
+        snprintf(text, text_size, "I can log plumbing, electrical, appliance or building issues. Which kind is it?");
+        break;
+    case REPLY_ASK_URGENCY:
+        snprintf(text, text_size, "Got it, %s %s issue. Is it urgent, like flooding, no power or a door that won't lock?",
+                 strchr("aeiou", issue_names[dialog->slots[SLOT_ISSUE]][0]) ? "an" : "a",
+                 issue_names[dialog->slots[SLOT_ISSUE]]);
+        break;
+    case REPLY_LIST_URGENCY:
+        snprintf(text, text_size, "Urgent issues such as flooding, no power or a broken lock reach the caretaker right away; "
+                 "everything else is scheduled. Is yours urgent?");
+        break;
+    case REPLY_REPORT:
+        snprintf(text, text_size, "Open Requests, tap New Request and pick the %s category. %s", issue_names[dialog->slots[SLOT_ISSUE]],
+                 dialog->slots[SLOT_URGENCY] == URGENCY_URGENT
+                     ? "Mark it Urgent and the caretaker is alerted right away."
+                     : "The caretaker will schedule a visit, and you can follow it under View Status.");
+        break;
+    case REPLY_CANCELLED:
+        snprintf(text, text_size, "No problem. Let me know if you need anything else.");
+        break;
+    default:
+        text[0] = '\0';
+        break;
+    }
+}
+
+const char *dialog_control_category(const DialogState *dialog, const TokenStream *tokens) {
+    if (dialog->state == DIALOG_IDLE || dialog->state >= DIALOG_STATES || tokens->count > CONTROL_MAX_WORDS) {
+        return NULL;
+    }
+    bool control = has_word(tokens, cancel_words, COUNT(cancel_words)) || has_word(tokens, which_words, COUNT(which_words));
+    return control ? waiting[dialog->state].category : NULL;
+}
+
+DialogOutcome dialog_follow_up(DialogState *dialog, const TokenStream *tokens, bool names_page, bool control,
+                               char *text, size_t text_size, const char **category) {
+    if (dialog->state == DIALOG_IDLE || dialog->state >= DIALOG_STATES) return DIALOG_PASS;
+
+    *category = waiting[dialog->state].category;
+    DialogEvent event = EVENT_OTHER;
+    if (fills_state(dialog, tokens, names_page)) {
+        event = EVENT_FILL;
+    } else if (control && has_word(tokens, cancel_words, COUNT(cancel_words))) {
+        event = EVENT_CANCEL;
+    } else if (control && has_word(tokens, which_words, COUNT(which_words))) {
+        event = EVENT_WHICH;
+    }
+
+    const DialogTransition *transition = &transitions[dialog->state][event];
+    dialog->state = transition->next;
+    DialogReply reply = transition->reply;
+    if (event == EVENT_FILL) reply = fill_ahead(dialog, tokens, names_page, reply);
+
+    switch (reply) {
+    case REPLY_NONE:
+        return DIALOG_PASS;
+    case REPLY_DIRECTIONS:
+        return DIALOG_DIRECTIONS;
+    case REPLY_PAGES:
+        return DIALOG_PAGES;
+    default:
+        write_reply(dialog, reply, text, text_size);
+        return DIALOG_ANSWER;
+    }
+}
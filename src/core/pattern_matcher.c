@@ -1,9 +1,11 @@
 #include "../../include/bricllm.h"
+#include "../../include/catalog.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <stdatomic.h>
 
 int levenshtein_distance(const char *str1, const char *str2) {
     int len1 = strlen(str1);
@@ -12,12 +14,12 @@ int levenshtein_distance(const char *str1, const char *str2) {
     if (len1 == 0) return len2;
     if (len2 == 0) return len1;
 
-    int *prev_row = malloc((len1 + 1) * sizeof(int));
-    int *curr_row = malloc((len1 + 1) * sizeof(int));
+    int *prev_row = engine_malloc((len1 + 1) * sizeof(int));
+    int *curr_row = engine_malloc((len1 + 1) * sizeof(int));
     
     if (!prev_row || !curr_row) {
-        free(prev_row);
-        free(curr_row);
+        engine_free(prev_row);
+        engine_free(curr_row);
         return len1 > len2 ? len1 : len2;
     }
 
@@ -47,8 +49,8 @@ int levenshtein_distance(const char *str1, const char *str2) {
 
     int result = prev_row[len1];
     
-    free(prev_row);
-    free(curr_row);
+    engine_free(prev_row);
+    engine_free(curr_row);
 
     return result;
 }
@@ -57,8 +59,8 @@ float calculate_similarity(const char *str1, const char *str2) {
     if (!str1 || !str2) return 0.0f;
     if (strlen(str1) == 0 || strlen(str2) == 0) return 0.0f;
 
-    char *str1_lower = strdup(str1);
-    char *str2_lower = strdup(str2);
+    char *str1_lower = engine_strdup(str1);
+    char *str2_lower = engine_strdup(str2);
 
     for (int i = 0; str1_lower[i]; i++) {
         str1_lower[i] = tolower(str1_lower[i]);
@@ -70,8 +72,8 @@ float calculate_similarity(const char *str1, const char *str2) {
     int distance = levenshtein_distance(str1_lower, str2_lower);
     int max_len = fmax(strlen(str1_lower), strlen(str2_lower));
 
-    free(str1_lower);
-    free(str2_lower);
+    engine_free(str1_lower);
+    engine_free(str2_lower);
 
     if (max_len == 0) return 1.0f;
 
@@ -85,7 +87,7 @@ char **extract_words(const char *text, int *word_count) {
     }
 
     int capacity = 16;
-    char **words = malloc(capacity * sizeof(char *));
+    char **words = engine_malloc(capacity * sizeof(char *));
     if (!words) {
         *word_count = 0;
         return NULL;
@@ -93,25 +95,27 @@ char **extract_words(const char *text, int *word_count) {
     
     *word_count = 0;
     
-    char *text_copy = strdup(text);
+    char *text_copy = engine_strdup(text);
     if (!text_copy) {
-        free(words);
+        engine_free(words);
         *word_count = 0;
         return NULL;
     }
     
-    char *token = strtok(text_copy, " \t\n\r");
+    // strtok_r: batch and server workers split words concurrently
+    char *position = NULL;
+    char *token = strtok_r(text_copy, " \t\n\r", &position);
     
     while (token != NULL) {
         if (*word_count >= capacity) {
             capacity *= 2;
-            char **new_words = realloc(words, capacity * sizeof(char *));
+            char **new_words = engine_realloc(words, capacity * sizeof(char *));
             if (!new_words) {
                 for (int i = 0; i < *word_count; i++) {
-                    free(words[i]);
+                    engine_free(words[i]);
                 }
-                free(words);
-                free(text_copy);
+                engine_free(words);
+                engine_free(text_copy);
                 *word_count = 0;
                 return NULL;
             }
@@ -119,13 +123,13 @@ char **extract_words(const char *text, int *word_count) {
         }
         
         int len = strlen(token);
-        words[*word_count] = malloc((len + 1) * sizeof(char));
+        words[*word_count] = engine_malloc((len + 1) * sizeof(char));
         if (!words[*word_count]) {
             for (int i = 0; i < *word_count; i++) {
-                free(words[i]);
+                engine_free(words[i]);
             }
-            free(words);
-            free(text_copy);
+            engine_free(words);
+            engine_free(text_copy);
             *word_count = 0;
             return NULL;
         }
@@ -135,30 +139,106 @@ char **extract_words(const char *text, int *word_count) {
         }
         
         (*word_count)++;
-        token = strtok(NULL, " \t\n\r");
+        token = strtok_r(NULL, " \t\n\r", &position);
     }
 
-    free(text_copy);
+    engine_free(text_copy);
     
     if (*word_count == 0) {
-        free(words);
+        engine_free(words);
         return NULL;
     }
     
     return words;
 }
 
+static const char *identity_keywords[] = {"human", "robot", "bot", "ai", "real"};
+static const char *identity_responses[] = {
+    "I'm an assistant designed to help you use the Briconomy app effectively. How can I help you today?",
+    "I'm here to guide you through the app. What would you like to know?",
+    "I focus on helping with Briconomy features. What can I assist you with?"
+};
+static const char *greeting_keywords[] = {"hello", "hi", "hey", "greetings"};
+static const char *greeting_responses[] = {
+    "Hello! I'm here to help you navigate the Briconomy app. What can I assist you with today?",
+    "Hi there! How can I help you with the app today?",
+    "Hey! What would you like to know about Briconomy?"
+};
+static const char *smalltalk_keywords[] = {"doing", "feel", "feeling"};
+static const char *smalltalk_exclude[] = {"bot", "robot", "ai", "human"};
+static const char *smalltalk_responses[] = {
+    "I'm functioning well, thanks for asking! How can I help you with the Briconomy app?"
+};
+static const char *offtopic_keywords[] = {"weather", "day", "today", "time", "date"};
+static const char *offtopic_responses[] = {
+    "I focus on helping with the Briconomy app. Is there something specific about the app I can help you with?",
+    "I'm here to assist with app features. What would you like to know about Briconomy?",
+    "My specialty is the Briconomy app. How can I help you navigate it?"
+};
+static const char *payment_keywords[] = {"rent", "pay", "payment"};
+static const char *payment_responses[] = {
+    "You can manage your rent payments through the Payments section. Check your payment history and make payments using your preferred method. Available buttons: [Home, Payments, Requests, Profile]"
+};
+static const char *thanks_keywords[] = {"thanks", "thank", "thankyou"};
+static const char *thanks_responses[] = {
+    "You're welcome! Let me know if you need anything else."
+};
+static const char *entertainment_keywords[] = {"joke", "story", "game"};
+static const char *entertainment_responses[] = {
+    "I'm here to help with the Briconomy app. What would you like to know about managing your property?"
+};
+static const char *maintenance_keywords[] = {"maintenance", "repair", "broken"};
+static const char *maintenance_responses[] = {
+    "You can report maintenance issues through the Requests section. Include photos and describe the problem for faster resolution. Available buttons: [Home, Payments, Requests, Profile]"
+};
+static const char *navigation_keywords[] = {"where", "find", "navigate", "how"};
+static const char *tenant_navigation_responses[] = {
+    "As a tenant, your main navigation buttons are: [Home, Payments, Requests, Profile]. What would you like to do?"
+};
+static const char *caretaker_navigation_responses[] = {
+    "As a caretaker, your navigation buttons are: [Tasks, Schedule, History, Profile]. What would you like to do?"
+};
+static const char *manager_navigation_responses[] = {
+    "As a manager, your navigation buttons are: [Dashboard, Properties, Leases, Payments]. What would you like to do?"
+};
+static const char *navigation_responses[] = {
+    "I can help you navigate the Briconomy app. What are you looking for?"
+};
+
+#define RULE_LIST(list) list, (int)(sizeof(list) / sizeof(list[0]))
+
+// Ties go to the earlier rule, so role-specific rules precede their fallback
+static const CatalogRule builtin_rules[] = {
+    {"identity", NULL, 0.92f, 0.8f, 0, RULE_LIST(identity_keywords), NULL, 0, RULE_LIST(identity_responses)},
+    {"greeting", NULL, 0.95f, 0.9f, 0, RULE_LIST(greeting_keywords), NULL, 0, RULE_LIST(greeting_responses)},
+    {"smalltalk", NULL, 0.88f, 0.75f, 5, RULE_LIST(smalltalk_keywords), RULE_LIST(smalltalk_exclude), RULE_LIST(smalltalk_responses)},
+    {"offtopic", NULL, 0.85f, 0.7f, 0, RULE_LIST(offtopic_keywords), NULL, 0, RULE_LIST(offtopic_responses)},
+    {"payment", NULL, 0.9f, 0.8f, 0, RULE_LIST(payment_keywords), NULL, 0, RULE_LIST(payment_responses)},
+    {"thanks", NULL, 0.95f, 0.9f, 0, RULE_LIST(thanks_keywords), NULL, 0, RULE_LIST(thanks_responses)},
+    {"entertainment", NULL, 0.88f, 0.8f, 0, RULE_LIST(entertainment_keywords), NULL, 0, RULE_LIST(entertainment_responses)},
+    {"maintenance", NULL, 0.9f, 0.8f, 0, RULE_LIST(maintenance_keywords), NULL, 0, RULE_LIST(maintenance_responses)},
+    {"navigation", "tenant", 0.8f, 0.7f, 0, RULE_LIST(navigation_keywords), NULL, 0, RULE_LIST(tenant_navigation_responses)},
+    {"navigation", "caretaker", 0.8f, 0.7f, 0, RULE_LIST(navigation_keywords), NULL, 0, RULE_LIST(caretaker_navigation_responses)},
+    {"navigation", "manager", 0.8f, 0.7f, 0, RULE_LIST(navigation_keywords), NULL, 0, RULE_LIST(manager_navigation_responses)},
+    {"navigation", NULL, 0.8f, 0.7f, 0, RULE_LIST(navigation_keywords), NULL, 0, RULE_LIST(navigation_responses)}
+};
+
+void load_builtin_rules(const CatalogRule **rules, int *count) {
+    *rules = builtin_rules;
+    *count = (int)(sizeof(builtin_rules) / sizeof(builtin_rules[0]));
+}
+
 static ResponsePattern *create_simple_pattern(const char *response, const char *category, float score) {
-    ResponsePattern *pattern = malloc(sizeof(ResponsePattern));
+    ResponsePattern *pattern = engine_malloc(sizeof(ResponsePattern));
     if (!pattern) return NULL;
     
-    pattern->response = strdup(response);
-    pattern->category = strdup(category);
+    pattern->response = engine_strdup(response);
+    pattern->category = engine_strdup(category);
     
     if (!pattern->response || !pattern->category) {
-        free(pattern->response);
-        free(pattern->category);
-        free(pattern);
+        engine_free(pattern->response);
+        engine_free(pattern->category);
+        engine_free(pattern);
         return NULL;
     }
     
@@ -171,223 +251,146 @@ static ResponsePattern *create_simple_pattern(const char *response, const char *
     return pattern;
 }
 
-ResponsePattern *find_matching_pattern(const char *message, const char *role, const char *language) {
-    if (!message || !role || !language) {
-        return NULL;
+static bool word_in_list(const char *word, const char *const *list, int count) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(word, list[i]) == 0) return true;
     }
+    return false;
+}
 
-    log_message("INFO", "Searching for pattern: role=%s, lang=%s, message=%.50s",
-                role, language, message);
+static bool rule_applies(const CatalogRule *rule, char **words, int word_count, const char *role) {
+    if (rule->role && strcmp(rule->role, role) != 0) return false;
+    if (rule->max_words > 0 && word_count > rule->max_words) return false;
+    for (int i = 0; i < word_count && rule->exclude_count > 0; i++) {
+        if (word_in_list(words[i], rule->exclude, rule->exclude_count)) return false;
+    }
+    return true;
+}
 
-    int word_count;
-    char **message_words = extract_words(message, &word_count);
+// Page candidates get this on top of their score, so they win close calls
+// against rules from elsewhere in the app; a tie also goes to the page
+#define ROUTE_BOOST 0.05f
 
-    if (!message_words || word_count == 0) {
-        return NULL;
-    }
+static atomic_uint_least64_t page_answers;
+static atomic_uint_least64_t full_searches;
 
-    ResponsePattern *best_match = NULL;
-    float best_score = 0.0f;
+void match_counters(uint64_t *page, uint64_t *full) {
+    *page = atomic_load_explicit(&page_answers, memory_order_relaxed);
+    *full = atomic_load_explicit(&full_searches, memory_order_relaxed);
+}
 
-    static const char *identity_responses[] = {
-        "I'm an assistant designed to help you use the Briconomy app effectively. How can I help you today?",
-        "I'm here to guide you through the app. What would you like to know?",
-        "I focus on helping with Briconomy features. What can I assist you with?"
-    };
-    
-    static const char *greetings[] = {
-        "Hello! I'm here to help you navigate the Briconomy app. What can I assist you with today?",
-        "Hi there! How can I help you with the app today?",
-        "Hey! What would you like to know about Briconomy?"
-    };
-    
-    static const char *offtopic_responses[] = {
-        "I focus on helping with the Briconomy app. Is there something specific about the app I can help you with?",
-        "I'm here to assist with app features. What would you like to know about Briconomy?",
-        "My specialty is the Briconomy app. How can I help you navigate it?"
-    };
+typedef struct {
+    const CatalogRule *rule;
+    float score;
+} RuleMatch;
 
-    for (int i = 0; i < word_count; i++) {
-        if (strcmp(message_words[i], "human") == 0 ||
-            strcmp(message_words[i], "robot") == 0 ||
-            strcmp(message_words[i], "bot") == 0 ||
-            strcmp(message_words[i], "ai") == 0 ||
-            strcmp(message_words[i], "real") == 0) {
-
-            float score = 0.92f;
-            if (score > best_score) {
-                if (best_match) {
-                    free(best_match->response);
-                    free(best_match->category);
-                    free(best_match);
-                }
-                best_match = create_simple_pattern(identity_responses[rand() % 3], "identity", 0.8f);
-                if (best_match) best_score = score;
-            }
-        }
+static bool matches(const CatalogRule *rule, const char *word, char **words, int word_count, const char *role) {
+    return word_in_list(word, rule->keywords, rule->keyword_count) && rule_applies(rule, words, word_count, role);
+}
 
-        if (strcmp(message_words[i], "hello") == 0 ||
-            strcmp(message_words[i], "hi") == 0 ||
-            strcmp(message_words[i], "hey") == 0 ||
-            strcmp(message_words[i], "greetings") == 0) {
-
-            float score = 0.95f;
-            if (score > best_score) {
-                if (best_match) {
-                    free(best_match->response);
-                    free(best_match->category);
-                    free(best_match);
-                }
-                best_match = create_simple_pattern(greetings[rand() % 3], "greeting", 0.9f);
-                if (best_match) best_score = score;
-            }
-        }
+static void consider_rule(RuleMatch *best, const Catalog *catalog, int id, float score, int word,
+                          char **words, int word_count, const char *role) {
+    if (score <= best->score) return;
+    if (!matches(&catalog->rules[id], words[word], words, word_count, role)) return;
+    *best = (RuleMatch){&catalog->rules[id], score};
+}
 
-        if ((strcmp(message_words[i], "doing") == 0 || strcmp(message_words[i], "feel") == 0 || strcmp(message_words[i], "feeling") == 0) && word_count < 6) {
-            int has_bot_words = 0;
-            for (int j = 0; j < word_count; j++) {
-                if (strcmp(message_words[j], "bot") == 0 || strcmp(message_words[j], "robot") == 0 || 
-                    strcmp(message_words[j], "ai") == 0 || strcmp(message_words[j], "human") == 0) {
-                    has_bot_words = 1;
-                    break;
-                }
-            }
-            if (has_bot_words) continue;
-
-            float score = 0.88f;
-            if (score > best_score) {
-                if (best_match) {
-                    free(best_match->response);
-                    free(best_match->category);
-                    free(best_match);
-                }
-                best_match = create_simple_pattern("I'm functioning well, thanks for asking! How can I help you with the Briconomy app?", "smalltalk", 0.75f);
-                if (best_match) best_score = score;
-            }
-        }
+static bool is_candidate(const uint64_t *candidates, int id) {
+    return candidates && (candidates[id / 64] >> (id % 64)) & 1;
+}
 
-        if (strcmp(message_words[i], "weather") == 0 ||
-            strcmp(message_words[i], "day") == 0 ||
-            strcmp(message_words[i], "today") == 0 ||
-            strcmp(message_words[i], "time") == 0 ||
-            strcmp(message_words[i], "date") == 0) {
-
-            float score = 0.85f;
-            if (score > best_score) {
-                if (best_match) {
-                    free(best_match->response);
-                    free(best_match->category);
-                    free(best_match);
-                }
-                best_match = create_simple_pattern(offtopic_responses[rand() % 3], "offtopic", 0.7f);
-                if (best_match) best_score = score;
+// Earlier words win ties, then earlier rules
+static RuleMatch match_candidates(const Catalog *catalog, const uint64_t *candidates,
+                                  char **words, int word_count, const char *role) {
+    RuleMatch best = {NULL, 0.0f};
+    for (int i = 0; i < word_count; i++) {
+        for (int w = 0; w < catalog->candidate_words; w++) {
+            for (uint64_t bits = candidates[w]; bits; bits &= bits - 1) {
+                int id = w * 64 + __builtin_ctzll(bits);
+                consider_rule(&best, catalog, id, catalog->rules[id].score + ROUTE_BOOST, i, words, word_count, role);
             }
         }
+    }
+    return best;
+}
 
-        if (strcmp(message_words[i], "rent") == 0 ||
-            strcmp(message_words[i], "pay") == 0 ||
-            strcmp(message_words[i], "payment") == 0) {
+// Only rules outside the page that outscore best can replace it, so they
+// are tried highest score first and the search stops at best's score
+static void match_outside(const Catalog *catalog, const uint64_t *candidates, RuleMatch *best,
+                          char **words, int word_count, const char *role) {
+    for (int i = 0; i < word_count; i++) {
+        for (int k = 0; k < catalog->rule_count; k++) {
+            int id = catalog->rules_by_score[k];
+            const CatalogRule *rule = &catalog->rules[id];
+            if (rule->score <= best->score) break;
+            if (is_candidate(candidates, id)) continue;
+            if (!matches(rule, words[i], words, word_count, role)) continue;
+            *best = (RuleMatch){rule, rule->score};
+        }
+    }
+}
 
-            float score = 0.9f;
-            if (score > best_score) {
-                if (best_match) {
-                    free(best_match->response);
-                    free(best_match->category);
-                    free(best_match);
-                }
-                best_match = create_simple_pattern("You can manage your rent payments through the Payments section. Check your payment history and make payments using your preferred method. Available buttons: [Home, Payments, Requests, Profile]", "payment", 0.8f);
-                if (best_match) best_score = score;
-            }
+static RuleMatch match_all(const Catalog *catalog, char **words, int word_count, const char *role) {
+    RuleMatch best = {NULL, 0.0f};
+    for (int i = 0; i < word_count; i++) {
+        for (int r = 0; r < catalog->rule_count; r++) {
+            consider_rule(&best, catalog, r, catalog->rules[r].score, i, words, word_count, role);
         }
+    }
+    return best;
+}
 
-        if (strcmp(message_words[i], "thanks") == 0 ||
-            strcmp(message_words[i], "thank") == 0 ||
-            strcmp(message_words[i], "thankyou") == 0) {
+ResponsePattern *find_matching_pattern(const char *message, const char *role, const char *language, const char *route) {
+    if (!message || !role || !language) {
+        return NULL;
+    }
 
-            float score = 0.95f;
-            if (score > best_score) {
-                if (best_match) {
-                    free(best_match->response);
-                    free(best_match->category);
-                    free(best_match);
-                }
-                best_match = create_simple_pattern("You're welcome! Let me know if you need anything else.", "thanks", 0.9f);
-                if (best_match) best_score = score;
-            }
-        }
+    LOG_DEBUG("Searching for pattern: role=%s, lang=%s, route=%s, message=%.50s",
+                role, language, route ? route : "-", message);
 
-        if (strcmp(message_words[i], "joke") == 0 ||
-            strcmp(message_words[i], "story") == 0 ||
-            strcmp(message_words[i], "game") == 0) {
+    int word_count;
+    char **message_words = extract_words(message, &word_count);
 
-            float score = 0.88f;
-            if (score > best_score) {
-                if (best_match) {
-                    free(best_match->response);
-                    free(best_match->category);
-                    free(best_match);
-                }
-                best_match = create_simple_pattern("I'm here to help with the Briconomy app. What would you like to know about managing your property?", "entertainment", 0.8f);
-                if (best_match) best_score = score;
-            }
-        }
+    if (!message_words || word_count == 0) {
+        return NULL;
+    }
 
-        if (strcmp(message_words[i], "maintenance") == 0 ||
-            strcmp(message_words[i], "repair") == 0 ||
-            strcmp(message_words[i], "broken") == 0) {
+    const Catalog *catalog = catalog_acquire();
+    const RouteGuide *guide = route ? find_route_guide(route, role) : NULL;
+    const uint64_t *candidates = catalog_route_candidates(catalog, guide);
 
-            float score = 0.9f;
-            if (score > best_score) {
-                if (best_match) {
-                    free(best_match->response);
-                    free(best_match->category);
-                    free(best_match);
-                }
-                best_match = create_simple_pattern("You can report maintenance issues through the Requests section. Include photos and describe the problem for faster resolution. Available buttons: [Home, Payments, Requests, Profile]", "maintenance", 0.8f);
-                if (best_match) best_score = score;
-            }
+    // The page's own rules first; the rest only when one of them could win
+    RuleMatch best;
+    if (!candidates) {
+        best = match_all(catalog, message_words, word_count, role);
+        atomic_fetch_add_explicit(&full_searches, 1, memory_order_relaxed);
+    } else {
+        best = match_candidates(catalog, candidates, message_words, word_count, role);
+        if (best.rule && best.score >= catalog_route_outside_score(catalog, guide)) {
+            atomic_fetch_add_explicit(&page_answers, 1, memory_order_relaxed);
+        } else {
+            match_outside(catalog, candidates, &best, message_words, word_count, role);
+            atomic_fetch_add_explicit(&full_searches, 1, memory_order_relaxed);
         }
+    }
 
-        if (strcmp(message_words[i], "where") == 0 ||
-            strcmp(message_words[i], "find") == 0 ||
-            strcmp(message_words[i], "navigate") == 0 ||
-            strcmp(message_words[i], "how") == 0) {
-
-            float score = 0.8f;
-            if (score > best_score) {
-                if (best_match) {
-                    free(best_match->response);
-                    free(best_match->category);
-                    free(best_match);
-                }
-                
-                const char *nav_response;
-                if (strcmp(role, "tenant") == 0) {
-                    nav_response = "As a tenant, your main navigation buttons are: [Home, Payments, Requests, Profile]. What would you like to do?";
-                } else if (strcmp(role, "caretaker") == 0) {
-                    nav_response = "As a caretaker, your navigation buttons are: [Tasks, Schedule, History, Profile]. What would you like to do?";
-                } else if (strcmp(role, "manager") == 0) {
-                    nav_response = "As a manager, your navigation buttons are: [Dashboard, Properties, Leases, Payments]. What would you like to do?";
-                } else {
-                    nav_response = "I can help you navigate the Briconomy app. What are you looking for?";
-                }
-                
-                best_match = create_simple_pattern(nav_response, "navigation", 0.7f);
-                if (best_match) best_score = score;
-            }
-        }
+    ResponsePattern *best_match = NULL;
+    if (best.rule) {
+        int pick = best.rule->response_count > 1 ? rand() % best.rule->response_count : 0;
+        best_match = create_simple_pattern(best.rule->responses[pick], best.rule->category, best.rule->confidence);
     }
+    catalog_release();
 
     for (int i = 0; i < word_count; i++) {
-        free(message_words[i]);
+        engine_free(message_words[i]);
     }
-    free(message_words);
+    engine_free(message_words);
 
     if (best_match) {
-        log_message("INFO", "Found pattern match: category=%s, score=%.2f",
-                    best_match->category, best_score);
+        LOG_DEBUG("Found pattern match: category=%s, score=%.2f",
+                    best_match->category, best.score);
     } else {
-        log_message("INFO", "No pattern match found");
+        LOG_DEBUG("No pattern match found");
     }
 
     return best_match;
@@ -398,14 +401,14 @@ void free_pattern(ResponsePattern *pattern) {
 
     if (pattern->keywords) {
         for (int i = 0; i < pattern->keyword_count; i++) {
-            free(pattern->keywords[i]);
+            engine_free(pattern->keywords[i]);
         }
-        free(pattern->keywords);
+        engine_free(pattern->keywords);
     }
 
-    free(pattern->response);
-    free(pattern->category);
-    free(pattern->user_role);
-    free(pattern->language);
-    free(pattern);
+    engine_free(pattern->response);
+    engine_free(pattern->category);
+    engine_free(pattern->user_role);
+    engine_free(pattern->language);
+    engine_free(pattern);
 }
\ No newline at end of file
@@ -0,0 +1,430 @@
+#include "../../include/request_handler.h"
+#include "../../include/chat_engine.h"
+#include "../../include/route_types.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static bool read_field(const char *body, size_t length, const char *key, char *out, size_t out_size) {
+    int found = json_get_string(body, length, key, out, out_size);
+    if (found == 0) {
+        out[0] = '\0';
+    }
+    return found >= 0;
+}
+
+static size_t skip_digits(const char *value, size_t i, size_t length) {
+    while (i < length && value[i] >= '0' && value[i] <= '9') i++;
+    return i;
+}
+
+// The whole value must follow JSON's number grammar: -?int frac? exp?
+static bool is_json_number(const char *value, size_t length) {
+    size_t i = 0;
+    if (i < length && value[i] == '-') i++;
+    if (i < length && value[i] == '0') {
+        i++;
+    } else {
+        size_t start = i;
+        i = skip_digits(value, i, length);
+        if (i == start) return false;
+    }
+    if (i < length && value[i] == '.') {
+        size_t start = ++i;
+        i = skip_digits(value, i, length);
+        if (i == start) return false;
+    }
+    if (i < length && (value[i] == 'e' || value[i] == 'E')) {
+        i++;
+        if (i < length && (value[i] == '+' || value[i] == '-')) i++;
+        size_t start = i;
+        i = skip_digits(value, i, length);
+        if (i == start) return false;
+    }
+    return i == length;
+}
+
+// Correlation ids are echoed verbatim, so only plain strings and numbers are accepted
+bool parse_correlation_id(const char *body, size_t length, char *out, size_t out_size) {
+    const char *value;
+    size_t value_length;
+    out[0] = '\0';
+    if (!json_get_raw(body, length, "id", &value, &value_length)) return true;
+    if (value_length == 0 || value_length >= out_size) return false;
+
+    if (value[0] == '"') {
+        for (size_t i = 1; i < value_length; i++) {
+            if (value[i] == '\\' || (unsigned char)value[i] < 0x20) return false;
+        }
+    } else if (!is_json_number(value, value_length)) {
+        return false;
+    }
+
+    memcpy(out, value, value_length);
+    out[value_length] = '\0';
+    return true;
+}
+
+static bool read_flag(const char *body, size_t length, const char *key, bool *out) {
+    const char *value;
+    size_t value_length;
+    *out = false;
+    if (!json_get_raw(body, length, key, &value, &value_length)) return true;
+    if (value_length == 4 && memcmp(value, "true", 4) == 0) {
+        *out = true;
+        return true;
+    }
+    return value_length == 5 && memcmp(value, "false", 5) == 0;
+}
+
+static bool fail(const char **error, const char *message) {
+    if (error) *error = message;
+    return false;
+}
+
+bool parse_chat_request(const char *body, size_t length, ChatRequest *request, const char **error) {
+    if (!body || !request) {
+        return fail(error, "missing body");
+    }
+
+    size_t start = 0;
+    while (start < length && (body[start] == ' ' || body[start] == '\t' || body[start] == '\r' || body[start] == '\n')) {
+        start++;
+    }
+    if (start == length || body[start] != '{') {
+        return fail(error, "body must be a JSON object");
+    }
+
+    if (!parse_correlation_id(body, length, request->correlation_id, sizeof(request->correlation_id))) {
+        return fail(error, "invalid id");
+    }
+    if (!read_field(body, length, "message", request->message, sizeof(request->message))) {
+        return fail(error, "invalid or too long message");
+    }
+    if (!read_field(body, length, "sessionId", request->session_id, sizeof(request->session_id))) {
+        return fail(error, "invalid sessionId");
+    }
+    if (!read_field(body, length, "userId", request->user_id, sizeof(request->user_id))) {
+        return fail(error, "invalid userId");
+    }
+    if (!read_field(body, length, "route", request->route, sizeof(request->route))) {
+        return fail(error, "invalid route");
+    }
+    if (!read_field(body, length, "role", request->role, sizeof(request->role)) ||
+        (request->role[0] && !is_valid_role(request->role))) {
+        return fail(error, "invalid role");
+    }
+    if (!read_field(body, length, "lang", request->language, sizeof(request->language)) ||
+        (!request->language[0] &&
+         !read_field(body, length, "language", request->language, sizeof(request->language))) ||
+        (request->language[0] && !is_valid_language(request->language))) {
+        return fail(error, "invalid lang");
+    }
+
+    if (!read_flag(body, length, "stream", &request->stream)) {
+        return fail(error, "invalid stream");
+    }
+    if (!read_flag(body, length, "timings", &request->timings)) {
+        return fail(error, "invalid timings");
+    }
+
+    if (request->message[0] == '\0') {
+        return fail(error, "missing message");
+    }
+    if (strlen(request->message) > get_max_message_length()) {
+        return fail(error, "message too long");
+    }
+
+    return true;
+}
+
+static bool replace_string(char **field, const char *value) {
+    if (*field && strcmp(*field, value) == 0) return true;
+
+    char *copy = engine_strdup(value);
+    if (!copy) return false;
+    engine_free(*field);
+    *field = copy;
+    return true;
+}
+
+static long elapsed_microseconds(const struct timespec *start, const struct timespec *end) {
+    long long elapsed_ns = (long long)(end->tv_sec - start->tv_sec) * 1000000000LL +
+                           (end->tv_nsec - start->tv_nsec);
+    if (elapsed_ns < 0) return 0;
+    return (long)(elapsed_ns / 1000);
+}
+
+const char *request_role(const ChatRequest *request) {
+    return request->role[0] ? request->role : "tenant";
+}
+
+const char *request_language(const ChatRequest *request) {
+    return request->language[0] ? request->language : "en";
+}
+
+const char *request_user_id(const ChatRequest *request) {
+    return request->user_id[0] ? request->user_id : "api_user";
+}
+
+// Only requests that name a session keep one in the table; the rest are
+// answered on a detached session that is freed with the reply, as --batch does
+static ChatSession *request_session(const ChatRequest *request, bool *created) {
+    if (!request->session_id[0]) {
+        *created = true;
+        return create_detached_session(request_user_id(request), request_role(request), request_language(request));
+    }
+    return get_or_create_session(request->session_id, request_user_id(request), request_role(request),
+                                 request_language(request), created);
+}
+
+static const char *session_error(const ChatRequest *request) {
+    return request->session_id[0] ? "Session limit reached" : "Out of memory";
+}
+
+static void release_session(const ChatRequest *request, ChatSession *session) {
+    if (!request->session_id[0]) free_session(session);
+}
+
+RequestStatus handle_chat_request(const ChatRequest *request, OutputBuffer *out) {
+    bool created = false;
+    ChatSession *session = request_session(request, &created);
+    if (!session) {
+        append_json_error(out, request->correlation_id, session_error(request));
+        return REQUEST_UNAVAILABLE;
+    }
+
+    RequestStatus status = run_chat_request(session, created, request, out);
+    release_session(request, session);
+    return status;
+}
+
+static bool apply_request_context(ChatSession *session, bool created, const ChatRequest *request) {
+    if ((request->role[0] && !replace_string(&session->role, request->role)) ||
+        (request->language[0] && !replace_string(&session->language, request->language))) {
+        return false;
+    }
+
+    const char *route = request->route[0] ? request->route : NULL;
+    if (!route && created) {
+        route = default_route_for_role(session->role);
+    }
+    return !route || replace_string(&session->context, route);
+}
+
+RequestStatus run_chat_request(ChatSession *session, bool created, const ChatRequest *request, OutputBuffer *out) {
+    if (!apply_request_context(session, created, request)) {
+        append_json_error(out, request->correlation_id, "Out of memory");
+        return REQUEST_UNAVAILABLE;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ChatResponse *response = process_message(session, request->message);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long elapsed_us = elapsed_microseconds(&start, &end);
+
+    JsonPayload payload;
+    payload.correlation_id = request->correlation_id;
+    payload.response_text = "Unable to process request";
+    payload.confidence = 0.0f;
+    payload.response_time_ms = (elapsed_us + 500) / 1000;
+    payload.response_time_us = elapsed_us;
+    payload.language = session->language;
+    payload.role = session->role;
+    // A throwaway session is freed with the reply, so its id is no use to the client
+    payload.session_id = request->session_id[0] ? session->id : NULL;
+    payload.response = response;
+    payload.timings = request->timings;
+
+    if (response) {
+        payload.response_text = response->response ? response->response : "";
+        payload.confidence = response->confidence;
+    }
+    append_json_payload(out, &payload);
+    free_response(response);
+    return REQUEST_OK;
+}
+
+static void begin_event(OutputBuffer *event, const ChatRequest *request, const char *type) {
+    buffer_reset(event);
+    buffer_append_str(event, "{");
+    if (request->correlation_id[0]) {
+        buffer_append_str(event, "\"id\":");
+        buffer_append_str(event, request->correlation_id);
+        buffer_append_str(event, ",");
+    }
+    buffer_append_str(event, "\"type\":");
+    json_append_string(event, type);
+}
+
+static void emit_event(StreamSink *sink, OutputBuffer *event, const char *type) {
+    buffer_append_str(event, "}");
+    sink->event(sink, type, event->data, event->length);
+}
+
+static void emit_stream_error(StreamSink *sink, const ChatRequest *request, const char *message) {
+    OutputBuffer event;
+    buffer_init(&event);
+    begin_event(&event, request, "error");
+    buffer_append_str(&event, ",\"error\":");
+    json_append_string(&event, message);
+    emit_event(sink, &event, "error");
+    sink->flush(sink);
+    buffer_free(&event);
+}
+
+// Stage times in microseconds, keyed as "normalizeUs" ... "renderUs"
+static void append_timings(OutputBuffer *out, const ChatResponse *response) {
+    static const char *names[STAGE_COUNT] = {"normalize", "resolve", "cache", "match", "render"};
+    buffer_append_str(out, ",\"timings\":{");
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        buffer_appendf(out, "%s\"%sUs\":%.1f", stage > 0 ? "," : "", names[stage],
+                       (double)response->stage_ns[stage] / 1000.0);
+    }
+    buffer_append_str(out, "}");
+}
+
+static void append_suggested_actions(OutputBuffer *out, const ChatResponse *response) {
+    buffer_append_str(out, "[");
+    for (int i = 0; i < response->action_count; i++) {
+        const SuggestedAction *action = response->suggested_actions[i];
+        if (i > 0) buffer_append_str(out, ",");
+        buffer_append_str(out, "{\"type\":");
+        json_append_string(out, action->type ? action->type : "");
+        buffer_append_str(out, ",\"label\":");
+        json_append_string(out, action->label ? action->label : "");
+        buffer_append_str(out, ",\"target\":");
+        json_append_string(out, action->target ? action->target : "");
+        buffer_append_str(out, "}");
+    }
+    buffer_append_str(out, "]");
+}
+
+RequestStatus handle_chat_stream(const ChatRequest *request, StreamSink *sink) {
+    bool created = false;
+    ChatSession *session = request_session(request, &created);
+    if (!session) {
+        emit_stream_error(sink, request, session_error(request));
+        return REQUEST_UNAVAILABLE;
+    }
+
+    RequestStatus status = run_chat_stream(session, created, request, sink);
+    release_session(request, session);
+    return status;
+}
+
+// The metadata event is flushed on its own so clients can render the
+// category and actions while the answer text is still being written.
+RequestStatus run_chat_stream(ChatSession *session, bool created, const ChatRequest *request, StreamSink *sink) {
+    struct timespec start, first_byte, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (!apply_request_context(session, created, request)) {
+        emit_stream_error(sink, request, "Out of memory");
+        return REQUEST_UNAVAILABLE;
+    }
+
+    ChatResponse *response = process_message(session, request->message);
+    if (!response) {
+        emit_stream_error(sink, request, "Unable to process request");
+        return REQUEST_OK;
+    }
+
+    OutputBuffer event;
+    buffer_init(&event);
+
+    begin_event(&event, request, "meta");
+    buffer_append_str(&event, ",\"messageId\":");
+    json_append_string(&event, response->message_id ? response->message_id : "");
+    buffer_append_str(&event, ",\"category\":");
+    json_append_string(&event, response->response_type ? response->response_type : "");
+    buffer_appendf(&event, ",\"confidence\":%.2f", response->confidence);
+    buffer_append_str(&event, ",\"suggestedActions\":");
+    append_suggested_actions(&event, response);
+    if (request->session_id[0]) {
+        buffer_append_str(&event, ",\"sessionId\":");
+        json_append_string(&event, session->id);
+    }
+    emit_event(sink, &event, "meta");
+    sink->flush(sink);
+    clock_gettime(CLOCK_MONOTONIC, &first_byte);
+
+    begin_event(&event, request, "text");
+    buffer_append_str(&event, ",\"text\":");
+    json_append_string(&event, response->response ? response->response : "");
+    emit_event(sink, &event, "text");
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long total_us = elapsed_microseconds(&start, &end);
+    begin_event(&event, request, "done");
+    buffer_appendf(&event, ",\"responseTime\":%ld", (total_us + 500) / 1000);
+    buffer_appendf(&event, ",\"ttfbUs\":%ld", elapsed_microseconds(&start, &first_byte));
+    buffer_appendf(&event, ",\"totalUs\":%ld", total_us);
+    if (request->timings) append_timings(&event, response);
+    buffer_append_str(&event, ",\"language\":");
+    json_append_string(&event, session->language);
+    buffer_append_str(&event, ",\"role\":");
+    json_append_string(&event, session->role);
+    emit_event(sink, &event, "done");
+    sink->flush(sink);
+
+    buffer_free(&event);
+    free_response(response);
+    return REQUEST_OK;
+}
+
+void append_json_payload(OutputBuffer *out, const JsonPayload *payload) {
+    const ChatResponse *response = payload->response;
+    buffer_append_str(out, "{");
+    if (payload->correlation_id && payload->correlation_id[0]) {
+        buffer_append_str(out, "\"id\":");
+        buffer_append_str(out, payload->correlation_id);
+        buffer_append_str(out, ",");
+    }
+    if (response && response->message_id) {
+        buffer_append_str(out, "\"messageId\":");
+        json_append_string(out, response->message_id);
+        buffer_append_str(out, ",");
+    }
+    buffer_append_str(out, "\"response\":");
+    json_append_string(out, payload->response_text ? payload->response_text : "");
+    if (response && response->response_type) {
+        buffer_append_str(out, ",\"category\":");
+        json_append_string(out, response->response_type);
+    }
+    buffer_appendf(out, ",\"confidence\":%.2f", payload->confidence);
+    if (response) {
+        buffer_append_str(out, ",\"suggestedActions\":");
+        append_suggested_actions(out, response);
+    }
+    buffer_appendf(out, ",\"responseTime\":%ld", payload->response_time_ms);
+    if (payload->response_time_us >= 0) {
+        buffer_appendf(out, ",\"responseTimeUs\":%ld", payload->response_time_us);
+    }
+    if (response && payload->timings) {
+        append_timings(out, response);
+    }
+    buffer_append_str(out, ",\"language\":");
+    json_append_string(out, payload->language ? payload->language : "");
+    buffer_append_str(out, ",\"role\":");
+    json_append_string(out, payload->role ? payload->role : "");
+    if (payload->session_id) {
+        buffer_append_str(out, ",\"sessionId\":");
+        json_append_string(out, payload->session_id);
+    }
+    buffer_append_str(out, "}\n");
+}
+
+void append_json_error(OutputBuffer *out, const char *correlation_id, const char *message) {
+    buffer_append_str(out, "{");
+    if (correlation_id && correlation_id[0]) {
+        buffer_append_str(out, "\"id\":");
+        buffer_append_str(out, correlation_id);
+        buffer_append_str(out, ",");
+    }
+    buffer_append_str(out, "\"error\":");
+    json_append_string(out, message ? message : "");
+    buffer_append_str(out, "}\n");
+}
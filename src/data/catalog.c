@@ -0,0 +1,759 @@
+#include "../../include/catalog.h"
+#include "../../include/nav_graph.h"
+#include "../../include/chat_engine.h"
+#include "../../include/bricllm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+#define CATALOG_READERS 1024
+#define CATALOG_MAX_BYTES (4 * 1024 * 1024)
+
+// A cache line each, so pinning on one thread never bounces another's line
+typedef struct {
+    _Alignas(64) _Atomic uint64_t epoch;    // global epoch when pinned; 0 while idle
+    atomic_bool used;
+} ReaderSlot;
+
+static ReaderSlot readers[CATALOG_READERS];
+static atomic_int reader_limit;             // slots below this have been claimed at some point
+static _Atomic uint64_t global_epoch = 1;
+static _Atomic(Catalog *) active;
+
+static _Thread_local ReaderSlot *thread_slot;
+static _Thread_local int pin_depth;
+static _Thread_local const Catalog *pinned;
+static pthread_key_t reader_key;
+static pthread_once_t reader_once = PTHREAD_ONCE_INIT;
+
+// Reloads, the retired list and the counters below are all under reload_lock
+static pthread_mutex_t reload_lock = PTHREAD_MUTEX_INITIALIZER;
+static Catalog *retired;
+static atomic_int retired_count;
+static unsigned long reloads;
+static unsigned long reload_failures;
+
+static Catalog builtin;
+static const char *catalog_path;
+
+typedef enum {
+    LIST_KEYWORDS,
+    LIST_EXCLUDE,
+    LIST_RESPONSES,
+    LIST_BUTTONS,
+    LIST_ACTIONS,
+    LIST_PATTERNS,
+    LIST_KINDS
+} ListKind;
+
+static const char *list_names[LIST_KINDS] = {"keywords", "exclude", "response", "buttons", "actions", "patterns"};
+
+typedef enum {
+    ENTRY_NONE,
+    ENTRY_RULE,
+    ENTRY_ROUTE
+} EntryKind;
+
+// Runs twice over the text: once to count and validate, once to fill the
+// arrays sized from the first pass. Lists point into the text itself.
+typedef struct {
+    bool fill;
+    int line;
+    char *error;
+    size_t error_size;
+    CatalogRule *rules;
+    int rule_count;
+    RouteGuide *routes;
+    int route_count;
+    int route_params;
+    const char **pool;
+    int pool_used;
+    EntryKind entry;
+    int entry_line;
+    int list_start[LIST_KINDS];
+    int list_count[LIST_KINDS];
+} CatalogParser;
+
+void set_catalog_path(const char *path) {
+    catalog_path = path;
+}
+
+const char *get_catalog_path(void) {
+    return catalog_path;
+}
+
+static void release_slot(void *value) {
+    ReaderSlot *slot = value;
+    atomic_store(&slot->epoch, 0);
+    atomic_store_explicit(&slot->used, false, memory_order_release);
+}
+
+static void init_readers_once(void) {
+    pthread_key_create(&reader_key, release_slot);
+}
+
+static ReaderSlot *claim_slot(void) {
+    pthread_once(&reader_once, init_readers_once);
+    for (;;) {
+        for (int i = 0; i < CATALOG_READERS; i++) {
+            bool expected = false;
+            if (!atomic_compare_exchange_strong(&readers[i].used, &expected, true)) continue;
+
+            int limit = atomic_load(&reader_limit);
+            while (limit < i + 1 && !atomic_compare_exchange_weak(&reader_limit, &limit, i + 1)) {
+            }
+            pthread_setspecific(reader_key, &readers[i]);
+            return &readers[i];
+        }
+        // More live threads than slots; one frees up when a thread exits
+        sched_yield();
+    }
+}
+
+const Catalog *catalog_acquire(void) {
+    if (pin_depth++ > 0) return pinned;
+    if (!thread_slot) thread_slot = claim_slot();
+
+    // The epoch is published before the pointer is read, so a reload that
+    // swaps after this point waits for the release
+    atomic_store(&thread_slot->epoch, atomic_load(&global_epoch));
+    pinned = atomic_load(&active);
+    return pinned;
+}
+
+void catalog_release(void) {
+    if (--pin_depth > 0) return;
+    pinned = NULL;
+    atomic_store_explicit(&thread_slot->epoch, 0, memory_order_release);
+}
+
+// True while some reader pinned at or before epoch, and so may hold a
+// catalog retired at that epoch
+static bool pinned_since(uint64_t epoch) {
+    int limit = atomic_load(&reader_limit);
+    for (int i = 0; i < limit; i++) {
+        uint64_t seen = atomic_load(&readers[i].epoch);
+        if (seen != 0 && seen <= epoch) return true;
+    }
+    return false;
+}
+
+// Caller holds reload_lock
+static void collect_locked(void) {
+    Catalog **link = &retired;
+    while (*link) {
+        Catalog *catalog = *link;
+        if (pinned_since(catalog->retired_epoch)) {
+            link = &catalog->next_retired;
+            continue;
+        }
+        *link = catalog->next_retired;
+        LOG_DEBUG("Freed catalog version %u", catalog->version);
+        free(catalog->storage);
+        atomic_fetch_sub(&retired_count, 1);
+    }
+}
+
+void catalog_collect(void) {
+    if (atomic_load_explicit(&retired_count, memory_order_relaxed) == 0) return;
+    if (pthread_mutex_trylock(&reload_lock) != 0) return;
+    collect_locked();
+    pthread_mutex_unlock(&reload_lock);
+}
+
+// Caller holds reload_lock. Readers that pin after the epoch advances see next.
+static void publish(Catalog *next) {
+    Catalog *old = atomic_exchange(&active, next);
+    uint64_t epoch = atomic_fetch_add(&global_epoch, 1);
+    if (old && old->storage) {
+        old->retired_epoch = epoch;
+        old->next_retired = retired;
+        retired = old;
+        atomic_fetch_add(&retired_count, 1);
+    }
+    collect_locked();
+}
+
+static bool parse_error(CatalogParser *parser, const char *format, ...) {
+    int written = snprintf(parser->error, parser->error_size, "line %d: ", parser->line);
+    if (written >= 0 && (size_t)written < parser->error_size) {
+        va_list args;
+        va_start(args, format);
+        vsnprintf(parser->error + written, parser->error_size - (size_t)written, format, args);
+        va_end(args);
+    }
+    return false;
+}
+
+static char *trim(char *text) {
+    while (*text == ' ' || *text == '\t') text++;
+    size_t length = strlen(text);
+    while (length > 0 && (text[length - 1] == ' ' || text[length - 1] == '\t' || text[length - 1] == '\r')) {
+        text[--length] = '\0';
+    }
+    return text;
+}
+
+static char *next_word(char **cursor) {
+    char *word = *cursor;
+    while (*word == ' ' || *word == '\t') word++;
+    if (*word == '\0') return NULL;
+
+    char *end = word;
+    while (*end && *end != ' ' && *end != '\t') end++;
+    if (*end) *end++ = '\0';
+    *cursor = end;
+    return word;
+}
+
+static void add_item(CatalogParser *parser, ListKind kind, const char *item) {
+    if (parser->fill) parser->pool[parser->pool_used] = item;
+    parser->pool_used++;
+    parser->list_count[kind]++;
+}
+
+// keywords, exclude and patterns take words, buttons and actions take
+// "a | b" items and each response line is one item. Lines for one list must be adjacent.
+static bool parse_list(CatalogParser *parser, ListKind kind, char *text) {
+    EntryKind owner = kind <= LIST_RESPONSES ? ENTRY_RULE : ENTRY_ROUTE;
+    if (parser->entry != owner) {
+        return parse_error(parser, "'%s' outside a %s", list_names[kind], owner == ENTRY_RULE ? "rule" : "route");
+    }
+    if (parser->list_count[kind] > 0 &&
+        parser->list_start[kind] + parser->list_count[kind] != parser->pool_used) {
+        return parse_error(parser, "'%s' lines must be adjacent", list_names[kind]);
+    }
+    if (parser->list_count[kind] == 0) {
+        parser->list_start[kind] = parser->pool_used;
+    }
+
+    if (kind == LIST_RESPONSES) {
+        if (*text == '\0') return parse_error(parser, "empty response");
+        add_item(parser, kind, text);
+        return true;
+    }
+
+    if (kind == LIST_KEYWORDS || kind == LIST_EXCLUDE || kind == LIST_PATTERNS) {
+        char *word;
+        while ((word = next_word(&text))) {
+            // Message words are lowercased before they are compared
+            if (kind != LIST_PATTERNS) {
+                for (char *ptr = word; *ptr; ptr++) *ptr = (char)tolower((unsigned char)*ptr);
+            }
+            add_item(parser, kind, word);
+        }
+        return true;
+    }
+
+    while (text) {
+        char *bar = strchr(text, '|');
+        if (bar) *bar = '\0';
+        char *item = trim(text);
+        if (*item == '\0') return parse_error(parser, "empty item in '%s'", list_names[kind]);
+        add_item(parser, kind, item);
+        text = bar ? bar + 1 : NULL;
+    }
+    return true;
+}
+
+static bool finish_entry(CatalogParser *parser) {
+    int *start = parser->list_start;
+    int *count = parser->list_count;
+
+    if (parser->entry == ENTRY_RULE) {
+        if (count[LIST_KEYWORDS] == 0 || count[LIST_RESPONSES] == 0) {
+            parser->line = parser->entry_line;
+            return parse_error(parser, "rule needs keywords and at least one response");
+        }
+        if (parser->fill) {
+            CatalogRule *rule = &parser->rules[parser->rule_count - 1];
+            rule->keywords = parser->pool + start[LIST_KEYWORDS];
+            rule->keyword_count = count[LIST_KEYWORDS];
+            rule->exclude = count[LIST_EXCLUDE] ? parser->pool + start[LIST_EXCLUDE] : NULL;
+            rule->exclude_count = count[LIST_EXCLUDE];
+            rule->responses = parser->pool + start[LIST_RESPONSES];
+            rule->response_count = count[LIST_RESPONSES];
+        }
+    } else if (parser->entry == ENTRY_ROUTE) {
+        if (count[LIST_BUTTONS] == 0) {
+            parser->line = parser->entry_line;
+            return parse_error(parser, "route needs buttons");
+        }
+        if (parser->fill) {
+            // RouteGuide predates the catalog and takes mutable strings
+            RouteGuide *guide = &parser->routes[parser->route_count - 1];
+            NavigationContext *navigation = &guide->navigation;
+            navigation->available_buttons = (char **)(parser->pool + start[LIST_BUTTONS]);
+            navigation->button_count = count[LIST_BUTTONS];
+            navigation->suggested_actions = count[LIST_ACTIONS] ? (char **)(parser->pool + start[LIST_ACTIONS]) : NULL;
+            navigation->action_count = count[LIST_ACTIONS];
+            guide->patterns = count[LIST_PATTERNS] ? (char **)(parser->pool + start[LIST_PATTERNS]) : NULL;
+            guide->pattern_count = count[LIST_PATTERNS];
+        }
+    }
+
+    parser->entry = ENTRY_NONE;
+    memset(parser->list_count, 0, sizeof(parser->list_count));
+    return true;
+}
+
+static bool parse_unit(CatalogParser *parser, const char *text, float *value) {
+    char *end;
+    errno = 0;
+    *value = strtof(text, &end);
+    if (errno != 0 || *end != '\0' || !(*value >= 0.0f && *value <= 1.0f)) {
+        return parse_error(parser, "'%s' is not a number between 0 and 1", text);
+    }
+    return true;
+}
+
+// rule <category> <score> <confidence> [role=<role>] [max-words=<n>]
+static bool start_rule(CatalogParser *parser, char *args) {
+    char *category = next_word(&args);
+    char *score_text = next_word(&args);
+    char *confidence_text = next_word(&args);
+    if (!confidence_text) {
+        return parse_error(parser, "expected 'rule <category> <score> <confidence>'");
+    }
+
+    float score, confidence;
+    if (!parse_unit(parser, score_text, &score) || !parse_unit(parser, confidence_text, &confidence)) {
+        return false;
+    }
+    if (score == 0.0f) return parse_error(parser, "score must be above 0");
+
+    const char *role = NULL;
+    long max_words = 0;
+    char *option;
+    while ((option = next_word(&args))) {
+        if (strncmp(option, "role=", 5) == 0) {
+            role = option + 5;
+            if (!is_valid_role(role)) return parse_error(parser, "unknown role '%s'", role);
+        } else if (strncmp(option, "max-words=", 10) == 0) {
+            char *end;
+            max_words = strtol(option + 10, &end, 10);
+            if (option[10] == '\0' || *end != '\0' || max_words < 1 || max_words > 1000) {
+                return parse_error(parser, "invalid max-words '%s'", option + 10);
+            }
+        } else {
+            return parse_error(parser, "unknown rule option '%s'", option);
+        }
+    }
+
+    if (parser->fill) {
+        CatalogRule *rule = &parser->rules[parser->rule_count];
+        memset(rule, 0, sizeof(*rule));
+        rule->category = category;
+        rule->role = role;
+        rule->score = score;
+        rule->confidence = confidence;
+        rule->max_words = (int)max_words;
+    }
+    parser->rule_count++;
+    parser->entry = ENTRY_RULE;
+    return true;
+}
+
+// route <path> <role>
+static bool start_route(CatalogParser *parser, char *args) {
+    char *path = next_word(&args);
+    char *role = next_word(&args);
+    if (!role || next_word(&args)) return parse_error(parser, "expected 'route <path> <role>'");
+    if (path[0] != '/') return parse_error(parser, "route '%s' must start with '/'", path);
+    if (!is_valid_role(role)) return parse_error(parser, "unknown role '%s'", role);
+
+    if (parser->fill) {
+        RouteGuide *guide = &parser->routes[parser->route_count];
+        memset(guide, 0, sizeof(*guide));
+        guide->navigation.route = path;
+        guide->navigation.user_role = role;
+        guide->hash = route_hash(path);
+    }
+    parser->route_count++;
+    parser->route_params += route_params(path);
+    parser->entry = ENTRY_ROUTE;
+    return true;
+}
+
+static bool parse_line(CatalogParser *parser, char *line) {
+    line = trim(line);
+    if (*line == '\0' || *line == '#') return true;
+
+    char *rest = line;
+    char *directive = next_word(&rest);
+    rest = trim(rest);
+
+    if (strcmp(directive, "rule") == 0 || strcmp(directive, "route") == 0) {
+        if (!finish_entry(parser)) return false;
+        parser->entry_line = parser->line;
+        return strcmp(directive, "rule") == 0 ? start_rule(parser, rest) : start_route(parser, rest);
+    }
+    for (int kind = 0; kind < LIST_KINDS; kind++) {
+        if (strcmp(directive, list_names[kind]) == 0) {
+            return parse_list(parser, (ListKind)kind, rest);
+        }
+    }
+    return parse_error(parser, "unknown directive '%s'", directive);
+}
+
+static bool parse_text(CatalogParser *parser, char *text) {
+    parser->line = 0;
+    parser->rule_count = 0;
+    parser->route_count = 0;
+    parser->pool_used = 0;
+    parser->entry = ENTRY_NONE;
+    memset(parser->list_count, 0, sizeof(parser->list_count));
+
+    while (text) {
+        char *newline = strchr(text, '\n');
+        if (newline) *newline = '\0';
+        parser->line++;
+        if (!parse_line(parser, text)) return false;
+        text = newline ? newline + 1 : NULL;
+    }
+    if (!finish_entry(parser)) return false;
+    if (parser->rule_count == 0) {
+        snprintf(parser->error, parser->error_size, "catalog has no rules");
+        return false;
+    }
+    return true;
+}
+
+static uint64_t hash_bytes(const char *data, size_t length) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void append_items(OutputBuffer *out, const char *directive, const char *const *items, int count,
+                         const char *separator) {
+    if (count == 0) return;
+    buffer_append_str(out, directive);
+    for (int i = 0; i < count; i++) {
+        buffer_append_str(out, i == 0 ? " " : separator);
+        buffer_append_str(out, items[i]);
+    }
+    buffer_append_str(out, "\n");
+}
+
+bool catalog_dump(const Catalog *catalog, OutputBuffer *out) {
+    for (int i = 0; i < catalog->rule_count; i++) {
+        const CatalogRule *rule = &catalog->rules[i];
+        buffer_appendf(out, "rule %s %g %g", rule->category, rule->score, rule->confidence);
+        if (rule->role) buffer_appendf(out, " role=%s", rule->role);
+        if (rule->max_words > 0) buffer_appendf(out, " max-words=%d", rule->max_words);
+        buffer_append_str(out, "\n");
+        append_items(out, "keywords", rule->keywords, rule->keyword_count, " ");
+        append_items(out, "exclude", rule->exclude, rule->exclude_count, " ");
+        for (int r = 0; r < rule->response_count; r++) {
+            buffer_appendf(out, "response %s\n", rule->responses[r]);
+        }
+        buffer_append_str(out, "\n");
+    }
+    for (int i = 0; i < catalog->route_count; i++) {
+        const RouteGuide *guide = &catalog->routes[i];
+        const NavigationContext *navigation = &guide->navigation;
+        buffer_appendf(out, "route %s %s\n", navigation->route, navigation->user_role);
+        append_items(out, "buttons", (const char *const *)navigation->available_buttons, navigation->button_count, " | ");
+        append_items(out, "actions", (const char *const *)navigation->suggested_actions, navigation->action_count, " | ");
+        append_items(out, "patterns", (const char *const *)guide->patterns, guide->pattern_count, " ");
+        if (!buffer_append_str(out, "\n")) return false;
+    }
+    return true;
+}
+
+static uint64_t monotonic_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000ULL + (uint64_t)now.tv_nsec / 1000ULL;
+}
+
+static int candidate_words(int rule_count) {
+    return (rule_count + 63) / 64;
+}
+
+// The candidate bitsets, then each route's outside score, then the rules by score
+static size_t candidate_table_size(int route_count, int rule_count) {
+    size_t bytes = (size_t)route_count * (size_t)candidate_words(rule_count) * sizeof(uint64_t) +
+                   (size_t)route_count * sizeof(float) + (size_t)rule_count * sizeof(int);
+    return (bytes + 7) & ~(size_t)7;
+}
+
+// A route's candidates are the rules for its role whose category it lists
+static void fill_candidates(Catalog *catalog, void *table) {
+    int words = candidate_words(catalog->rule_count);
+    uint64_t *bits = table;
+    float *outside = (float *)(bits + (size_t)catalog->route_count * (size_t)words);
+    int *by_score = (int *)(outside + catalog->route_count);
+    memset(bits, 0, (size_t)catalog->route_count * (size_t)words * sizeof(uint64_t));
+    for (int i = 0; i < catalog->route_count; i++) {
+        const RouteGuide *guide = &catalog->routes[i];
+        uint64_t *row = bits + (size_t)i * (size_t)words;
+        outside[i] = 0.0f;
+        for (int r = 0; r < catalog->rule_count; r++) {
+            const CatalogRule *rule = &catalog->rules[r];
+            if (rule->role && strcmp(rule->role, guide->navigation.user_role) != 0) continue;
+            bool listed = false;
+            for (int p = 0; p < guide->pattern_count && !listed; p++) {
+                listed = strcmp(guide->patterns[p], rule->category) == 0;
+            }
+            if (listed) {
+                row[r / 64] |= 1ULL << (r % 64);
+            } else if (rule->score > outside[i]) {
+                outside[i] = rule->score;
+            }
+        }
+    }
+
+    // Insertion sort keeps equal scores in rule order; catalogs are small
+    for (int r = 0; r < catalog->rule_count; r++) {
+        int k = r;
+        while (k > 0 && catalog->rules[by_score[k - 1]].score < catalog->rules[r].score) {
+            by_score[k] = by_score[k - 1];
+            k--;
+        }
+        by_score[k] = r;
+    }
+
+    catalog->route_candidates = bits;
+    catalog->candidate_words = words;
+    catalog->route_outside_scores = outside;
+    catalog->rules_by_score = by_score;
+}
+
+const uint64_t *catalog_route_candidates(const Catalog *catalog, const RouteGuide *guide) {
+    if (!catalog || !guide || guide->pattern_count == 0 || !catalog->route_candidates) return NULL;
+    return catalog->route_candidates + (size_t)(guide - catalog->routes) * (size_t)catalog->candidate_words;
+}
+
+float catalog_route_outside_score(const Catalog *catalog, const RouteGuide *guide) {
+    return catalog->route_outside_scores[guide - catalog->routes];
+}
+
+// The checksum covers the canonical dump, so comments and layout do not
+// change it and every process derives the same value from the same data
+static bool finish_catalog(Catalog *catalog, uint64_t started_us) {
+    OutputBuffer dump;
+    buffer_init(&dump);
+    bool ok = catalog_dump(catalog, &dump);
+    catalog->checksum = hash_bytes(dump.data, dump.length);
+    buffer_free(&dump);
+
+    catalog->loaded_at = time(NULL);
+    catalog->load_us = (long)(monotonic_us() - started_us);
+    catalog->next_retired = NULL;
+    return ok;
+}
+
+static char *read_catalog_file(const char *path, size_t *size, char *error, size_t error_size) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        snprintf(error, error_size, "cannot open %s: %s", path, strerror(errno));
+        return NULL;
+    }
+
+    char *text = malloc(CATALOG_MAX_BYTES + 1);
+    if (!text) {
+        fclose(file);
+        snprintf(error, error_size, "out of memory");
+        return NULL;
+    }
+    *size = fread(text, 1, CATALOG_MAX_BYTES + 1, file);
+    bool failed = ferror(file);
+    fclose(file);
+
+    if (failed || *size > CATALOG_MAX_BYTES) {
+        snprintf(error, error_size, failed ? "cannot read %s" : "%s is larger than 4MB", path);
+        free(text);
+        return NULL;
+    }
+    text[*size] = '\0';
+    if (strlen(text) != *size) {
+        snprintf(error, error_size, "%s contains NUL bytes", path);
+        free(text);
+        return NULL;
+    }
+    return text;
+}
+
+// Builds a catalog in one allocation: the Catalog, its rule and route
+// arrays, the route candidates, index and navigation graph, the list pointers
+// and a copy of the text they point into
+static Catalog *load_catalog_file(const char *path, char *error, size_t error_size) {
+    uint64_t started_us = monotonic_us();
+    size_t size;
+    char *text = read_catalog_file(path, &size, error, error_size);
+    if (!text) return NULL;
+
+    CatalogParser parser;
+    memset(&parser, 0, sizeof(parser));
+    parser.error = error;
+    parser.error_size = error_size;
+
+    char *scratch = malloc(size + 1);
+    if (!scratch) {
+        free(text);
+        snprintf(error, error_size, "out of memory");
+        return NULL;
+    }
+    memcpy(scratch, text, size + 1);
+    bool counted = parse_text(&parser, scratch);
+    free(scratch);
+    if (!counted) {
+        free(text);
+        return NULL;
+    }
+
+    size_t index_bytes = route_index_size(parser.route_count, parser.route_params);
+    size_t candidate_bytes = candidate_table_size(parser.route_count, parser.rule_count);
+    // Every list item counts towards the graph's, which only overestimates
+    size_t graph_bytes = navigation_graph_size(parser.route_count, parser.pool_used);
+    size_t bytes = sizeof(Catalog) +
+                   (size_t)parser.rule_count * sizeof(CatalogRule) +
+                   (size_t)parser.route_count * sizeof(RouteGuide) + candidate_bytes + index_bytes + graph_bytes +
+                   (size_t)parser.pool_used * sizeof(char *) + size + 1;
+    Catalog *catalog = malloc(bytes);
+    if (!catalog) {
+        free(text);
+        snprintf(error, error_size, "out of memory");
+        return NULL;
+    }
+    memset(catalog, 0, sizeof(*catalog));
+    CatalogRule *rules = (CatalogRule *)(catalog + 1);
+    RouteGuide *routes = (RouteGuide *)(rules + parser.rule_count);
+    uint64_t *candidates = (uint64_t *)(routes + parser.route_count);
+    void *index = (char *)candidates + candidate_bytes;
+    void *graph = (char *)index + index_bytes;
+    const char **pool = (const char **)((char *)graph + graph_bytes);
+    char *copy = (char *)(pool + parser.pool_used);
+    memcpy(copy, text, size + 1);
+    free(text);
+
+    parser.fill = true;
+    parser.rules = rules;
+    parser.routes = routes;
+    parser.pool = pool;
+    if (!parse_text(&parser, copy)) {
+        free(catalog);
+        return NULL;
+    }
+
+    catalog->rules = rules;
+    catalog->rule_count = parser.rule_count;
+    catalog->routes = routes;
+    catalog->route_count = parser.route_count;
+    catalog->route_index = build_route_index(index, routes, parser.route_count);
+    catalog->navigation = build_navigation_graph(graph, routes, parser.route_count);
+    fill_candidates(catalog, candidates);
+    catalog->storage = catalog;
+    if (!finish_catalog(catalog, started_us)) {
+        free(catalog);
+        snprintf(error, error_size, "out of memory");
+        return NULL;
+    }
+    return catalog;
+}
+
+bool catalog_init(void) {
+    if (atomic_load(&active)) return true;
+
+    Catalog *catalog = &builtin;
+    if (catalog_path) {
+        char error[256];
+        catalog = load_catalog_file(catalog_path, error, sizeof(error));
+        if (!catalog) {
+            LOG_ERROR("Cannot load catalog: %s", error);
+            return false;
+        }
+    } else {
+        uint64_t started_us = monotonic_us();
+        load_builtin_rules(&builtin.rules, &builtin.rule_count);
+        load_builtin_routes(&builtin.routes, &builtin.route_count, &builtin.route_index, &builtin.navigation);
+        // Rules are not generated, so this is the one table built at startup
+        void *candidates = calloc(1, candidate_table_size(builtin.route_count, builtin.rule_count));
+        if (!candidates) {
+            LOG_ERROR("Cannot build the built-in catalog: out of memory");
+            return false;
+        }
+        fill_candidates(&builtin, candidates);
+        if (!finish_catalog(&builtin, started_us)) {
+            LOG_ERROR("Cannot build the built-in catalog: out of memory");
+            return false;
+        }
+    }
+    catalog->version = 1;
+
+    pthread_mutex_lock(&reload_lock);
+    publish(catalog);
+    pthread_mutex_unlock(&reload_lock);
+
+    LOG_INFO("Catalog loaded from %s: %d rules, %d routes",
+             catalog_path ? catalog_path : "built-in tables", catalog->rule_count, catalog->route_count);
+    return true;
+}
+
+bool catalog_reload(char *error, size_t error_size) {
+    if (!catalog_path) {
+        snprintf(error, error_size, "no catalog file configured");
+        pthread_mutex_lock(&reload_lock);
+        reload_failures++;
+        pthread_mutex_unlock(&reload_lock);
+        return false;
+    }
+
+    // The replacement is built before the lock is taken; only publishing
+    // and the version number are serialized
+    Catalog *next = load_catalog_file(catalog_path, error, error_size);
+
+    pthread_mutex_lock(&reload_lock);
+    if (!next) {
+        reload_failures++;
+        pthread_mutex_unlock(&reload_lock);
+        LOG_ERROR("Catalog reload failed: %s", error);
+        return false;
+    }
+    next->version = atomic_load(&active)->version + 1;
+    publish(next);
+    reloads++;
+    pthread_mutex_unlock(&reload_lock);
+
+    LOG_INFO("Catalog version %u active: %d rules, %d routes, loaded in %ld us",
+             next->version, next->rule_count, next->route_count, next->load_us);
+    return true;
+}
+
+void catalog_status(CatalogStatus *status) {
+    pthread_mutex_lock(&reload_lock);
+    const Catalog *catalog = atomic_load(&active);
+    status->version = catalog ? catalog->version : 0;
+    status->checksum = catalog ? catalog->checksum : 0;
+    status->rule_count = catalog ? catalog->rule_count : 0;
+    status->route_count = catalog ? catalog->route_count : 0;
+    status->loaded_at = catalog ? catalog->loaded_at : 0;
+    status->load_us = catalog ? catalog->load_us : 0;
+    status->reloads = reloads;
+    status->reload_failures = reload_failures;
+    status->retired = atomic_load(&retired_count);
+    pthread_mutex_unlock(&reload_lock);
+}
+
+void append_catalog_json(OutputBuffer *out) {
+    CatalogStatus status;
+    catalog_status(&status);
+    buffer_appendf(out,
+                   "\"catalogVersion\":%u,\"catalogChecksum\":\"%016llx\",\"catalogRules\":%d,"
+                   "\"catalogRoutes\":%d,\"catalogLoadedAt\":%lld,\"catalogLoadUs\":%ld,"
+                   "\"catalogReloads\":%lu,\"catalogReloadFailures\":%lu,\"catalogRetired\":%d",
+                   status.version, (unsigned long long)status.checksum, status.rule_count,
+                   status.route_count, (long long)status.loaded_at, status.load_us,
+                   status.reloads, status.reload_failures, status.retired);
+}
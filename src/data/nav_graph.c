@@ -0,0 +1,188 @@
+#include "../../include/nav_graph.h"
+#include <ctype.h>
+#include <string.h>
+
+// Last path segment, ignoring a trailing slash, "?query" or "#fragment";
+// NULL for a ":param" segment, which no button can open
+static const char *last_segment(const char *route, int *length) {
+    int end = (int)strcspn(route, "?#");
+    while (end > 1 && route[end - 1] == '/') end--;
+    int start = end;
+    while (start > 0 && route[start - 1] != '/') start--;
+    if (route[start] == ':') return NULL;
+    *length = end - start;
+    return route + start;
+}
+
+static int route_depth(const char *route) {
+    int depth = 0;
+    for (const char *c = route; *c && *c != '?' && *c != '#'; c++) {
+        if (*c == '/' && c[1] && c[1] != '/' && c[1] != '?' && c[1] != '#') depth++;
+    }
+    return depth;
+}
+
+// Case-insensitive, with spaces in name standing for the dashes in a slug
+static bool same_name(const char *segment, const char *name, int length) {
+    for (int i = 0; i < length; i++) {
+        char c = name[i] == ' ' ? '-' : (char)tolower((unsigned char)name[i]);
+        if (tolower((unsigned char)segment[i]) != c) return false;
+    }
+    return true;
+}
+
+static bool is_name(const char *name, int length, const char *word) {
+    return (int)strlen(word) == length && same_name(word, name, length);
+}
+
+// The role's shallowest page, first in file order
+static int home_page(const RouteGuide *guides, int count, const char *role) {
+    int home = -1;
+    int home_depth = 0;
+    for (int i = 0; i < count; i++) {
+        if (strcmp(guides[i].navigation.user_role, role) != 0) continue;
+        int depth = route_depth(guides[i].navigation.route);
+        if (home < 0 || depth < home_depth) {
+            home = i;
+            home_depth = depth;
+        }
+    }
+    return home;
+}
+
+static int find_page(const RouteGuide *guides, int count, const char *role, const char *name, int length,
+                     bool plural) {
+    if (length == 0) return -1;
+    if (is_name(name, length, "home") || is_name(name, length, "dashboard")) return home_page(guides, count, role);
+
+    for (int i = 0; i < count; i++) {
+        if (strcmp(guides[i].navigation.user_role, role) != 0) continue;
+        int segment_length;
+        const char *segment = last_segment(guides[i].navigation.route, &segment_length);
+        if (!segment) continue;
+        if (segment_length == length && same_name(segment, name, length)) return i;
+        if (plural && segment_length == length + 1 && tolower((unsigned char)segment[length]) == 's' &&
+            same_name(segment, name, length)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// "Payment Methods" opens a payment-methods page if there is one, else a methods page
+static int label_target(const RouteGuide *guides, int count, const char *role, const char *label) {
+    int length = (int)strlen(label);
+    int page = find_page(guides, count, role, label, length, false);
+    const char *space = strrchr(label, ' ');
+    if (page < 0 && space) {
+        page = find_page(guides, count, role, space + 1, length - (int)(space + 1 - label), false);
+    }
+    return page;
+}
+
+static int item_count(const RouteGuide *guide) {
+    int items = guide->navigation.button_count + guide->navigation.action_count;
+    return items < INT16_MAX ? items : INT16_MAX;
+}
+
+static const char *item_label(const RouteGuide *guide, int item) {
+    const NavigationContext *page = &guide->navigation;
+    return item < page->button_count ? page->available_buttons[item] : page->suggested_actions[item - page->button_count];
+}
+
+static size_t graph_items(const RouteGuide *guides, int count) {
+    size_t items = 0;
+    for (int i = 0; i < count; i++) items += (size_t)item_count(&guides[i]);
+    return items;
+}
+
+// Rounded up so that pointers can follow the graph in one allocation
+size_t navigation_graph_size(int route_count, int item_count) {
+    if (route_count > NAV_GRAPH_MAX_ROUTES) return 0;
+    size_t bytes = sizeof(NavigationGraph) + (size_t)route_count * sizeof(int) + (size_t)item_count * sizeof(int) +
+                   (size_t)route_count * (size_t)route_count * sizeof(int16_t);
+    return (bytes + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+}
+
+// A breadth-first search from every page; the first hop to each page it
+// reaches is the item that started the branch
+const NavigationGraph *build_navigation_graph(void *memory, const RouteGuide *guides, int count) {
+    if (count > NAV_GRAPH_MAX_ROUTES) return NULL;
+
+    NavigationGraph *graph = memory;
+    int *item_offset = (int *)(graph + 1);
+    int *item_target = item_offset + count;
+    int16_t *next_hop = (int16_t *)(item_target + graph_items(guides, count));
+
+    int items = 0;
+    for (int i = 0; i < count; i++) {
+        item_offset[i] = items;
+        for (int item = 0; item < item_count(&guides[i]); item++) {
+            item_target[items++] = label_target(guides, count, guides[i].navigation.user_role,
+                                                item_label(&guides[i], item));
+        }
+    }
+
+    int queue[NAV_GRAPH_MAX_ROUTES];
+    for (int from = 0; from < count; from++) {
+        int16_t *row = next_hop + (size_t)from * (size_t)count;
+        for (int to = 0; to < count; to++) row[to] = -1;
+
+        int head = 0;
+        int tail = 0;
+        queue[tail++] = from;
+        while (head < tail) {
+            int node = queue[head++];
+            for (int item = 0; item < item_count(&guides[node]); item++) {
+                int target = item_target[item_offset[node] + item];
+                if (target < 0 || target == from || row[target] >= 0) continue;
+                row[target] = node == from ? (int16_t)item : row[node];
+                queue[tail++] = target;
+            }
+        }
+    }
+
+    graph->route_count = count;
+    graph->item_offset = item_offset;
+    graph->item_target = item_target;
+    graph->next_hop = next_hop;
+    return graph;
+}
+
+int find_navigation_page(const RouteGuide *guides, int count, const char *word, int length, const char *role) {
+    if (!guides || !word || !role) return -1;
+    return find_page(guides, count, role, word, length, true);
+}
+
+int find_navigation_path(const NavigationGraph *graph, const RouteGuide *guides, int from, int to,
+                         NavigationStep *steps, int max) {
+    if (!graph || from < 0 || to < 0 || from >= graph->route_count || to >= graph->route_count) return -1;
+
+    int taken = 0;
+    for (int node = from; node != to;) {
+        int item = graph->next_hop[(size_t)node * (size_t)graph->route_count + (size_t)to];
+        if (item < 0 || taken == max) return -1;
+        int next = graph->item_target[graph->item_offset[node] + item];
+        steps[taken].label = item_label(&guides[node], item);
+        steps[taken].page = &guides[next];
+        taken++;
+        node = next;
+    }
+    return taken;
+}
+
+int find_navigation_exits(const NavigationGraph *graph, const RouteGuide *guides, int from,
+                          NavigationStep *steps, int max) {
+    if (!graph || from < 0 || from >= graph->route_count) return 0;
+
+    int found = 0;
+    int buttons = guides[from].navigation.button_count;
+    for (int item = 0; item < buttons && item < item_count(&guides[from]) && found < max; item++) {
+        int target = graph->item_target[graph->item_offset[from] + item];
+        if (target < 0 || target == from) continue;
+        steps[found].label = item_label(&guides[from], item);
+        steps[found].page = &guides[target];
+        found++;
+    }
+    return found;
+}
@@ -0,0 +1,211 @@
+#include "../../include/route_index.h"
+#include "../../include/bricllm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Labels point into the guides' route strings, so an index lives exactly as
+// long as the guides it was built from
+
+// Writable view of an index while it is being built
+typedef struct {
+    RouteIndex *index;
+    RouteNode *nodes;
+    int *next_guide;
+} RouteBuilder;
+
+static int add_node(RouteBuilder *builder, const char *label, int length, bool param) {
+    RouteNode *node = &builder->nodes[builder->index->node_count];
+    node->label = label;
+    node->label_length = length;
+    node->param = param;
+    node->first_child = -1;
+    node->next_sibling = -1;
+    node->param_child = -1;
+    node->first_guide = -1;
+    return builder->index->node_count++;
+}
+
+// Route length without the trailing slash, "?query" or "#fragment"
+static int path_length(const char *path) {
+    int length = (int)strcspn(path, "?#");
+    while (length > 1 && path[length - 1] == '/') length--;
+    return length;
+}
+
+// Walks node down the static characters in text, splitting edges as needed
+static int insert_static(RouteBuilder *builder, int node, const char *text, int length) {
+    while (length > 0) {
+        int child = builder->nodes[node].first_child;
+        while (child >= 0 && builder->nodes[child].label[0] != text[0]) {
+            child = builder->nodes[child].next_sibling;
+        }
+        if (child < 0) {
+            child = add_node(builder, text, length, false);
+            builder->nodes[child].next_sibling = builder->nodes[node].first_child;
+            builder->nodes[node].first_child = child;
+            return child;
+        }
+
+        RouteNode *edge = &builder->nodes[child];
+        int common = 1;
+        while (common < edge->label_length && common < length && edge->label[common] == text[common]) {
+            common++;
+        }
+        if (common < edge->label_length) {
+            // The tail keeps everything below the edge; the head becomes its parent
+            int tail = add_node(builder, edge->label + common, edge->label_length - common, false);
+            edge = &builder->nodes[child];
+            builder->nodes[tail].first_child = edge->first_child;
+            builder->nodes[tail].param_child = edge->param_child;
+            builder->nodes[tail].first_guide = edge->first_guide;
+            edge->label_length = common;
+            edge->first_child = tail;
+            edge->param_child = -1;
+            edge->first_guide = -1;
+        }
+        node = child;
+        text += common;
+        length -= common;
+    }
+    return node;
+}
+
+static void insert_route(RouteBuilder *builder, int guide) {
+    const char *path = builder->index->guides[guide].navigation.route;
+    int length = path_length(path);
+    int node = 0;
+    int start = 0;
+    for (int i = 0; i <= length; i++) {
+        bool param = i < length && path[i] == ':' && i > 0 && path[i - 1] == '/';
+        if (!param && i < length) continue;
+
+        node = insert_static(builder, node, path + start, i - start);
+        if (!param) break;
+
+        int end = i;
+        while (end < length && path[end] != '/') end++;
+        if (builder->nodes[node].param_child < 0) {
+            builder->nodes[node].param_child = add_node(builder, path + i, end - i, true);
+        }
+        node = builder->nodes[node].param_child;
+        start = end;
+        i = end - 1;
+    }
+
+    // Appended, so the first route listed for a role keeps winning
+    int *link = &builder->nodes[node].first_guide;
+    while (*link >= 0) link = &builder->next_guide[*link];
+    *link = guide;
+}
+
+// Counts every ':', which can only overestimate the params
+int route_params(const char *route) {
+    int params = 0;
+    for (const char *c = route; *c; c++) {
+        if (*c == ':') params++;
+    }
+    return params;
+}
+
+// Each route adds at most two nodes per static run and one per param
+static size_t max_nodes(int route_count, int params) {
+    return 1 + 2 * (size_t)route_count + 3 * (size_t)params;
+}
+
+// Rounded up so that pointers can follow the index in one allocation
+size_t route_index_size(int route_count, int params) {
+    size_t bytes = sizeof(RouteIndex) + max_nodes(route_count, params) * sizeof(RouteNode) +
+                   (size_t)route_count * sizeof(int);
+    return (bytes + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+}
+
+const RouteIndex *build_route_index(void *memory, const RouteGuide *guides, int count) {
+    RouteBuilder builder;
+    builder.index = memory;
+    builder.nodes = (RouteNode *)(builder.index + 1);
+    int params = 0;
+    for (int i = 0; i < count; i++) params += route_params(guides[i].navigation.route);
+    builder.next_guide = (int *)(builder.nodes + max_nodes(count, params));
+
+    builder.index->guides = guides;
+    builder.index->nodes = builder.nodes;
+    builder.index->next_guide = builder.next_guide;
+    builder.index->node_count = 0;
+
+    add_node(&builder, "", 0, false);
+    for (int i = 0; i < count; i++) {
+        builder.next_guide[i] = -1;
+        insert_route(&builder, i);
+    }
+    return builder.index;
+}
+
+static const RouteGuide *guide_for_role(const RouteIndex *index, const RouteNode *node, const char *role) {
+    for (int guide = node->first_guide; guide >= 0; guide = index->next_guide[guide]) {
+        if (strcmp(index->guides[guide].navigation.user_role, role) == 0) return &index->guides[guide];
+    }
+    return NULL;
+}
+
+// Returns the guide for the whole path, or NULL after recording in best the
+// deepest guide that covers a leading run of its segments
+static const RouteGuide *match_node(const RouteIndex *index, int node_index, const char *path, int position,
+                                    int length, const char *role, const RouteGuide **best, int *best_position) {
+    const RouteNode *node = &index->nodes[node_index];
+    if (node->param) {
+        int end = position;
+        while (end < length && path[end] != '/') end++;
+        if (end == position) return NULL;
+        position = end;
+    } else {
+        if (node->label_length > length - position ||
+            memcmp(path + position, node->label, (size_t)node->label_length) != 0) {
+            return NULL;
+        }
+        position += node->label_length;
+    }
+
+    if (position == length) return guide_for_role(index, node, role);
+    if (node->first_guide >= 0 && position > *best_position &&
+        (path[position] == '/' || path[position - 1] == '/')) {
+        const RouteGuide *guide = guide_for_role(index, node, role);
+        if (guide) {
+            *best = guide;
+            *best_position = position;
+        }
+    }
+
+    for (int child = node->first_child; child >= 0; child = index->nodes[child].next_sibling) {
+        if (index->nodes[child].label[0] != path[position]) continue;
+        const RouteGuide *guide = match_node(index, child, path, position, length, role, best, best_position);
+        if (guide) return guide;
+        break;
+    }
+    if (node->param_child >= 0 && path[position - 1] == '/') {
+        return match_node(index, node->param_child, path, position, length, role, best, best_position);
+    }
+    return NULL;
+}
+
+const RouteGuide *match_route_index(const RouteIndex *index, const char *path, const char *role) {
+    if (!index || !path || !role || path[0] != '/') return NULL;
+
+    const RouteGuide *best = NULL;
+    int best_position = 0;
+    const RouteGuide *guide = match_node(index, 0, path, 0, path_length(path), role, &best, &best_position);
+    return guide ? guide : best;
+}
+
+int route_index_nodes(const RouteIndex *index) {
+    return index ? index->node_count : 0;
+}
+
+uint32_t route_hash(const char *route) {
+    uint32_t hash = 2166136261u;
+    int length = path_length(route);
+    for (int i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)route[i]) * 16777619u;
+    }
+    return hash;
+}
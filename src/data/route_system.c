@@ -1,124 +1,72 @@
 #include "../../include/route_types.h"
+#include "../../include/catalog.h"
 #include "../../include/bricllm.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-extern void load_tenant_routes(void);
-extern RouteGuide *find_tenant_route(const char *route);
-extern RouteGuide *tenant_route_guides;
-extern int tenant_route_count;
-
 void init_route_system(void) {
-    log_message("INFO", "Initializing route system");
-
-    load_tenant_routes();
+    LOG_INFO("Initializing route system");
 
-    log_message("INFO", "Route system initialized");
+    const Catalog *catalog = catalog_acquire();
+    LOG_INFO("Route system initialized with %d routes (%d index nodes)",
+             catalog->route_count, route_index_nodes(catalog->route_index));
+    catalog_release();
 }
 
-RouteGuide *find_route_guide(const char *route, const char *user_role) {
+const RouteGuide *find_route_guide(const char *route, const char *user_role) {
     if (!route || !user_role) {
         return NULL;
     }
 
-    if (strcmp(user_role, "tenant") == 0) {
-        return find_tenant_route(route);
-    }
+    const Catalog *catalog = catalog_acquire();
+    const RouteGuide *guide = match_route_index(catalog->route_index, route, user_role);
+    catalog_release();
+    return guide;
+}
 
-    return find_tenant_route(route);
+const char *default_route_for_role(const char *role) {
+    if (!role) return "/";
+    if (strcmp(role, "caretaker") == 0) return "/caretaker";
+    if (strcmp(role, "manager") == 0) return "/manager";
+    if (strcmp(role, "admin") == 0) return "/admin";
+    return "/tenant";
 }
 
-NavigationContext *get_navigation_context(const char *route, const char *user_role) {
+// Only used when the catalog has no page for the role's home route either
+#define NAV_LIST(list) list, (int)(sizeof(list) / sizeof(list[0]))
+
+static char *tenant_buttons[] = {"Home", "Payments", "Requests", "Profile"};
+static char *tenant_actions[] = {"View Dashboard", "Check Notifications", "Help"};
+static char *caretaker_buttons[] = {"Tasks", "Schedule", "History", "Profile"};
+static char *caretaker_actions[] = {"View Tasks", "Check Schedule", "Help"};
+static char *manager_buttons[] = {"Dashboard", "Properties", "Leases", "Payments"};
+static char *manager_actions[] = {"Manage Properties", "View Reports", "Help"};
+static char *admin_buttons[] = {"Dashboard", "Users", "Security", "Reports"};
+static char *admin_actions[] = {"User Management", "System Settings", "Help"};
+
+static const NavigationContext role_defaults[] = {
+    {"/tenant", "tenant", NAV_LIST(tenant_buttons), NAV_LIST(tenant_actions)},
+    {"/caretaker", "caretaker", NAV_LIST(caretaker_buttons), NAV_LIST(caretaker_actions)},
+    {"/manager", "manager", NAV_LIST(manager_buttons), NAV_LIST(manager_actions)},
+    {"/admin", "admin", NAV_LIST(admin_buttons), NAV_LIST(admin_actions)}
+};
+
+const NavigationContext *get_navigation_context(const char *route, const char *user_role) {
     if (!route || !user_role) {
         return NULL;
     }
 
-    NavigationContext *ctx = malloc(sizeof(NavigationContext));
-    if (!ctx) return NULL;
-
-    ctx->current_route = strdup(route);
-    if (!ctx->current_route) {
-        free(ctx);
-        return NULL;
+    const RouteGuide *guide = find_route_guide(route, user_role);
+    if (!guide) {
+        guide = find_route_guide(default_route_for_role(user_role), user_role);
     }
-
-    ctx->user_role = strdup(user_role);
-    if (!ctx->user_role) {
-        free(ctx->current_route);
-        free(ctx);
-        return NULL;
-    }
-
-    ctx->available_buttons = NULL;
-    ctx->button_count = 0;
-    ctx->suggested_actions = NULL;
-    ctx->action_count = 0;
-
-    RouteGuide *guide = find_route_guide(route, user_role);
     if (guide) {
-        ctx->available_buttons = guide->navigation_buttons;
-        ctx->button_count = 4;
-        ctx->suggested_actions = guide->page_actions;
-        ctx->action_count = 3;
-    } else {
-        if (strcmp(user_role, "tenant") == 0) {
-            static char *default_buttons[] = {"Home", "Payments", "Requests", "Profile"};
-            ctx->available_buttons = default_buttons;
-            ctx->button_count = 4;
-
-            static char *default_actions[] = {"View Dashboard", "Check Notifications", "Help"};
-            ctx->suggested_actions = default_actions;
-            ctx->action_count = 3;
-        } else if (strcmp(user_role, "caretaker") == 0) {
-            static char *default_buttons[] = {"Tasks", "Schedule", "History", "Profile"};
-            ctx->available_buttons = default_buttons;
-            ctx->button_count = 4;
-
-            static char *default_actions[] = {"View Tasks", "Check Schedule", "Help"};
-            ctx->suggested_actions = default_actions;
-            ctx->action_count = 3;
-        } else if (strcmp(user_role, "manager") == 0) {
-            static char *default_buttons[] = {"Dashboard", "Properties", "Leases", "Payments"};
-            ctx->available_buttons = default_buttons;
-            ctx->button_count = 4;
-
-            static char *default_actions[] = {"Manage Properties", "View Reports", "Help"};
-            ctx->suggested_actions = default_actions;
-            ctx->action_count = 3;
-        } else if (strcmp(user_role, "admin") == 0) {
-            static char *default_buttons[] = {"Dashboard", "Users", "Security", "Reports"};
-            ctx->available_buttons = default_buttons;
-            ctx->button_count = 3;
-
-            static char *default_actions[] = {"User Management", "System Settings", "Help"};
-            ctx->suggested_actions = default_actions;
-            ctx->action_count = 3;
-        }
+        return &guide->navigation;
     }
 
-    log_message("INFO", "Created navigation context for %s on route %s",
-                user_role, route);
-
-    return ctx;
-}
-
-void free_navigation_context(NavigationContext *ctx) {
-    if (!ctx) return;
-
-    free(ctx->current_route);
-    free(ctx->user_role);
-    free(ctx);
-}
-
-void load_caretaker_routes(void) {
-    log_message("INFO", "Caretaker routes not yet implemented");
-}
-
-void load_manager_routes(void) {
-    log_message("INFO", "Manager routes not yet implemented");
-}
-
-void load_admin_routes(void) {
-    log_message("INFO", "Admin routes not yet implemented");
+    for (size_t i = 0; i < sizeof(role_defaults) / sizeof(role_defaults[0]); i++) {
+        if (strcmp(role_defaults[i].user_role, user_role) == 0) return &role_defaults[i];
+    }
+    return NULL;
 }
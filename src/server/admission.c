@@ -0,0 +1,145 @@
+#include "../../include/admission.h"
+#include "../../include/catalog.h"
+#include "../../include/pattern_cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BUCKET_PROBE 8
+
+static uint64_t monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static uint64_t hash_user(const char *user_id) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (const unsigned char *ptr = (const unsigned char *)user_id; *ptr; ptr++) {
+        hash ^= *ptr;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool admission_init(Admission *admission, const AdmissionConfig *config) {
+    memset(admission, 0, sizeof(*admission));
+    admission->config = *config;
+    if (admission->config.user_rate > 0 && admission->config.user_burst <= 0) {
+        double burst = admission->config.user_rate * 2;
+        admission->config.user_burst = burst < 1 ? 1 : burst;
+    }
+    if (admission->config.user_rate > 0) {
+        admission->buckets = calloc(ADMISSION_BUCKET_SLOTS, sizeof(TokenBucket));
+        if (!admission->buckets) return false;
+    }
+    return true;
+}
+
+void admission_destroy(Admission *admission) {
+    free(admission->buckets);
+    admission->buckets = NULL;
+}
+
+// A full table recycles the least recently refilled bucket in the probe
+// window; an evicted user simply starts again with a full bucket.
+static TokenBucket *find_bucket(Admission *admission, const char *user_id, uint64_t now) {
+    uint64_t hash = hash_user(user_id);
+    TokenBucket *oldest = NULL;
+
+    for (int i = 0; i < BUCKET_PROBE; i++) {
+        TokenBucket *bucket = &admission->buckets[(hash + (uint64_t)i) % ADMISSION_BUCKET_SLOTS];
+        if (bucket->user_id[0] == '\0' || strcmp(bucket->user_id, user_id) == 0) {
+            if (bucket->user_id[0] == '\0') {
+                snprintf(bucket->user_id, sizeof(bucket->user_id), "%s", user_id);
+                bucket->tokens = admission->config.user_burst;
+                bucket->refilled_ns = now;
+            }
+            return bucket;
+        }
+        if (!oldest || bucket->refilled_ns < oldest->refilled_ns) {
+            oldest = bucket;
+        }
+    }
+
+    snprintf(oldest->user_id, sizeof(oldest->user_id), "%s", user_id);
+    oldest->tokens = admission->config.user_burst;
+    oldest->refilled_ns = now;
+    return oldest;
+}
+
+static bool take_token(Admission *admission, const char *user_id) {
+    uint64_t now = monotonic_ns();
+    TokenBucket *bucket = find_bucket(admission, user_id, now);
+
+    double elapsed = (double)(now - bucket->refilled_ns) / 1e9;
+    bucket->tokens += elapsed * admission->config.user_rate;
+    if (bucket->tokens > admission->config.user_burst) {
+        bucket->tokens = admission->config.user_burst;
+    }
+    bucket->refilled_ns = now;
+
+    if (bucket->tokens < 1.0) return false;
+    bucket->tokens -= 1.0;
+    return true;
+}
+
+RequestStatus admission_check(Admission *admission, const ChatRequest *request, bool queued) {
+    ServerMetrics *metrics = &admission->metrics;
+    metrics->requests++;
+
+    // Shedding first keeps an overloaded server from spending tokens it cannot honour
+    if (queued && admission->config.max_queue > 0 && metrics->queued >= admission->config.max_queue) {
+        metrics->shed++;
+        return REQUEST_BUSY;
+    }
+    // Requests without a userId share the bucket of the user the engine answers them as
+    if (admission->buckets && !take_token(admission, request_user_id(request))) {
+        metrics->throttled++;
+        return REQUEST_THROTTLED;
+    }
+
+    if (queued) {
+        metrics->queued++;
+        if (metrics->queued > metrics->queued_peak) {
+            metrics->queued_peak = metrics->queued;
+        }
+    }
+    return REQUEST_OK;
+}
+
+void admission_finish(Admission *admission, bool queued, const AllocationCount *used) {
+    admission->metrics.completed++;
+    admission->metrics.allocations += used->allocations;
+    admission->metrics.allocated_bytes += used->bytes;
+    if (queued) {
+        admission->metrics.queued--;
+    }
+}
+
+void append_metrics_json(OutputBuffer *out, const char *correlation_id, const ServerMetrics *metrics) {
+    buffer_append_str(out, "{");
+    if (correlation_id && correlation_id[0]) {
+        buffer_append_str(out, "\"id\":");
+        buffer_append_str(out, correlation_id);
+        buffer_append_str(out, ",");
+    }
+    buffer_appendf(out,
+                   "\"requests\":%lu,\"completed\":%lu,\"shed\":%lu,\"throttled\":%lu,"
+                   "\"queued\":%d,\"queuedPeak\":%d,\"connections\":%d,",
+                   metrics->requests, metrics->completed, metrics->shed, metrics->throttled,
+                   metrics->queued, metrics->queued_peak, metrics->connections);
+    double completed = metrics->completed > 0 ? (double)metrics->completed : 1.0;
+    buffer_appendf(out, "\"allocations\":%llu,\"allocatedBytes\":%llu,\"allocationsPerRequest\":%.1f,"
+                   "\"allocatedBytesPerRequest\":%.0f,",
+                   (unsigned long long)metrics->allocations, (unsigned long long)metrics->allocated_bytes,
+                   (double)metrics->allocations / completed, (double)metrics->allocated_bytes / completed);
+    uint64_t hits;
+    uint64_t misses;
+    cache_counters(&hits, &misses);
+    buffer_appendf(out, "\"cacheHits\":%llu,\"cacheMisses\":%llu,", (unsigned long long)hits,
+                   (unsigned long long)misses);
+    append_catalog_json(out);
+    buffer_append_str(out, "}\n");
+}
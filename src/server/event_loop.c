@@ -0,0 +1,865 @@
+#include "../../include/io_backend.h"
+#include "../../include/bricllm.h"
+#include "../../include/chat_engine.h"
+#include "../../include/catalog.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define MAX_EVENTS 64
+#define READ_CHUNK 16384
+// Largest buffered input that travels with a handed-off connection
+#define HANDOFF_MAX_BYTES 131072
+// Both above the largest single request, so one partial request never stalls
+#define BACKPRESSURE_HIGH_WATER (1024 * 1024)
+#define BACKPRESSURE_LOW_WATER (256 * 1024)
+
+// Streamed output flushed by a worker before its job completes
+struct ServerChunk {
+    EventConnection *conn;
+    OutputBuffer data;
+    struct ServerChunk *next;
+};
+
+int create_tcp_listener(const char *host, int port, bool reuse_port) {
+    char port_text[16];
+    snprintf(port_text, sizeof(port_text), "%d", port);
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    struct addrinfo *result;
+    int rc = getaddrinfo(host, port_text, &hints, &result);
+    if (rc != 0) {
+        LOG_ERROR("Cannot resolve %s: %s", host ? host : "*", gai_strerror(rc));
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *addr = result; addr; addr = addr->ai_next) {
+        fd = socket(addr->ai_family, addr->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, addr->ai_protocol);
+        if (fd < 0) continue;
+
+        int enable = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        if (reuse_port && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) < 0) {
+            close(fd);
+            fd = -1;
+            continue;
+        }
+
+        if (bind(fd, addr->ai_addr, addr->ai_addrlen) == 0 && listen(fd, SOMAXCONN) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(result);
+
+    if (fd < 0) {
+        LOG_ERROR("Cannot listen on %s:%d: %s", host ? host : "*", port, strerror(errno));
+    }
+    return fd;
+}
+
+int create_unix_listener(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (!path || strlen(path) >= sizeof(addr.sun_path)) {
+        LOG_ERROR("Invalid socket path");
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    // Replace a stale socket left by a previous run, but never a regular file
+    struct stat info;
+    if (lstat(path, &info) == 0 && S_ISSOCK(info.st_mode)) {
+        unlink(path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        LOG_ERROR("Cannot create socket: %s", strerror(errno));
+        return -1;
+    }
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        LOG_ERROR("Cannot listen on %s: %s", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void retire_connection(EventLoop *loop, EventConnection *conn) {
+    conn->next_closed = loop->closed;
+    loop->closed = conn;
+}
+
+void event_loop_free_closed(EventLoop *loop) {
+    while (loop->closed) {
+        EventConnection *conn = loop->closed;
+        loop->closed = conn->next_closed;
+        close(conn->fd);
+        buffer_free(&conn->in);
+        buffer_free(&conn->out);
+        buffer_free(&conn->sending);
+        free(conn);
+        loop->admission.metrics.connections--;
+    }
+}
+
+void event_loop_release_connection(EventLoop *loop, EventConnection *conn) {
+    if (conn->closed && !conn->retired && conn->inflight == 0 && conn->io_pending == 0) {
+        conn->retired = true;
+        retire_connection(loop, conn);
+    }
+}
+
+EventConnection *event_loop_add_connection(EventLoop *loop, int fd) {
+    EventConnection *conn = malloc(sizeof(EventConnection));
+    if (!conn) return NULL;
+
+    conn->fd = fd;
+    buffer_init(&conn->in);
+    buffer_init(&conn->out);
+    buffer_init(&conn->sending);
+    conn->interest = 0;
+    conn->close_after_write = false;
+    conn->inflight = 0;
+    conn->io_pending = 0;
+    conn->closed = false;
+    conn->retired = false;
+    conn->handoff_to = -1;
+    conn->pinned = false;
+    conn->read_paused = false;
+    conn->receiving = false;
+    conn->recv_cancelling = false;
+    conn->loop = loop;
+    conn->next_closed = NULL;
+    conn->next_handoff = NULL;
+    loop->admission.metrics.connections++;
+    return conn;
+}
+
+bool event_loop_backpressured(EventConnection *conn) {
+    size_t pending = conn->in.length + conn->out.length + conn->sending.length;
+    conn->read_paused = pending > (conn->read_paused ? BACKPRESSURE_LOW_WATER : BACKPRESSURE_HIGH_WATER);
+    return conn->read_paused;
+}
+
+// Every complete request in the read batch is handled before the single flush
+void event_loop_process_input(EventLoop *loop, EventConnection *conn) {
+    size_t offset = 0;
+    while (offset < conn->in.length && !conn->close_after_write && conn->handoff_to < 0) {
+        if (loop->protocol->ordered && conn->inflight > 0) break;
+
+        long consumed = loop->protocol->process(conn, conn->in.data + offset, conn->in.length - offset);
+        if (consumed < 0) {
+            conn->close_after_write = true;
+            break;
+        }
+        if (consumed == 0) break;
+        offset += (size_t)consumed;
+    }
+    buffer_consume(&conn->in, offset);
+
+    // What is left of the input goes with the socket
+    if (conn->handoff_to >= 0) {
+        loop->ops->detach(loop, conn);
+    }
+}
+
+bool event_loop_route_session(EventConnection *conn, const char *session_id) {
+    const WorkerShard *shard = conn->loop->shard;
+    if (!shard || shard->count < 2 || !session_id[0] || conn->pinned) return false;
+
+    int owner = session_shard(session_id, shard->count);
+    if (owner == shard->index) return false;
+    // Replies still owed on this socket must come from this process
+    if (conn->inflight > 0 || conn->out.length > 0 || conn->sending.length > 0 ||
+        conn->in.length > HANDOFF_MAX_BYTES) {
+        return false;
+    }
+    conn->handoff_to = owner;
+    return true;
+}
+
+void event_loop_detached(EventLoop *loop, EventConnection *conn) {
+    conn->next_handoff = loop->handoffs;
+    loop->handoffs = conn;
+}
+
+static bool send_connection(EventLoop *loop, EventConnection *conn) {
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct iovec iov = {conn->in.data, conn->in.length};
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(header), &conn->fd, sizeof(int));
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(loop->shard->peer_fds[conn->handoff_to], &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    return sent == (ssize_t)conn->in.length;
+}
+
+// Resumes IO on a connection adopted or kept by this process
+static void resume_connection(EventLoop *loop, EventConnection *conn) {
+    if (!loop->ops->attach(loop, conn)) {
+        conn->closed = true;
+        event_loop_release_connection(loop, conn);
+        return;
+    }
+    event_loop_process_input(loop, conn);
+    if (!loop->ops->flush(loop, conn)) {
+        loop->ops->close(loop, conn);
+    }
+}
+
+void event_loop_finish_handoffs(EventLoop *loop) {
+    while (loop->handoffs) {
+        EventConnection *conn = loop->handoffs;
+        loop->handoffs = conn->next_handoff;
+
+        if (send_connection(loop, conn)) {
+            // The owner holds its own descriptor; ours is closed without shutdown
+            LOG_DEBUG("Handed connection to worker %d", conn->handoff_to);
+            conn->closed = true;
+            event_loop_release_connection(loop, conn);
+            continue;
+        }
+
+        LOG_WARN("Cannot hand connection to worker %d: %s; serving it here",
+                 conn->handoff_to, strerror(errno));
+        conn->handoff_to = -1;
+        conn->pinned = true;
+        resume_connection(loop, conn);
+    }
+}
+
+void event_loop_accept_handoffs(EventLoop *loop) {
+    for (;;) {
+        char control[CMSG_SPACE(sizeof(int))];
+        struct iovec iov = {loop->handoff_buffer, HANDOFF_MAX_BYTES};
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        ssize_t received = recvmsg(loop->shard->inbox_fd, &message, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+        if (received < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+
+        int fd = -1;
+        struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+        if (header && header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+            memcpy(&fd, CMSG_DATA(header), sizeof(int));
+        }
+        if (fd < 0) continue;
+        if (message.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+            close(fd);
+            continue;
+        }
+
+        EventConnection *conn = event_loop_add_connection(loop, fd);
+        if (!conn || !buffer_append(&conn->in, loop->handoff_buffer, (size_t)received)) {
+            if (conn) {
+                conn->closed = true;
+                event_loop_release_connection(loop, conn);
+            } else {
+                close(fd);
+            }
+            continue;
+        }
+        resume_connection(loop, conn);
+    }
+}
+
+ServerJob *event_loop_new_job(EventConnection *conn) {
+    EventLoop *loop = conn->loop;
+    ServerJob *job = loop->free_jobs;
+    if (job) {
+        loop->free_jobs = job->next;
+    } else {
+        job = malloc(sizeof(ServerJob));
+        if (!job) return NULL;
+        buffer_init(&job->reply);
+    }
+
+    buffer_reset(&job->reply);
+    job->conn = conn;
+    job->stream_started = false;
+    job->close_after_reply = false;
+    job->next = NULL;
+    return job;
+}
+
+static void recycle_job(EventLoop *loop, ServerJob *job) {
+    job->next = loop->free_jobs;
+    loop->free_jobs = job;
+}
+
+void event_loop_release_job(ServerJob *job) {
+    recycle_job(job->conn->loop, job);
+}
+
+static void wake_io_thread(EventLoop *loop) {
+    uint64_t one = 1;
+    ssize_t written = write(loop->completion_fd, &one, sizeof(one));
+    (void)written;
+}
+
+static void stream_event(StreamSink *sink, const char *type, const char *json, size_t length) {
+    ServerJob *job = sink->context;
+    job->conn->loop->protocol->stream_event(job, type, json, length);
+}
+
+// Hands the framed events so far to the IO thread without waiting for the job
+static void stream_flush(StreamSink *sink) {
+    ServerJob *job = sink->context;
+    EventConnection *conn = job->conn;
+    EventLoop *loop = conn->loop;
+    if (job->reply.length == 0) return;
+
+    if (!loop->pool) {
+        // Inline jobs run on the IO thread; a send error is picked up by the next flush
+        buffer_append(&conn->out, job->reply.data, job->reply.length);
+        buffer_reset(&job->reply);
+        loop->ops->flush(loop, conn);
+        return;
+    }
+
+    ServerChunk *chunk = malloc(sizeof(ServerChunk));
+    if (!chunk) return;
+    chunk->conn = conn;
+    chunk->data = job->reply;
+    buffer_init(&job->reply);
+
+    pthread_mutex_lock(&loop->completion_lock);
+    bool was_empty = loop->completed == NULL && loop->chunks == NULL;
+    chunk->next = loop->chunks;
+    loop->chunks = chunk;
+    pthread_mutex_unlock(&loop->completion_lock);
+
+    if (was_empty) wake_io_thread(loop);
+}
+
+static RequestStatus handle_job(ServerJob *job) {
+    if (job->request.stream && job->conn->loop->protocol->stream_event) {
+        job->sink.event = stream_event;
+        job->sink.flush = stream_flush;
+        job->sink.context = job;
+        return handle_chat_stream(&job->request, &job->sink);
+    }
+    return handle_chat_request(&job->request, &job->reply);
+}
+
+// Counts what the request allocated on this thread for /metrics
+static RequestStatus execute_job(ServerJob *job) {
+    AllocationCount before;
+    engine_allocations(&before);
+    RequestStatus status = handle_job(job);
+    engine_allocations(&job->allocations);
+    job->allocations.allocations -= before.allocations;
+    job->allocations.bytes -= before.bytes;
+    return status;
+}
+
+static void run_job(Task *task) {
+    ServerJob *job = (ServerJob *)task;
+    EventLoop *loop = job->conn->loop;
+
+    job->status = execute_job(job);
+
+    pthread_mutex_lock(&loop->completion_lock);
+    bool was_empty = loop->completed == NULL && loop->chunks == NULL;
+    job->next = loop->completed;
+    loop->completed = job;
+    pthread_mutex_unlock(&loop->completion_lock);
+
+    // One wakeup covers every completion queued before the IO thread drains
+    if (was_empty) wake_io_thread(loop);
+}
+
+static uint64_t session_key(const char *session_id) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (const unsigned char *ptr = (const unsigned char *)session_id; *ptr; ptr++) {
+        hash ^= *ptr;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void event_loop_dispatch(ServerJob *job) {
+    EventConnection *conn = job->conn;
+    EventLoop *loop = conn->loop;
+
+    RequestStatus verdict = admission_check(&loop->admission, &job->request, loop->pool != NULL);
+    if (verdict != REQUEST_OK) {
+        job->status = verdict;
+        append_json_error(&job->reply, job->request.correlation_id,
+                          verdict == REQUEST_BUSY ? "Server busy" : "Rate limit exceeded");
+        loop->protocol->complete(conn, job);
+        recycle_job(loop, job);
+        return;
+    }
+
+    if (!loop->pool) {
+        job->status = execute_job(job);
+        admission_finish(&loop->admission, false, &job->allocations);
+        loop->protocol->complete(conn, job);
+        recycle_job(loop, job);
+        return;
+    }
+
+    conn->inflight++;
+    job->task.run = run_job;
+    // Requests for one session are serialised so its context updates stay ordered
+    if (job->request.session_id[0]) {
+        worker_pool_submit_keyed(loop->pool, session_key(job->request.session_id), &job->task);
+    } else {
+        worker_pool_submit(loop->pool, &job->task);
+    }
+}
+
+void event_loop_drain_completions(EventLoop *loop) {
+    uint64_t count;
+    ssize_t drained = read(loop->completion_fd, &count, sizeof(count));
+    (void)drained;
+
+    pthread_mutex_lock(&loop->completion_lock);
+    ServerJob *job = loop->completed;
+    ServerChunk *chunk = loop->chunks;
+    loop->completed = NULL;
+    loop->chunks = NULL;
+    pthread_mutex_unlock(&loop->completion_lock);
+
+    // Both lists were pushed LIFO; restore finishing order
+    ServerChunk *chunks = NULL;
+    while (chunk) {
+        ServerChunk *next = chunk->next;
+        chunk->next = chunks;
+        chunks = chunk;
+        chunk = next;
+    }
+
+    // Chunks belong to jobs still in flight, so their connections are alive
+    while (chunks) {
+        ServerChunk *current = chunks;
+        chunks = chunks->next;
+        EventConnection *conn = current->conn;
+        if (!conn->closed) {
+            buffer_append(&conn->out, current->data.data, current->data.length);
+            if (!loop->ops->flush(loop, conn)) {
+                loop->ops->close(loop, conn);
+            }
+        }
+        buffer_free(&current->data);
+        free(current);
+    }
+
+    ServerJob *ordered = NULL;
+    while (job) {
+        ServerJob *next = job->next;
+        job->next = ordered;
+        ordered = job;
+        job = next;
+    }
+
+    while (ordered) {
+        ServerJob *current = ordered;
+        ordered = ordered->next;
+        EventConnection *conn = current->conn;
+        conn->inflight--;
+        admission_finish(&loop->admission, true, &current->allocations);
+
+        if (conn->closed) {
+            event_loop_release_connection(loop, conn);
+        } else {
+            loop->protocol->complete(conn, current);
+            event_loop_process_input(loop, conn);
+            if (!loop->ops->flush(loop, conn)) {
+                loop->ops->close(loop, conn);
+            }
+        }
+        recycle_job(loop, current);
+    }
+}
+
+// epoll backend: readiness-driven recv/send on non-blocking sockets
+
+static void update_interest(EventLoop *loop, EventConnection *conn) {
+    // A closing or backpressured connection only waits to drain its output
+    uint32_t interest = conn->close_after_write || event_loop_backpressured(conn) ? 0 : EPOLLIN | EPOLLRDHUP;
+    if (conn->out.length > 0) interest |= EPOLLOUT;
+    if (conn->interest == interest) return;
+
+    struct epoll_event event;
+    event.events = interest;
+    event.data.ptr = conn;
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+    conn->interest = interest;
+}
+
+static bool epoll_flush(EventLoop *loop, EventConnection *conn) {
+    if (conn->closed) return false;
+    if (conn->handoff_to >= 0) return true;
+
+    size_t sent_total = 0;
+    while (sent_total < conn->out.length) {
+        ssize_t sent = send(conn->fd, conn->out.data + sent_total, conn->out.length - sent_total, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        sent_total += (size_t)sent;
+    }
+    buffer_consume(&conn->out, sent_total);
+
+    update_interest(loop, conn);
+    return conn->out.length > 0 || conn->inflight > 0 || !conn->close_after_write;
+}
+
+// Connections with jobs in flight are retired by the last completion.
+static void epoll_close(EventLoop *loop, EventConnection *conn) {
+    if (conn->closed) return;
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    conn->closed = true;
+    event_loop_release_connection(loop, conn);
+}
+
+static bool epoll_attach(EventLoop *loop, EventConnection *conn) {
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.ptr = conn;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, conn->fd, &event) < 0) return false;
+    conn->interest = event.events;
+    return true;
+}
+
+static void epoll_detach(EventLoop *loop, EventConnection *conn) {
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    conn->interest = 0;
+    event_loop_detached(loop, conn);
+}
+
+static const IoBackendOps epoll_ops = {
+    "epoll",
+    epoll_flush,
+    epoll_close,
+    epoll_attach,
+    epoll_detach
+};
+
+static bool handle_readable(EventLoop *loop, EventConnection *conn) {
+    bool peer_closed = false;
+
+    while (!peer_closed && !event_loop_backpressured(conn)) {
+        if (!buffer_reserve(&conn->in, READ_CHUNK)) return false;
+
+        ssize_t received = recv(conn->fd, conn->in.data + conn->in.length, READ_CHUNK, 0);
+        if (received < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        if (received == 0) {
+            peer_closed = true;
+            break;
+        }
+        conn->in.length += (size_t)received;
+    }
+
+    event_loop_process_input(loop, conn);
+
+    if (peer_closed) {
+        conn->close_after_write = true;
+    }
+    return epoll_flush(loop, conn);
+}
+
+const ServerMetrics *event_loop_metrics(const EventConnection *conn) {
+    return &conn->loop->admission.metrics;
+}
+
+bool event_loop_reload(EventConnection *conn, OutputBuffer *out, const char *correlation_id) {
+    char error[256];
+    if (!catalog_reload(error, sizeof(error))) {
+        char message[300];
+        snprintf(message, sizeof(message), "Reload failed: %s", error);
+        append_json_error(out, correlation_id, message);
+        return false;
+    }
+
+    // The supervisor reloads too, so restarted workers start on the new
+    // data, and passes the signal on to the other workers
+    const WorkerShard *shard = conn->loop->shard;
+    if (shard && shard->count > 1 && getppid() > 1) {
+        kill(getppid(), SIGHUP);
+    }
+
+    buffer_append_str(out, "{");
+    if (correlation_id && correlation_id[0]) {
+        buffer_append_str(out, "\"id\":");
+        buffer_append_str(out, correlation_id);
+        buffer_append_str(out, ",");
+    }
+    buffer_append_str(out, "\"reloaded\":true,");
+    append_catalog_json(out);
+    buffer_append_str(out, "}\n");
+    return true;
+}
+
+bool event_loop_handle_signals(EventLoop *loop) {
+    bool running = true;
+    struct signalfd_siginfo info;
+    while (read(loop->signal_fd, &info, sizeof(info)) == (ssize_t)sizeof(info)) {
+        if (info.ssi_signo != SIGHUP) {
+            running = false;
+            continue;
+        }
+        // Failures are logged and leave the current catalog serving
+        char error[256];
+        catalog_reload(error, sizeof(error));
+    }
+    return running;
+}
+
+static void accept_connections(EventLoop *loop) {
+    for (;;) {
+        int fd = accept4(loop->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_WARN("accept failed: %s", strerror(errno));
+            }
+            return;
+        }
+
+        int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+        EventConnection *conn = event_loop_add_connection(loop, fd);
+        if (!conn) {
+            close(fd);
+            continue;
+        }
+        if (!epoll_attach(loop, conn)) {
+            conn->closed = true;
+            event_loop_release_connection(loop, conn);
+        }
+    }
+}
+
+static int run_epoll_backend(EventLoop *loop) {
+    loop->ops = &epoll_ops;
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll_fd < 0) {
+        LOG_ERROR("Failed to set up event loop: %s", strerror(errno));
+        return 1;
+    }
+
+    // The listener, signalfd and eventfd are told apart from connections by
+    // their address, since connection events carry a heap pointer.
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = &loop->listen_fd;
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->listen_fd, &event);
+    event.data.ptr = &loop->signal_fd;
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->signal_fd, &event);
+    event.data.ptr = &loop->completion_fd;
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->completion_fd, &event);
+    if (loop->shard) {
+        event.data.ptr = &loop->handoff_buffer;
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->shard->inbox_fd, &event);
+    }
+
+    bool running = true;
+    struct epoll_event events[MAX_EVENTS];
+
+    while (running) {
+        int ready = epoll_wait(loop->epoll_fd, events, MAX_EVENTS, -1);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("epoll_wait failed: %s", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < ready; i++) {
+            void *source = events[i].data.ptr;
+
+            if (source == &loop->listen_fd) {
+                accept_connections(loop);
+                continue;
+            }
+            if (source == &loop->signal_fd) {
+                running = event_loop_handle_signals(loop) && running;
+                continue;
+            }
+            if (source == &loop->completion_fd) {
+                event_loop_drain_completions(loop);
+                continue;
+            }
+            if (source == &loop->handoff_buffer) {
+                event_loop_accept_handoffs(loop);
+                continue;
+            }
+
+            EventConnection *conn = source;
+            if (conn->closed || conn->handoff_to >= 0) continue;
+            bool keep = true;
+
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                keep = false;
+            } else {
+                if (!conn->close_after_write && (events[i].events & (EPOLLIN | EPOLLRDHUP))) {
+                    keep = handle_readable(loop, conn);
+                }
+                if (keep && (events[i].events & EPOLLOUT)) {
+                    keep = epoll_flush(loop, conn);
+                }
+            }
+
+            if (!keep) {
+                epoll_close(loop, conn);
+            }
+        }
+
+        event_loop_finish_handoffs(loop);
+        event_loop_free_closed(loop);
+        catalog_collect();
+    }
+
+    close(loop->epoll_fd);
+    return 0;
+}
+
+int run_event_loop(int listen_fd, const ServerProtocol *protocol, const ServerOptions *options) {
+    EventLoop loop;
+    loop.listen_fd = listen_fd;
+    loop.protocol = protocol;
+    loop.pool = NULL;
+    loop.ops = NULL;
+    loop.epoll_fd = -1;
+    loop.uring = NULL;
+    loop.completed = NULL;
+    loop.chunks = NULL;
+    loop.free_jobs = NULL;
+    loop.closed = NULL;
+    loop.shard = options->shard;
+    loop.handoffs = NULL;
+    loop.handoff_buffer = NULL;
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGHUP);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    loop.signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    loop.completion_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loop.signal_fd < 0 || loop.completion_fd < 0) {
+        LOG_ERROR("Failed to set up event loop: %s", strerror(errno));
+        if (loop.signal_fd >= 0) close(loop.signal_fd);
+        if (loop.completion_fd >= 0) close(loop.completion_fd);
+        return 1;
+    }
+    if (!admission_init(&loop.admission, &options->admission)) {
+        LOG_ERROR("Failed to allocate rate limit buckets");
+        close(loop.signal_fd);
+        close(loop.completion_fd);
+        return 1;
+    }
+    if (loop.shard) {
+        loop.handoff_buffer = malloc(HANDOFF_MAX_BYTES);
+        if (!loop.handoff_buffer) {
+            admission_destroy(&loop.admission);
+            close(loop.signal_fd);
+            close(loop.completion_fd);
+            return 1;
+        }
+    }
+    if (options->workers > 0) {
+        loop.pool = worker_pool_create(options->workers);
+        if (!loop.pool) {
+            free(loop.handoff_buffer);
+            admission_destroy(&loop.admission);
+            close(loop.signal_fd);
+            close(loop.completion_fd);
+            return 1;
+        }
+    }
+    pthread_mutex_init(&loop.completion_lock, NULL);
+
+    int exit_code = -1;
+    if (options->backend == IO_BACKEND_URING) {
+        exit_code = run_uring_backend(&loop);
+        if (exit_code < 0) {
+            LOG_WARN("io_uring is not available on this kernel; using epoll");
+        }
+    }
+    if (exit_code < 0) {
+        exit_code = run_epoll_backend(&loop);
+    }
+
+    LOG_INFO("%s server shutting down", protocol->name);
+
+    // Workers must be idle before the jobs they reference are released
+    worker_pool_destroy(loop.pool);
+    while (loop.chunks) {
+        ServerChunk *chunk = loop.chunks;
+        loop.chunks = chunk->next;
+        buffer_free(&chunk->data);
+        free(chunk);
+    }
+    event_loop_free_closed(&loop);
+    while (loop.free_jobs) {
+        ServerJob *job = loop.free_jobs;
+        loop.free_jobs = job->next;
+        buffer_free(&job->reply);
+        free(job);
+    }
+
+    close(loop.signal_fd);
+    close(loop.completion_fd);
+    pthread_mutex_destroy(&loop.completion_lock);
+    admission_destroy(&loop.admission);
+    free(loop.handoff_buffer);
+    return exit_code;
+}
@@ -0,0 +1,336 @@
+#include "../../include/http_server.h"
+#include "../../include/event_loop.h"
+#include "../../include/prefork.h"
+#include "../../include/request_handler.h"
+#include "../../include/bricllm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#define MAX_HEADER_SIZE 8192
+#define MAX_BODY_SIZE 65536
+
+// Scratch space for response bodies; the event loop is single-threaded
+static OutputBuffer response_body;
+
+static const char *status_text(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 411: return "Length Required";
+        case 413: return "Payload Too Large";
+        case 429: return "Too Many Requests";
+        case 431: return "Request Header Fields Too Large";
+        case 503: return "Service Unavailable";
+        default: return "Internal Server Error";
+    }
+}
+
+static void queue_response(EventConnection *conn, int status, const OutputBuffer *body) {
+    buffer_appendf(&conn->out,
+                   "HTTP/1.1 %d %s\r\n"
+                   "Content-Type: application/json\r\n"
+                   "Content-Length: %zu\r\n"
+                   "Connection: %s\r\n"
+                   "%s"
+                   "\r\n",
+                   status, status_text(status), body->length,
+                   conn->close_after_write ? "close" : "keep-alive",
+                   status == 429 || status == 503 ? "Retry-After: 1\r\n" : "");
+    buffer_append(&conn->out, body->data, body->length);
+}
+
+static void queue_error(EventConnection *conn, int status, const char *message) {
+    buffer_reset(&response_body);
+    append_json_error(&response_body, NULL, message);
+    queue_response(conn, status, &response_body);
+}
+
+static bool header_equals(const char *name, size_t name_length, const char *expected) {
+    return name_length == strlen(expected) && strncasecmp(name, expected, name_length) == 0;
+}
+
+static bool value_contains_token(const char *value, size_t value_length, const char *token) {
+    size_t token_length = strlen(token);
+    for (size_t i = 0; i + token_length <= value_length; i++) {
+        if (strncasecmp(value + i, token, token_length) == 0) return true;
+    }
+    return false;
+}
+
+// Digits only, optionally followed by spaces; values past LONG_MAX saturate
+// and fail the body size check
+static bool parse_content_length(const char *value, size_t value_length, long *out) {
+    if (value_length == 0 || value[0] < '0' || value[0] > '9') return false;
+    char *end;
+    *out = strtol(value, &end, 10);
+    while (end < value + value_length && (*end == ' ' || *end == '\t')) end++;
+    return end == value + value_length;
+}
+
+// Returns false when the connection is moving to the worker that owns the
+// request's session; the request then stays in the input buffer.
+static bool dispatch_request(EventConnection *conn, const char *method, size_t method_length,
+                             const char *path, size_t path_length, const char *body, size_t body_length,
+                             bool wants_events, bool can_chunk) {
+    size_t route_length = 0;
+    while (route_length < path_length && path[route_length] != '?') {
+        route_length++;
+    }
+
+    bool is_chat = route_length == 5 && memcmp(path, "/chat", 5) == 0;
+    bool is_health = route_length == 7 && memcmp(path, "/health", 7) == 0;
+    bool is_metrics = route_length == 8 && memcmp(path, "/metrics", 8) == 0;
+    bool is_reload = route_length == 13 && memcmp(path, "/admin/reload", 13) == 0;
+    bool is_post = method_length == 4 && memcmp(method, "POST", 4) == 0;
+    bool is_get = method_length == 3 && memcmp(method, "GET", 3) == 0;
+
+    if (is_health) {
+        if (!is_get) {
+            queue_error(conn, 405, "Use GET /health");
+            return true;
+        }
+        buffer_reset(&response_body);
+        buffer_append_str(&response_body, "{\"status\":\"ok\"}\n");
+        queue_response(conn, 200, &response_body);
+        return true;
+    }
+
+    if (is_metrics) {
+        if (!is_get) {
+            queue_error(conn, 405, "Use GET /metrics");
+            return true;
+        }
+        buffer_reset(&response_body);
+        append_metrics_json(&response_body, NULL, event_loop_metrics(conn));
+        queue_response(conn, 200, &response_body);
+        return true;
+    }
+
+    if (is_reload) {
+        if (!is_post) {
+            queue_error(conn, 405, "Use POST /admin/reload");
+            return true;
+        }
+        buffer_reset(&response_body);
+        bool reloaded = event_loop_reload(conn, &response_body, NULL);
+        queue_response(conn, reloaded ? 200 : 500, &response_body);
+        return true;
+    }
+
+    if (!is_chat) {
+        queue_error(conn, 404, "Unknown endpoint");
+        return true;
+    }
+    if (!is_post) {
+        queue_error(conn, 405, "Use POST /chat");
+        return true;
+    }
+
+    ServerJob *job = event_loop_new_job(conn);
+    if (!job) {
+        queue_error(conn, 503, "Out of memory");
+        return true;
+    }
+
+    const char *error = NULL;
+    if (!parse_chat_request(body, body_length, &job->request, &error)) {
+        event_loop_release_job(job);
+        queue_error(conn, 400, error);
+        return true;
+    }
+    if (event_loop_route_session(conn, job->request.session_id)) {
+        event_loop_release_job(job);
+        return false;
+    }
+
+    // Server-Sent Events ride on chunked encoding, which HTTP/1.0 lacks
+    job->request.stream = (job->request.stream || wants_events) && can_chunk;
+    job->close_after_reply = conn->close_after_write;
+    event_loop_dispatch(job);
+    return true;
+}
+
+static long process_request(EventConnection *conn, const char *data, size_t length) {
+    const char *header_end = memmem(data, length, "\r\n\r\n", 4);
+    if (!header_end) {
+        if (length > MAX_HEADER_SIZE) {
+            conn->close_after_write = true;
+            queue_error(conn, 431, "Headers too large");
+            return -1;
+        }
+        return 0;
+    }
+
+    size_t header_length = (size_t)(header_end - data) + 4;
+    const char *line_end = memmem(data, header_length, "\r\n", 2);
+
+    const char *method = data;
+    const char *method_end = memchr(method, ' ', (size_t)(line_end - method));
+    const char *path = method_end ? method_end + 1 : NULL;
+    const char *path_end = path ? memchr(path, ' ', (size_t)(line_end - path)) : NULL;
+    const char *version = path_end ? path_end + 1 : NULL;
+
+    if (!version || line_end - version != 8 || memcmp(version, "HTTP/1.", 7) != 0) {
+        conn->close_after_write = true;
+        queue_error(conn, 400, "Malformed request line");
+        return -1;
+    }
+
+    bool http11 = version[7] == '1';
+    bool keep_alive = http11;
+    long content_length = 0;
+    bool has_length = false;
+    bool chunked = false;
+    bool wants_events = false;
+
+    const char *line = line_end + 2;
+    while (line < header_end) {
+        const char *next = memmem(line, (size_t)(header_end + 2 - line), "\r\n", 2);
+        const char *colon = memchr(line, ':', (size_t)(next - line));
+        if (colon) {
+            const char *value = colon + 1;
+            while (value < next && (*value == ' ' || *value == '\t')) value++;
+            size_t name_length = (size_t)(colon - line);
+            size_t value_length = (size_t)(next - value);
+
+            if (header_equals(line, name_length, "Content-Length")) {
+                if (has_length || !parse_content_length(value, value_length, &content_length)) {
+                    conn->close_after_write = true;
+                    queue_error(conn, 400, "Invalid Content-Length");
+                    return -1;
+                }
+                has_length = true;
+            } else if (header_equals(line, name_length, "Connection")) {
+                if (value_contains_token(value, value_length, "close")) keep_alive = false;
+                if (value_contains_token(value, value_length, "keep-alive")) keep_alive = true;
+            } else if (header_equals(line, name_length, "Transfer-Encoding")) {
+                chunked = value_contains_token(value, value_length, "chunked");
+            } else if (header_equals(line, name_length, "Accept")) {
+                wants_events = value_contains_token(value, value_length, "text/event-stream");
+            }
+        }
+        line = next + 2;
+    }
+
+    if (chunked) {
+        conn->close_after_write = true;
+        queue_error(conn, 411, "Chunked bodies are not supported");
+        return -1;
+    }
+    if (content_length > MAX_BODY_SIZE) {
+        conn->close_after_write = true;
+        queue_error(conn, 413, "Body too large");
+        return -1;
+    }
+    if (length < header_length + (size_t)content_length) {
+        return 0;
+    }
+
+    conn->close_after_write = !keep_alive;
+    if (!dispatch_request(conn, method, (size_t)(method_end - method), path, (size_t)(path_end - path),
+                          data + header_length, (size_t)content_length, wants_events, http11)) {
+        conn->close_after_write = false;
+        return 0;
+    }
+
+    return (long)(header_length + (size_t)content_length);
+}
+
+static void stream_request_event(ServerJob *job, const char *type, const char *json, size_t length) {
+    if (!job->stream_started) {
+        buffer_appendf(&job->reply,
+                       "HTTP/1.1 200 OK\r\n"
+                       "Content-Type: text/event-stream\r\n"
+                       "Cache-Control: no-cache\r\n"
+                       "Transfer-Encoding: chunked\r\n"
+                       "Connection: %s\r\n"
+                       "\r\n",
+                       job->close_after_reply ? "close" : "keep-alive");
+        job->stream_started = true;
+    }
+
+    // One chunk per event: "event: <type>\ndata: <json>\n\n"
+    size_t chunk_length = strlen(type) + length + 16;
+    buffer_appendf(&job->reply, "%zx\r\nevent: %s\ndata: ", chunk_length, type);
+    buffer_append(&job->reply, json, length);
+    buffer_append_str(&job->reply, "\n\n\r\n");
+}
+
+static void complete_request(EventConnection *conn, ServerJob *job) {
+    if (job->stream_started) {
+        buffer_append(&conn->out, job->reply.data, job->reply.length);
+        buffer_append_str(&conn->out, "0\r\n\r\n");
+        return;
+    }
+    int status;
+    switch (job->status) {
+        case REQUEST_OK: status = 200; break;
+        case REQUEST_THROTTLED: status = 429; break;
+        default: status = 503; break;
+    }
+    queue_response(conn, status, &job->reply);
+}
+
+static const ServerProtocol http_protocol = {
+    "HTTP",
+    process_request,
+    complete_request,
+    stream_request_event,
+    true
+};
+
+static int serve_http(int listen_fd, const ServerOptions *options) {
+    buffer_init(&response_body);
+    int exit_code = run_event_loop(listen_fd, &http_protocol, options);
+    buffer_free(&response_body);
+    return exit_code;
+}
+
+typedef struct {
+    const HttpServerConfig *config;
+    const int *listen_fds;
+} PreforkHttp;
+
+// Each worker process accepts on its own SO_REUSEPORT listener
+static int serve_http_worker(const WorkerShard *shard, void *context) {
+    const PreforkHttp *prefork = context;
+    ServerOptions options = prefork->config->options;
+    options.shard = shard;
+    LOG_INFO("Worker %d serving HTTP (pid %d)", shard->index, (int)getpid());
+    return serve_http(prefork->listen_fds[shard->index], &options);
+}
+
+int run_http_server(const HttpServerConfig *config) {
+    int processes = config->processes > 1 ? config->processes : 1;
+    if (processes > PREFORK_MAX_PROCESSES) return 1;
+
+    // Listeners are bound up front so a restarted worker inherits the queue
+    // of connections its predecessor had not accepted
+    int listen_fds[PREFORK_MAX_PROCESSES];
+    for (int i = 0; i < processes; i++) {
+        listen_fds[i] = create_tcp_listener(config->host, config->port, processes > 1);
+        if (listen_fds[i] < 0) {
+            while (i-- > 0) close(listen_fds[i]);
+            return 1;
+        }
+    }
+
+    int exit_code;
+    if (processes > 1) {
+        LOG_INFO("HTTP server listening on %s:%d with %d worker processes",
+                 config->host ? config->host : "*", config->port, processes);
+        PreforkHttp prefork = {config, listen_fds};
+        exit_code = run_prefork(processes, serve_http_worker, &prefork);
+    } else {
+        LOG_INFO("HTTP server listening on %s:%d", config->host ? config->host : "*", config->port);
+        exit_code = serve_http(listen_fds[0], &config->options);
+    }
+
+    for (int i = 0; i < processes; i++) close(listen_fds[i]);
+    return exit_code;
+}
@@ -0,0 +1,190 @@
+#include "../../include/prefork.h"
+#include "../../include/chat_engine.h"
+#include "../../include/catalog.h"
+#include "../../include/bricllm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+// Enough for a handed-off connection with a full request buffered
+#define INBOX_BUFFER (512 * 1024)
+
+typedef struct {
+    pid_t pid;
+    time_t started;
+} PreforkChild;
+
+typedef struct {
+    int count;
+    int inbox_fds[PREFORK_MAX_PROCESSES];
+    int peer_fds[PREFORK_MAX_PROCESSES];
+    PreforkChild children[PREFORK_MAX_PROCESSES];
+    PreforkServe serve;
+    void *context;
+} Prefork;
+
+static void close_inboxes(Prefork *prefork) {
+    for (int i = 0; i < prefork->count; i++) {
+        if (prefork->inbox_fds[i] >= 0) close(prefork->inbox_fds[i]);
+        if (prefork->peer_fds[i] >= 0) close(prefork->peer_fds[i]);
+    }
+}
+
+static bool open_inboxes(Prefork *prefork) {
+    for (int i = 0; i < prefork->count; i++) {
+        prefork->inbox_fds[i] = -1;
+        prefork->peer_fds[i] = -1;
+    }
+    for (int i = 0; i < prefork->count; i++) {
+        // Datagram boundaries keep each descriptor with its buffered bytes
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, pair) < 0) {
+            LOG_ERROR("Cannot create worker inbox: %s", strerror(errno));
+            close_inboxes(prefork);
+            return false;
+        }
+        int size = INBOX_BUFFER;
+        setsockopt(pair[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        setsockopt(pair[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        prefork->peer_fds[i] = pair[0];
+        prefork->inbox_fds[i] = pair[1];
+    }
+    return true;
+}
+
+static bool spawn_worker(Prefork *prefork, int index) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        LOG_ERROR("Cannot fork worker %d: %s", index, strerror(errno));
+        return false;
+    }
+    if (pid == 0) {
+        for (int i = 0; i < prefork->count; i++) {
+            if (i != index) close(prefork->inbox_fds[i]);
+        }
+        set_session_shard(index, prefork->count);
+
+        WorkerShard shard = {index, prefork->count, prefork->inbox_fds[index], prefork->peer_fds};
+        exit(prefork->serve(&shard, prefork->context));
+    }
+
+    prefork->children[index].pid = pid;
+    prefork->children[index].started = time(NULL);
+    return true;
+}
+
+static void stop_workers(Prefork *prefork) {
+    for (int i = 0; i < prefork->count; i++) {
+        if (prefork->children[i].pid > 0) kill(prefork->children[i].pid, SIGTERM);
+    }
+}
+
+static int find_worker(const Prefork *prefork, pid_t pid) {
+    for (int i = 0; i < prefork->count; i++) {
+        if (prefork->children[i].pid == pid) return i;
+    }
+    return -1;
+}
+
+// SIGHUP either comes from outside or from a worker that has already
+// reloaded for an admin request; that worker is not signalled again
+static void reload_workers(Prefork *prefork, pid_t sender) {
+    char error[256];
+    if (!catalog_reload(error, sizeof(error))) return;
+    for (int i = 0; i < prefork->count; i++) {
+        pid_t pid = prefork->children[i].pid;
+        if (pid > 0 && pid != sender) kill(pid, SIGHUP);
+    }
+}
+
+int run_prefork(int processes, PreforkServe serve, void *context) {
+    if (processes < 1 || processes > PREFORK_MAX_PROCESSES) return 1;
+
+    Prefork prefork;
+    memset(&prefork, 0, sizeof(prefork));
+    prefork.count = processes;
+    prefork.serve = serve;
+    prefork.context = context;
+    if (!open_inboxes(&prefork)) return 1;
+
+    // Workers inherit the blocked set and pick SIGINT/SIGTERM/SIGHUP up from signalfd
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGHUP);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    int running = 0;
+    int exit_code = 0;
+    bool stopping = false;
+    for (int i = 0; i < processes && !stopping; i++) {
+        if (spawn_worker(&prefork, i)) {
+            running++;
+        } else {
+            stopping = true;
+            exit_code = 1;
+            stop_workers(&prefork);
+        }
+    }
+
+    while (running > 0) {
+        siginfo_t info;
+        int signal_number = sigwaitinfo(&mask, &info);
+        if (signal_number < 0) continue;
+
+        if (signal_number == SIGHUP) {
+            if (!stopping) reload_workers(&prefork, info.si_pid);
+            continue;
+        }
+        if (signal_number != SIGCHLD) {
+            if (!stopping) {
+                LOG_INFO("Stopping %d worker processes", running);
+                stopping = true;
+                stop_workers(&prefork);
+            }
+            continue;
+        }
+
+        int status;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            int index = find_worker(&prefork, pid);
+            if (index < 0) continue;
+            prefork.children[index].pid = 0;
+            running--;
+            if (stopping) continue;
+
+            if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+                LOG_INFO("Worker %d (pid %d) exited", index, (int)pid);
+                continue;
+            }
+            if (WIFEXITED(status) && time(NULL) - prefork.children[index].started < 1) {
+                LOG_ERROR("Worker %d failed to start (status %d)", index, WEXITSTATUS(status));
+                exit_code = 1;
+                stopping = true;
+                stop_workers(&prefork);
+                continue;
+            }
+
+            if (WIFSIGNALED(status)) {
+                LOG_WARN("Worker %d (pid %d) killed by signal %d; restarting", index, (int)pid, WTERMSIG(status));
+            } else {
+                LOG_WARN("Worker %d (pid %d) exited with status %d; restarting", index, (int)pid, WEXITSTATUS(status));
+            }
+            // A worker that crashes on every request should not spin the supervisor
+            if (time(NULL) - prefork.children[index].started < 1) sleep(1);
+            if (spawn_worker(&prefork, index)) running++;
+        }
+    }
+
+    close_inboxes(&prefork);
+    return exit_code;
+}
@@ -0,0 +1,96 @@
+#include "../../include/socket_server.h"
+#include "../../include/event_loop.h"
+#include "../../include/request_handler.h"
+#include "../../include/bricllm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_LINE_SIZE 65536
+
+static long process_line(EventConnection *conn, const char *data, size_t length) {
+    const char *newline = memchr(data, '\n', length);
+    if (!newline) {
+        if (length > MAX_LINE_SIZE) {
+            append_json_error(&conn->out, NULL, "Request line too long");
+            return -1;
+        }
+        return 0;
+    }
+
+    size_t line_length = (size_t)(newline - data);
+    if (line_length > 0 && data[line_length - 1] == '\r') {
+        line_length--;
+    }
+
+    // Blank lines are keep-alive noise from line-oriented clients
+    size_t start = 0;
+    while (start < line_length && (data[start] == ' ' || data[start] == '\t')) start++;
+    if (start == line_length) {
+        return (long)(newline - data) + 1;
+    }
+
+    char op[32] = "";
+    if (json_get_string(data, line_length, "op", op, sizeof(op)) != 0) {
+        char id[CHAT_REQUEST_MAX_ID + 1] = "";
+        parse_correlation_id(data, line_length, id, sizeof(id));
+        bool named = json_get_string(data, line_length, "op", op, sizeof(op)) > 0;
+        if (named && strcmp(op, "metrics") == 0) {
+            append_metrics_json(&conn->out, id, event_loop_metrics(conn));
+        } else if (named && strcmp(op, "reload") == 0) {
+            event_loop_reload(conn, &conn->out, id);
+        } else {
+            append_json_error(&conn->out, id, "Unknown op");
+        }
+        return (long)(newline - data) + 1;
+    }
+
+    ServerJob *job = event_loop_new_job(conn);
+    if (!job) {
+        append_json_error(&conn->out, NULL, "Out of memory");
+        return (long)(newline - data) + 1;
+    }
+
+    const char *error = NULL;
+    if (!parse_chat_request(data, line_length, &job->request, &error)) {
+        append_json_error(&conn->out, job->request.correlation_id, error);
+        event_loop_release_job(job);
+    } else {
+        // Replies carry the request's id, so they may finish in any order
+        event_loop_dispatch(job);
+    }
+
+    return (long)(newline - data) + 1;
+}
+
+static void complete_line(EventConnection *conn, ServerJob *job) {
+    buffer_append(&conn->out, job->reply.data, job->reply.length);
+}
+
+// Streamed events are sent as one NDJSON line each, tagged with the request id
+static void stream_line_event(ServerJob *job, const char *type, const char *json, size_t length) {
+    (void)type;
+    buffer_append(&job->reply, json, length);
+    buffer_append_str(&job->reply, "\n");
+}
+
+static const ServerProtocol line_protocol = {
+    "Socket",
+    process_line,
+    complete_line,
+    stream_line_event,
+    false
+};
+
+int run_socket_server(const char *path, const ServerOptions *options) {
+    int listen_fd = create_unix_listener(path);
+    if (listen_fd < 0) return 1;
+
+    LOG_INFO("Socket server listening on %s", path);
+
+    int exit_code = run_event_loop(listen_fd, &line_protocol, options);
+    close(listen_fd);
+    unlink(path);
+    return exit_code;
+}
@@ -0,0 +1,509 @@
+#include "../../include/io_backend.h"
+#include "../../include/catalog.h"
+#include "../../include/bricllm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#define URING_ENTRIES 4096
+#define BUFFER_COUNT 1024       // power of two, required by the buffer ring
+#define BUFFER_SIZE 4096
+#define BUFFER_GROUP 0
+
+// user_data for the fixed descriptors; connections use their address plus
+// an operation tag in the low bits, which malloc alignment leaves free.
+enum {
+    TAG_ACCEPT = 1,
+    TAG_SIGNAL = 2,
+    TAG_COMPLETION = 3,
+    TAG_INBOX = 4,
+    TAG_CANCEL = 5
+};
+
+enum {
+    OP_RECV = 1,
+    OP_SEND = 2,
+    OP_MASK = 7
+};
+
+typedef struct {
+    int fd;
+    unsigned sq_entries;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *ring_memory;
+    size_t ring_size;
+    size_t sqes_size;
+
+    // SQEs written since the last io_uring_enter
+    unsigned sq_local_tail;
+    unsigned to_submit;
+
+    struct io_uring_buf_ring *buffer_ring;
+    size_t buffer_ring_size;
+    char *buffers;
+    unsigned short buffer_tail;
+
+    // Kernels with buffer rings but without multishot recv re-arm per read
+    bool single_shot_recv;
+    bool running;
+} Uring;
+
+static int uring_setup(unsigned entries, struct io_uring_params *params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+// Publishes queued SQEs and optionally waits for a completion in one syscall
+static int uring_submit(Uring *ring, unsigned wait_for) {
+    atomic_store_explicit((_Atomic unsigned *)ring->sq_tail, ring->sq_local_tail, memory_order_release);
+    unsigned flags = wait_for ? IORING_ENTER_GETEVENTS : 0;
+    if (ring->to_submit == 0 && wait_for == 0) return 0;
+
+    int submitted = uring_enter(ring->fd, ring->to_submit, wait_for, flags);
+    if (submitted < 0) return -errno;
+    ring->to_submit -= (unsigned)submitted < ring->to_submit ? (unsigned)submitted : ring->to_submit;
+    return submitted;
+}
+
+static struct io_uring_sqe *get_sqe(Uring *ring) {
+    unsigned head = atomic_load_explicit((_Atomic unsigned *)ring->sq_head, memory_order_acquire);
+    if (ring->sq_local_tail - head >= ring->sq_entries) {
+        uring_submit(ring, 0);
+        head = atomic_load_explicit((_Atomic unsigned *)ring->sq_head, memory_order_acquire);
+        if (ring->sq_local_tail - head >= ring->sq_entries) return NULL;
+    }
+
+    unsigned index = ring->sq_local_tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    ring->sq_local_tail++;
+    ring->to_submit++;
+    return sqe;
+}
+
+static void recycle_buffer(Uring *ring, unsigned short buffer_id) {
+    unsigned short mask = BUFFER_COUNT - 1;
+    struct io_uring_buf *buffer = &ring->buffer_ring->bufs[ring->buffer_tail & mask];
+    buffer->addr = (unsigned long)(ring->buffers + (size_t)buffer_id * BUFFER_SIZE);
+    buffer->len = BUFFER_SIZE;
+    buffer->bid = buffer_id;
+    ring->buffer_tail++;
+    atomic_store_explicit((_Atomic unsigned short *)&ring->buffer_ring->tail, ring->buffer_tail, memory_order_release);
+}
+
+static bool arm_accept(Uring *ring, int listen_fd) {
+    struct io_uring_sqe *sqe = get_sqe(ring);
+    if (!sqe) return false;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = TAG_ACCEPT;
+    return true;
+}
+
+static bool arm_poll(Uring *ring, int fd, unsigned long long tag) {
+    struct io_uring_sqe *sqe = get_sqe(ring);
+    if (!sqe) return false;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = tag;
+    return true;
+}
+
+static bool arm_recv(Uring *ring, EventConnection *conn) {
+    struct io_uring_sqe *sqe = get_sqe(ring);
+    if (!sqe) return false;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->fd;
+    sqe->ioprio = ring->single_shot_recv ? 0 : IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = (unsigned long long)(uintptr_t)conn | OP_RECV;
+    conn->io_pending++;
+    conn->receiving = true;
+    return true;
+}
+
+static bool cancel_recv(Uring *ring, EventConnection *conn) {
+    struct io_uring_sqe *sqe = get_sqe(ring);
+    if (!sqe) return false;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = (unsigned long long)(uintptr_t)conn | OP_RECV;
+    sqe->user_data = TAG_CANCEL;
+    return true;
+}
+
+// Keeps a recv outstanding unless the connection is backpressured, in which
+// case a multishot recv is cancelled and the next flush that drains it re-arms
+static bool update_reading(Uring *ring, EventConnection *conn) {
+    if (conn->close_after_write || conn->handoff_to >= 0) return true;
+    if (!event_loop_backpressured(conn)) return conn->receiving || arm_recv(ring, conn);
+    if (conn->receiving && !conn->recv_cancelling && !ring->single_shot_recv && cancel_recv(ring, conn)) {
+        conn->recv_cancelling = true;
+    }
+    return true;
+}
+
+static bool submit_send(Uring *ring, EventConnection *conn) {
+    struct io_uring_sqe *sqe = get_sqe(ring);
+    if (!sqe) return false;
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = conn->fd;
+    sqe->addr = (unsigned long long)(uintptr_t)conn->sending.data;
+    sqe->len = (unsigned)conn->sending.length;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (unsigned long long)(uintptr_t)conn | OP_SEND;
+    conn->io_pending++;
+    return true;
+}
+
+// Replies queued while a send is in flight collect in conn->out and go out
+// together once it completes, so the kernel never sees a moving buffer.
+static bool uring_flush(EventLoop *loop, EventConnection *conn) {
+    Uring *ring = loop->uring;
+    if (conn->closed) return false;
+    if (conn->handoff_to >= 0) return true;
+
+    if (conn->sending.length == 0 && conn->out.length > 0) {
+        OutputBuffer swap = conn->sending;
+        conn->sending = conn->out;
+        conn->out = swap;
+        if (!submit_send(ring, conn)) return false;
+    }
+    if (!update_reading(ring, conn)) return false;
+    return conn->sending.length > 0 || conn->inflight > 0 || !conn->close_after_write;
+}
+
+// shutdown() completes the pending recv; the descriptor is closed once the
+// connection is retired and no operation refers to it any more.
+static void uring_close(EventLoop *loop, EventConnection *conn) {
+    if (conn->closed) return;
+    conn->closed = true;
+    shutdown(conn->fd, SHUT_RDWR);
+    event_loop_release_connection(loop, conn);
+}
+
+static bool uring_attach(EventLoop *loop, EventConnection *conn) {
+    return arm_recv(loop->uring, conn);
+}
+
+// An idle connection only has its recv outstanding. Cancelling it ends the
+// multishot; handle_recv finishes the detach when the last CQE arrives.
+static void uring_detach(EventLoop *loop, EventConnection *conn) {
+    if (conn->io_pending == 0) {
+        event_loop_detached(loop, conn);
+        return;
+    }
+    if (!cancel_recv(loop->uring, conn)) {
+        // The recv keeps running, so the connection has to stay
+        conn->handoff_to = -1;
+        conn->pinned = true;
+        event_loop_process_input(loop, conn);
+    }
+}
+
+static const IoBackendOps uring_ops = {
+    "io_uring",
+    uring_flush,
+    uring_close,
+    uring_attach,
+    uring_detach
+};
+
+static void handle_accept(EventLoop *loop, Uring *ring, const struct io_uring_cqe *cqe) {
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        arm_accept(ring, loop->listen_fd);
+    }
+    if (cqe->res < 0) {
+        if (cqe->res != -EAGAIN && cqe->res != -EINTR) {
+            LOG_WARN("accept failed: %s", strerror(-cqe->res));
+        }
+        return;
+    }
+
+    int fd = cqe->res;
+    int enable = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+    EventConnection *conn = event_loop_add_connection(loop, fd);
+    if (!conn) {
+        close(fd);
+        return;
+    }
+    if (!arm_recv(ring, conn)) {
+        conn->closed = true;
+        event_loop_release_connection(loop, conn);
+    }
+}
+
+static void handle_recv(EventLoop *loop, Uring *ring, EventConnection *conn, const struct io_uring_cqe *cqe) {
+    bool more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+    if (!more) {
+        conn->io_pending--;
+        conn->receiving = false;
+        conn->recv_cancelling = false;
+    }
+
+    // Data that raced the cancel travels with the connection
+    if (conn->handoff_to >= 0) {
+        if (cqe->res > 0) {
+            unsigned short buffer_id = (unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+            buffer_append(&conn->in, ring->buffers + (size_t)buffer_id * BUFFER_SIZE, (size_t)cqe->res);
+            recycle_buffer(ring, buffer_id);
+        }
+        if (conn->io_pending == 0) {
+            event_loop_detached(loop, conn);
+        }
+        return;
+    }
+
+    if (cqe->res == -EINVAL && !ring->single_shot_recv) {
+        ring->single_shot_recv = true;
+    } else if (cqe->res > 0) {
+        unsigned short buffer_id = (unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        if (!conn->closed && !conn->close_after_write) {
+            buffer_append(&conn->in, ring->buffers + (size_t)buffer_id * BUFFER_SIZE, (size_t)cqe->res);
+        }
+        recycle_buffer(ring, buffer_id);
+    } else if (cqe->res == 0) {
+        conn->close_after_write = true;
+    } else if (cqe->res != -ENOBUFS && cqe->res != -ECANCELED) {
+        uring_close(loop, conn);
+    }
+
+    if (!conn->closed) {
+        if (cqe->res > 0) {
+            event_loop_process_input(loop, conn);
+            if (conn->handoff_to >= 0) return;
+        }
+        // The flush also re-arms a recv that ended
+        if (!uring_flush(loop, conn)) {
+            uring_close(loop, conn);
+        }
+    }
+    event_loop_release_connection(loop, conn);
+}
+
+static void handle_send(EventLoop *loop, EventConnection *conn, const struct io_uring_cqe *cqe) {
+    conn->io_pending--;
+    if (cqe->res < 0) {
+        buffer_reset(&conn->sending);
+        uring_close(loop, conn);
+    } else {
+        buffer_consume(&conn->sending, (size_t)cqe->res);
+        if (conn->sending.length > 0) {
+            // Short send: resubmit the remainder
+            if (conn->closed || !submit_send(loop->uring, conn)) {
+                uring_close(loop, conn);
+            }
+        } else if (!uring_flush(loop, conn)) {
+            uring_close(loop, conn);
+        }
+    }
+    event_loop_release_connection(loop, conn);
+}
+
+static void handle_cqe(EventLoop *loop, Uring *ring, const struct io_uring_cqe *cqe) {
+    unsigned long long data = cqe->user_data;
+
+    if (data == TAG_ACCEPT) {
+        handle_accept(loop, ring, cqe);
+        return;
+    }
+    if (data == TAG_SIGNAL) {
+        if (!event_loop_handle_signals(loop)) {
+            ring->running = false;
+        } else if (!(cqe->flags & IORING_CQE_F_MORE)) {
+            arm_poll(ring, loop->signal_fd, TAG_SIGNAL);
+        }
+        return;
+    }
+    if (data == TAG_COMPLETION) {
+        if (!(cqe->flags & IORING_CQE_F_MORE)) {
+            arm_poll(ring, loop->completion_fd, TAG_COMPLETION);
+        }
+        event_loop_drain_completions(loop);
+        return;
+    }
+    if (data == TAG_INBOX) {
+        if (!(cqe->flags & IORING_CQE_F_MORE)) {
+            arm_poll(ring, loop->shard->inbox_fd, TAG_INBOX);
+        }
+        event_loop_accept_handoffs(loop);
+        return;
+    }
+    if (data == TAG_CANCEL) {
+        return;
+    }
+
+    EventConnection *conn = (EventConnection *)(uintptr_t)(data & ~(unsigned long long)OP_MASK);
+    if ((data & OP_MASK) == OP_RECV) {
+        handle_recv(loop, ring, conn, cqe);
+    } else {
+        handle_send(loop, conn, cqe);
+    }
+}
+
+static void destroy_uring(Uring *ring) {
+    if (ring->fd >= 0) close(ring->fd);
+    if (ring->ring_memory && ring->ring_memory != MAP_FAILED) munmap(ring->ring_memory, ring->ring_size);
+    if (ring->sqes && (void *)ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_size);
+    if (ring->buffer_ring && (void *)ring->buffer_ring != MAP_FAILED) munmap(ring->buffer_ring, ring->buffer_ring_size);
+    free(ring->buffers);
+}
+
+static bool create_uring(Uring *ring) {
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+    ring->fd = uring_setup(URING_ENTRIES, &params);
+    if (ring->fd < 0 && errno == EINVAL) {
+        memset(&params, 0, sizeof(params));
+        ring->fd = uring_setup(URING_ENTRIES, &params);
+    }
+    if (ring->fd < 0) return false;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP)) return false;
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->ring_size = sq_size > cq_size ? sq_size : cq_size;
+    ring->ring_memory = mmap(NULL, ring->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             ring->fd, IORING_OFF_SQ_RING);
+    if (ring->ring_memory == MAP_FAILED) return false;
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if ((void *)ring->sqes == MAP_FAILED) return false;
+
+    char *base = ring->ring_memory;
+    ring->sq_entries = params.sq_entries;
+    ring->sq_head = (unsigned *)(base + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(base + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(base + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(base + params.sq_off.array);
+    ring->cq_head = (unsigned *)(base + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(base + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(base + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(base + params.cq_off.cqes);
+    ring->sq_local_tail = *ring->sq_tail;
+
+    // Provided buffer ring: recv picks a free buffer only when data arrives
+    ring->buffer_ring_size = BUFFER_COUNT * sizeof(struct io_uring_buf);
+    ring->buffer_ring = mmap(NULL, ring->buffer_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ((void *)ring->buffer_ring == MAP_FAILED) return false;
+    ring->buffers = malloc((size_t)BUFFER_COUNT * BUFFER_SIZE);
+    if (!ring->buffers) return false;
+
+    struct io_uring_buf_reg registration;
+    memset(&registration, 0, sizeof(registration));
+    registration.ring_addr = (unsigned long)ring->buffer_ring;
+    registration.ring_entries = BUFFER_COUNT;
+    registration.bgid = BUFFER_GROUP;
+    if (uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0) return false;
+
+    for (unsigned short id = 0; id < BUFFER_COUNT; id++) {
+        recycle_buffer(ring, id);
+    }
+    return true;
+}
+
+// Arms the fixed operations and checks that the kernel accepts multishot
+// accept; older kernels reject it immediately with EINVAL.
+static bool arm_fixed(EventLoop *loop, Uring *ring) {
+    if (!arm_accept(ring, loop->listen_fd) ||
+        !arm_poll(ring, loop->signal_fd, TAG_SIGNAL) ||
+        !arm_poll(ring, loop->completion_fd, TAG_COMPLETION) ||
+        (loop->shard && !arm_poll(ring, loop->shard->inbox_fd, TAG_INBOX)) ||
+        uring_submit(ring, 0) < 0) {
+        return false;
+    }
+
+    unsigned head = *ring->cq_head;
+    unsigned tail = atomic_load_explicit((_Atomic unsigned *)ring->cq_tail, memory_order_acquire);
+    for (; head != tail; head++) {
+        const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+        if (cqe->res == -EINVAL) return false;
+    }
+    return true;
+}
+
+int run_uring_backend(EventLoop *loop) {
+    Uring ring;
+    if (!create_uring(&ring) || !arm_fixed(loop, &ring)) {
+        destroy_uring(&ring);
+        return -1;
+    }
+
+    loop->ops = &uring_ops;
+    loop->uring = &ring;
+    ring.running = true;
+    LOG_INFO("Using io_uring backend (%u entries, %d x %d byte receive buffers)",
+             ring.sq_entries, BUFFER_COUNT, BUFFER_SIZE);
+
+    int exit_code = 0;
+    while (ring.running) {
+        // Every send queued by the previous batch goes out with this wait
+        int result = uring_submit(&ring, 1);
+        if (result < 0 && result != -EINTR && result != -EAGAIN && result != -EBUSY) {
+            LOG_ERROR("io_uring_enter failed: %s", strerror(-result));
+            exit_code = 1;
+            break;
+        }
+
+        unsigned head = *ring.cq_head;
+        unsigned tail;
+        while (head != (tail = atomic_load_explicit((_Atomic unsigned *)ring.cq_tail, memory_order_acquire))) {
+            for (; head != tail; head++) {
+                handle_cqe(loop, &ring, &ring.cqes[head & *ring.cq_mask]);
+            }
+            atomic_store_explicit((_Atomic unsigned *)ring.cq_head, head, memory_order_release);
+        }
+
+        event_loop_finish_handoffs(loop);
+        event_loop_free_closed(loop);
+        catalog_collect();
+    }
+
+    // Closing the ring cancels outstanding operations before buffers go away
+    destroy_uring(&ring);
+    loop->uring = NULL;
+    return exit_code;
+}
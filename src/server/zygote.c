@@ -0,0 +1,367 @@
+#include "../../include/zygote.h"
+#include "../../include/catalog.h"
+#include "../../include/bricllm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define ZYGOTE_MAX_REQUEST 65536
+#define ZYGOTE_MAX_ARGS 256
+#define ZYGOTE_MAX_CLIENTS 256
+
+// A request is one datagram: argv as NUL-terminated strings, with the
+// client's stdin, stdout and stderr attached. The reply is the wait status.
+typedef struct {
+    int fd;         // -1 once the client has gone
+    pid_t pid;      // 0 until the request has arrived
+} ZygoteClient;
+
+typedef struct {
+    int listen_fd;
+    int signal_fd;
+    ZygoteClient clients[ZYGOTE_MAX_CLIENTS];
+    int client_count;
+    ZygoteMain run;
+} Zygote;
+
+static int create_zygote_listener(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        LOG_ERROR("Invalid socket path");
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    struct stat info;
+    if (lstat(path, &info) == 0 && S_ISSOCK(info.st_mode)) {
+        unlink(path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        LOG_ERROR("Cannot create socket: %s", strerror(errno));
+        return -1;
+    }
+
+    // Whoever connects runs queries as this user, so only this user may
+    mode_t previous = umask(077);
+    int bound = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(previous);
+    if (bound < 0 || listen(fd, SOMAXCONN) < 0) {
+        LOG_ERROR("Cannot listen on %s: %s", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Returns argc, or -1 for anything but a well-formed request with three fds
+static int receive_request(int fd, char *buffer, char **argv, int stdio_fds[3]) {
+    struct iovec iov = {buffer, ZYGOTE_MAX_REQUEST - 1};
+    union {
+        struct cmsghdr header;
+        char space[CMSG_SPACE(3 * sizeof(int))];
+    } control;
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.space;
+    message.msg_controllen = sizeof(control.space);
+
+    ssize_t length = recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+
+    int received = 0;
+    for (struct cmsghdr *header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+        if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) continue;
+        int count = (int)((header->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        int *fds = (int *)CMSG_DATA(header);
+        for (int i = 0; i < count; i++) {
+            if (received < 3) {
+                stdio_fds[received++] = fds[i];
+            } else {
+                close(fds[i]);
+            }
+        }
+    }
+
+    bool valid = length > 0 && received == 3 && !(message.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) &&
+                 buffer[length - 1] == '\0';
+    int argc = 0;
+    for (char *arg = buffer; valid && arg < buffer + length; arg += strlen(arg) + 1) {
+        if (argc == ZYGOTE_MAX_ARGS) {
+            valid = false;
+            break;
+        }
+        argv[argc++] = arg;
+    }
+    if (!valid) {
+        for (int i = 0; i < received; i++) close(stdio_fds[i]);
+        return -1;
+    }
+    argv[argc] = NULL;
+    return argc;
+}
+
+static void run_child(Zygote *zygote, int stdio_fds[3], int argc, char **argv) {
+    close(zygote->listen_fd);
+    close(zygote->signal_fd);
+    for (int i = 0; i < zygote->client_count; i++) {
+        if (zygote->clients[i].fd >= 0) close(zygote->clients[i].fd);
+    }
+
+    // A zygote started without stdio may have received fds in 0-2
+    for (int i = 0; i < 3; i++) {
+        if (stdio_fds[i] < 3) stdio_fds[i] = fcntl(stdio_fds[i], F_DUPFD_CLOEXEC, 3);
+    }
+    for (int i = 0; i < 3; i++) {
+        if (stdio_fds[i] < 0 || dup2(stdio_fds[i], i) < 0) _exit(1);
+        close(stdio_fds[i]);
+    }
+
+    sigset_t none;
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, NULL);
+    signal(SIGPIPE, SIG_DFL);
+
+    // exit rather than _exit, so stdio and the logger flush as they would
+    exit(zygote->run(argc, argv));
+}
+
+static bool start_query(Zygote *zygote, ZygoteClient *client) {
+    char buffer[ZYGOTE_MAX_REQUEST];
+    char *argv[ZYGOTE_MAX_ARGS + 1];
+    int stdio_fds[3];
+
+    int argc = receive_request(client->fd, buffer, argv, stdio_fds);
+    if (argc <= 0) return false;
+
+    // The child would otherwise write out whatever stdio still holds
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid == 0) {
+        run_child(zygote, stdio_fds, argc, argv);
+    }
+    for (int i = 0; i < 3; i++) close(stdio_fds[i]);
+    if (pid < 0) {
+        LOG_ERROR("Cannot fork query: %s", strerror(errno));
+        return false;
+    }
+
+    client->pid = pid;
+    return true;
+}
+
+static void remove_client(Zygote *zygote, int index) {
+    if (zygote->clients[index].fd >= 0) close(zygote->clients[index].fd);
+    zygote->clients[index] = zygote->clients[--zygote->client_count];
+}
+
+static void report_status(Zygote *zygote, pid_t pid, int status) {
+    for (int i = 0; i < zygote->client_count; i++) {
+        if (zygote->clients[i].pid != pid) continue;
+        if (zygote->clients[i].fd >= 0) {
+            send(zygote->clients[i].fd, &status, sizeof(status), MSG_NOSIGNAL);
+        }
+        remove_client(zygote, i);
+        return;
+    }
+}
+
+static void reap_children(Zygote *zygote, bool block) {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, block ? 0 : WNOHANG)) > 0) {
+        report_status(zygote, pid, status);
+    }
+}
+
+static bool handle_signals(Zygote *zygote) {
+    bool running = true;
+    struct signalfd_siginfo info;
+    while (read(zygote->signal_fd, &info, sizeof(info)) == (ssize_t)sizeof(info)) {
+        if (info.ssi_signo == SIGCHLD) {
+            reap_children(zygote, false);
+        } else if (info.ssi_signo == SIGHUP) {
+            char error[256];
+            catalog_reload(error, sizeof(error));
+        } else {
+            running = false;
+        }
+    }
+    return running;
+}
+
+static void accept_clients(Zygote *zygote) {
+    while (zygote->client_count < ZYGOTE_MAX_CLIENTS) {
+        int fd = accept4(zygote->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        zygote->clients[zygote->client_count].fd = fd;
+        zygote->clients[zygote->client_count].pid = 0;
+        zygote->client_count++;
+    }
+}
+
+int run_zygote(const char *path, ZygoteMain run) {
+    Zygote zygote;
+    memset(&zygote, 0, sizeof(zygote));
+    zygote.run = run;
+    zygote.listen_fd = create_zygote_listener(path);
+    if (zygote.listen_fd < 0) return 1;
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGHUP);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    zygote.signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (zygote.signal_fd < 0) {
+        LOG_ERROR("Failed to set up zygote: %s", strerror(errno));
+        close(zygote.listen_fd);
+        unlink(path);
+        return 1;
+    }
+
+    LOG_INFO("Zygote listening on %s (pid %d)", path, (int)getpid());
+
+    struct pollfd fds[2 + ZYGOTE_MAX_CLIENTS];
+    bool running = true;
+    while (running) {
+        fds[0].fd = zygote.listen_fd;
+        fds[0].events = zygote.client_count < ZYGOTE_MAX_CLIENTS ? POLLIN : 0;
+        fds[1].fd = zygote.signal_fd;
+        fds[1].events = POLLIN;
+        int watched = zygote.client_count;
+        for (int i = 0; i < watched; i++) {
+            // Once the query runs, readability means the client hung up
+            fds[2 + i].fd = zygote.clients[i].fd;
+            fds[2 + i].events = POLLIN;
+        }
+
+        if (poll(fds, (nfds_t)(2 + watched), -1) < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("poll failed: %s", strerror(errno));
+            break;
+        }
+
+        // Clients first: reaping below reorders the table
+        for (int i = watched - 1; i >= 0; i--) {
+            if (!fds[2 + i].revents) continue;
+            ZygoteClient *client = &zygote.clients[i];
+            if (client->pid == 0) {
+                if (!start_query(&zygote, client)) remove_client(&zygote, i);
+            } else {
+                kill(client->pid, SIGTERM);
+                close(client->fd);
+                client->fd = -1;
+            }
+        }
+        if (fds[1].revents) {
+            running = handle_signals(&zygote);
+        }
+        if (fds[0].revents) {
+            accept_clients(&zygote);
+        }
+    }
+
+    LOG_INFO("Zygote shutting down");
+    close(zygote.listen_fd);
+    unlink(path);
+
+    // Queries already running still get their status back
+    for (int i = zygote.client_count - 1; i >= 0; i--) {
+        if (zygote.clients[i].pid == 0) remove_client(&zygote, i);
+    }
+    if (zygote.client_count > 0) reap_children(&zygote, true);
+
+    close(zygote.signal_fd);
+    return 0;
+}
+
+bool zygote_forward(const char *path, int argc, char **argv, int *exit_code) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) return false;
+    strcpy(addr.sun_path, path);
+
+    char payload[ZYGOTE_MAX_REQUEST];
+    size_t length = 0;
+    if (argc > ZYGOTE_MAX_ARGS) return false;
+    for (int i = 0; i < argc; i++) {
+        size_t size = strlen(argv[i]) + 1;
+        if (length + size >= sizeof(payload)) return false;
+        memcpy(payload + length, argv[i], size);
+        length += size;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return false;
+    }
+
+    int stdio_fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    union {
+        struct cmsghdr header;
+        char space[CMSG_SPACE(sizeof(stdio_fds))];
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct iovec iov = {payload, length};
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.space;
+    message.msg_controllen = sizeof(control.space);
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(stdio_fds));
+    memcpy(CMSG_DATA(header), stdio_fds, sizeof(stdio_fds));
+
+    if (sendmsg(fd, &message, MSG_NOSIGNAL) < 0) {
+        close(fd);
+        return false;
+    }
+
+    // The query may be running from here on, so it is never retried locally
+    int status;
+    ssize_t received;
+    do {
+        received = recv(fd, &status, sizeof(status), 0);
+    } while (received < 0 && errno == EINTR);
+    close(fd);
+
+    if (received != (ssize_t)sizeof(status)) {
+        fprintf(stderr, "Error: Lost connection to zygote\n");
+        *exit_code = 1;
+        return true;
+    }
+    if (WIFSIGNALED(status)) {
+        // Die the way the query did
+        signal(WTERMSIG(status), SIG_DFL);
+        raise(WTERMSIG(status));
+        *exit_code = 128 + WTERMSIG(status);
+        return true;
+    }
+    *exit_code = WEXITSTATUS(status);
+    return true;
+}
@@ -0,0 +1,63 @@
+#include "../../include/allocator.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void *libc_allocate(size_t size, void *context) {
+    (void)context;
+    return malloc(size);
+}
+
+static void *libc_reallocate(void *pointer, size_t size, void *context) {
+    (void)context;
+    return realloc(pointer, size);
+}
+
+static void libc_release(void *pointer, void *context) {
+    (void)context;
+    free(pointer);
+}
+
+static const EngineAllocator libc_allocator = {libc_allocate, libc_reallocate, libc_release, NULL};
+static EngineAllocator current = {libc_allocate, libc_reallocate, libc_release, NULL};
+
+// Thread-local, so counting costs two adds and no shared cache lines
+static _Thread_local AllocationCount counted;
+
+void set_engine_allocator(const EngineAllocator *allocator) {
+    current = allocator ? *allocator : libc_allocator;
+}
+
+void *engine_malloc(size_t size) {
+    counted.allocations++;
+    counted.bytes += size;
+    return current.allocate(size, current.context);
+}
+
+void *engine_calloc(size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) return NULL;
+    void *memory = engine_malloc(count * size);
+    if (memory) memset(memory, 0, count * size);
+    return memory;
+}
+
+void *engine_realloc(void *pointer, size_t size) {
+    counted.allocations++;
+    counted.bytes += size;
+    return current.reallocate(pointer, size, current.context);
+}
+
+char *engine_strdup(const char *text) {
+    size_t size = strlen(text) + 1;
+    char *copy = engine_malloc(size);
+    if (copy) memcpy(copy, text, size);
+    return copy;
+}
+
+void engine_free(void *pointer) {
+    if (pointer) current.release(pointer, current.context);
+}
+
+void engine_allocations(AllocationCount *count) {
+    *count = counted;
+}
@@ -1,49 +1,40 @@
 #include "../include/conversation_context.h"
 #include "../include/bricllm.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+#include <pthread.h>
 
 ConversationContext *create_conversation_context(void) {
-    ConversationContext *ctx = malloc(sizeof(ConversationContext));
+    ConversationContext *ctx = engine_malloc(sizeof(ConversationContext));
     if (!ctx) return NULL;
     
     ctx->last_topic = NULL;
     ctx->last_entity = NULL;
     ctx->last_action = NULL;
-    ctx->last_options = NULL;
-    ctx->option_count = 0;
     ctx->history_count = 0;
-    ctx->last_intent = NULL;
+    memset(&ctx->dialog, 0, sizeof(ctx->dialog));
     
     for (int i = 0; i < MAX_HISTORY; i++) {
         ctx->message_history[i] = NULL;
     }
     
-    log_message("INFO", "Created conversation context");
+    LOG_DEBUG("Created conversation context");
     return ctx;
 }
 
 void free_conversation_context(ConversationContext *ctx) {
     if (!ctx) return;
     
-    free(ctx->last_topic);
-    free(ctx->last_entity);
-    free(ctx->last_action);
-    free(ctx->last_intent);
-    
-    if (ctx->last_options) {
-        for (int i = 0; i < ctx->option_count; i++) {
-            free(ctx->last_options[i]);
-        }
-        free(ctx->last_options);
-    }
+    engine_free(ctx->last_topic);
+    engine_free(ctx->last_entity);
+    engine_free(ctx->last_action);
     
     for (int i = 0; i < MAX_HISTORY; i++) {
-        free(ctx->message_history[i]);
+        engine_free(ctx->message_history[i]);
     }
     
-    free(ctx);
+    engine_free(ctx);
 }
 
 void update_context(ConversationContext *ctx, const char *topic, 
@@ -51,21 +42,21 @@ void update_context(ConversationContext *ctx, const char *topic,
     if (!ctx) return;
     
     if (topic) {
-        free(ctx->last_topic);
-        ctx->last_topic = strdup(topic);
+        engine_free(ctx->last_topic);
+        ctx->last_topic = engine_strdup(topic);
     }
     
     if (entity) {
-        free(ctx->last_entity);
-        ctx->last_entity = strdup(entity);
+        engine_free(ctx->last_entity);
+        ctx->last_entity = engine_strdup(entity);
     }
     
     if (action) {
-        free(ctx->last_action);
-        ctx->last_action = strdup(action);
+        engine_free(ctx->last_action);
+        ctx->last_action = engine_strdup(action);
     }
     
-    log_message("INFO", "Context updated - topic: %s, entity: %s, action: %s",
+    LOG_DEBUG("Context updated - topic: %s, entity: %s, action: %s",
                topic ? topic : "none",
                entity ? entity : "none",
                action ? action : "none");
@@ -76,7 +67,7 @@ void add_to_history(ConversationContext *ctx, const char *message) {
     
     // If history is full, shift everything down
     if (ctx->history_count >= MAX_HISTORY) {
-        free(ctx->message_history[0]);
+        engine_free(ctx->message_history[0]);
         for (int i = 0; i < MAX_HISTORY - 1; i++) {
             ctx->message_history[i] = ctx->message_history[i + 1];
         }
@@ -84,117 +75,170 @@ void add_to_history(ConversationContext *ctx, const char *message) {
     }
     
     // Add new message at the end
-    ctx->message_history[ctx->history_count++] = strdup(message);
+    ctx->message_history[ctx->history_count++] = engine_strdup(message);
 }
 
-void set_context_options(ConversationContext *ctx, char **options, int count) {
-    if (!ctx) return;
-    
-    if (ctx->last_options) {
-        for (int i = 0; i < ctx->option_count; i++) {
-            free(ctx->last_options[i]);
-        }
-        free(ctx->last_options);
-    }
-    
-    ctx->last_options = malloc(count * sizeof(char*));
-    ctx->option_count = count;
-    
-    for (int i = 0; i < count; i++) {
-        ctx->last_options[i] = strdup(options[i]);
-    }
-}
+// Phrases that point back at the conversation. They are compiled once into a
+// word-level automaton (Aho-Corasick with the failure links folded into the
+// transitions), so a message is scanned in one pass over its tokens.
+typedef enum {
+    REFER_ACTION,       // "do it"
+    REFER_ENTITY,       // "where is it"
+    REFER_ALSO,
+    REFER_SAME,
+    REFER_ANOTHER,
+    REFER_COMPARE       // "what about"
+} Reference;
 
-static int contains_pronoun(const char *message) {
-    static const char *pronouns[] = {
-        "it", "that", "there", "this", "which",
-        "same", "also", "too", "another"
-    };
-    
-    char lower_msg[256];
-    strncpy(lower_msg, message, sizeof(lower_msg) - 1);
-    lower_msg[sizeof(lower_msg) - 1] = '\0';
-    
-    for (int i = 0; lower_msg[i]; i++) {
-        lower_msg[i] = tolower(lower_msg[i]);
-    }
-    
-    for (int i = 0; i < 9; i++) {
-        if (strstr(lower_msg, pronouns[i])) {
-            return 1;
-        }
+static const struct {
+    const char *phrase;
+    Reference kind;
+} reference_rules[] = {
+    {"do it", REFER_ACTION}, {"do that", REFER_ACTION},
+    {"where is it", REFER_ENTITY}, {"where is that", REFER_ENTITY}, {"get there", REFER_ENTITY},
+    {"also", REFER_ALSO}, {"too", REFER_ALSO},
+    {"same", REFER_SAME},
+    {"another", REFER_ANOTHER},
+    {"what about", REFER_COMPARE}, {"how about", REFER_COMPARE}
+};
+
+#define REFERENCE_RULES (int)(sizeof(reference_rules) / sizeof(reference_rules[0]))
+#define MAX_REFERENCE_WORDS 32      // distinct words over all phrases; word 0 is any other
+#define MAX_REFERENCE_STATES 32     // 1 + words over all phrases
+#define MAX_REFERENCE_WORD_LENGTH 16
+
+static char reference_words[MAX_REFERENCE_WORDS][MAX_REFERENCE_WORD_LENGTH];
+static int reference_word_count = 1;
+static unsigned char reference_next[MAX_REFERENCE_STATES][MAX_REFERENCE_WORDS];
+static unsigned reference_found[MAX_REFERENCE_STATES];     // bit per Reference ending here
+static pthread_once_t references_once = PTHREAD_ONCE_INIT;
+
+static int reference_word(const Token *token) {
+    for (int i = 1; i < reference_word_count; i++) {
+        if (token_is(token, reference_words[i])) return i;
     }
-    
     return 0;
 }
 
-char *resolve_pronoun(ConversationContext *ctx, const char *message) {
-    if (!ctx || !message || !contains_pronoun(message)) {
-        return NULL;
-    }
-    
-    static char resolved[512];
-    strncpy(resolved, message, sizeof(resolved) - 1);
-    resolved[sizeof(resolved) - 1] = '\0';
-    
-    char lower_msg[256];
-    strncpy(lower_msg, message, sizeof(lower_msg) - 1);
-    lower_msg[sizeof(lower_msg) - 1] = '\0';
-    
-    for (int i = 0; lower_msg[i]; i++) {
-        lower_msg[i] = tolower(lower_msg[i]);
-    }
-    
-    if (strstr(lower_msg, "how do i do it") || 
-        strstr(lower_msg, "how do i do that") ||
-        strstr(lower_msg, "do it") ||
-        strstr(lower_msg, "do that")) {
-        
-        if (ctx->last_action) {
-            snprintf(resolved, sizeof(resolved), "How do I %s?", ctx->last_action);
-            log_message("INFO", "Resolved pronoun 'it/that' -> '%s'", ctx->last_action);
-            return strdup(resolved);
+static void compile_references(void) {
+    signed char child[MAX_REFERENCE_STATES][MAX_REFERENCE_WORDS];
+    memset(child, -1, sizeof(child));
+    int states = 1;
+
+    for (int r = 0; r < REFERENCE_RULES; r++) {
+        TokenStream words;
+        tokenize_message(reference_rules[r].phrase, &words);
+        int state = 0;
+        for (int w = 0; w < words.count; w++) {
+            int id = reference_word(&words.tokens[w]);
+            if (id == 0) {
+                id = reference_word_count++;
+                memcpy(reference_words[id], words.tokens[w].text, (size_t)words.tokens[w].length);
+            }
+            if (child[state][id] < 0) child[state][id] = (signed char)states++;
+            state = child[state][id];
         }
+        reference_found[state] |= 1u << reference_rules[r].kind;
     }
-    
-    if (strstr(lower_msg, "where is it") || 
-        strstr(lower_msg, "where is that") ||
-        strstr(lower_msg, "get there")) {
-        
-        if (ctx->last_entity) {
-            snprintf(resolved, sizeof(resolved), "Where is %s?", ctx->last_entity);
-            log_message("INFO", "Resolved pronoun 'it/that/there' -> '%s'", ctx->last_entity);
-            return strdup(resolved);
+
+    // Breadth first, so a state's failure link is complete before its children need it
+    int queue[MAX_REFERENCE_STATES];
+    int fail[MAX_REFERENCE_STATES] = {0};
+    int head = 0;
+    int tail = 0;
+    for (int id = 0; id < reference_word_count; id++) {
+        reference_next[0][id] = child[0][id] > 0 ? (unsigned char)child[0][id] : 0;
+        if (child[0][id] > 0) queue[tail++] = child[0][id];
+    }
+    while (head < tail) {
+        int state = queue[head++];
+        reference_found[state] |= reference_found[fail[state]];
+        for (int id = 0; id < reference_word_count; id++) {
+            int next = child[state][id];
+            if (next < 0) {
+                reference_next[state][id] = reference_next[fail[state]][id];
+            } else {
+                fail[next] = reference_next[fail[state]][id];
+                reference_next[state][id] = (unsigned char)next;
+                queue[tail++] = next;
+            }
         }
     }
-    
-    if (strstr(lower_msg, "which") && ctx->option_count > 0) {
-        snprintf(resolved, sizeof(resolved), "Tell me about %s options", 
-                ctx->last_topic ? ctx->last_topic : "the");
-        log_message("INFO", "Resolved 'which' -> asking about %s options", 
-                   ctx->last_topic ? ctx->last_topic : "the");
-        return strdup(resolved);
-    }
-    
-    if ((strstr(lower_msg, "also") || strstr(lower_msg, "too")) && ctx->last_topic) {
-        log_message("INFO", "Detected 'also/too' - previous context: %s", ctx->last_topic);
+}
+
+static unsigned find_references(const TokenStream *tokens) {
+    pthread_once(&references_once, compile_references);
+
+    unsigned found = 0;
+    int state = 0;
+    for (int i = 0; i < tokens->count; i++) {
+        state = reference_next[state][reference_word(&tokens->tokens[i])];
+        found |= reference_found[state];
     }
-    
-    if (strstr(lower_msg, "same") && ctx->last_topic) {
-        snprintf(resolved, sizeof(resolved), "%s", ctx->last_topic);
-        log_message("INFO", "Resolved 'same' -> '%s'", ctx->last_topic);
-        return strdup(resolved);
+    return found;
+}
+
+// Allocated to fit; the only allocation on the way through
+static char *format_rewrite(const char *format, const char *value) {
+    int length = snprintf(NULL, 0, format, value);
+    char *text = engine_malloc((size_t)length + 1);
+    if (text) snprintf(text, (size_t)length + 1, format, value);
+    return text;
+}
+
+#define REFERS(found, kind) (((found) >> (kind)) & 1u)
+
+typedef struct {
+    Reference kind;
+    const char *format;
+    const char *value;
+} Rewrite;
+
+// The rewrite the message calls for, most specific first
+static bool find_rewrite(const ConversationContext *ctx, unsigned found, Rewrite *rewrite) {
+    if (REFERS(found, REFER_ACTION) && ctx->last_action) {
+        *rewrite = (Rewrite){REFER_ACTION, "How do I %s?", ctx->last_action};
+    } else if (REFERS(found, REFER_ENTITY) && ctx->last_entity) {
+        *rewrite = (Rewrite){REFER_ENTITY, "Where is %s?", ctx->last_entity};
+    } else if (REFERS(found, REFER_SAME) && ctx->last_topic) {
+        *rewrite = (Rewrite){REFER_SAME, "%s", ctx->last_topic};
+    } else if (REFERS(found, REFER_ANOTHER) && ctx->last_entity) {
+        *rewrite = (Rewrite){REFER_ANOTHER, "another %s", ctx->last_entity};
+    } else {
+        return false;
+    }
+    return true;
+}
+
+char *resolve_pronoun(ConversationContext *ctx, const TokenStream *tokens) {
+    if (!ctx || !tokens) return NULL;
+
+    unsigned found = find_references(tokens);
+    if (!found) return NULL;
+
+    if (REFERS(found, REFER_ALSO) && ctx->last_topic) {
+        LOG_DEBUG("Detected 'also/too' - previous context: %s", ctx->last_topic);
     }
-    
-    if (strstr(lower_msg, "another") && ctx->last_entity) {
-        snprintf(resolved, sizeof(resolved), "another %s", ctx->last_entity);
-        log_message("INFO", "Resolved 'another' -> 'another %s'", ctx->last_entity);
-        return strdup(resolved);
+    if (REFERS(found, REFER_COMPARE) && ctx->last_topic) {
+        LOG_DEBUG("Detected comparison question about: %s", ctx->last_topic);
     }
-    
-    if ((strstr(lower_msg, "what about") || strstr(lower_msg, "how about")) && ctx->last_topic) {
-        log_message("INFO", "Detected comparison question about: %s", ctx->last_topic);
+
+    Rewrite rewrite;
+    if (!find_rewrite(ctx, found, &rewrite)) return NULL;
+    LOG_DEBUG("Resolved reference %d -> '%s'", (int)rewrite.kind, rewrite.value);
+    return format_rewrite(rewrite.format, rewrite.value);
+}
+
+uint64_t context_fingerprint(const ConversationContext *ctx, const TokenStream *tokens) {
+    if (!ctx || !tokens) return 0;
+
+    unsigned found = find_references(tokens);
+    Rewrite rewrite;
+    if (!found || !find_rewrite(ctx, found, &rewrite)) return 0;
+
+    uint64_t hash = (1469598103934665603ULL ^ (uint64_t)(rewrite.kind + 1)) * 1099511628211ULL;
+    for (const unsigned char *c = (const unsigned char *)rewrite.value; *c; c++) {
+        hash = (hash ^ *c) * 1099511628211ULL;
     }
-    
-    return NULL;
+    return hash ? hash : 1;
 }
@@ -0,0 +1,381 @@
+#include "../../include/json_io.h"
+#include "../../include/allocator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+void buffer_init(OutputBuffer *buffer) {
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+}
+
+void buffer_free(OutputBuffer *buffer) {
+    engine_free(buffer->data);
+    buffer_init(buffer);
+}
+
+void buffer_reset(OutputBuffer *buffer) {
+    buffer->length = 0;
+}
+
+bool buffer_reserve(OutputBuffer *buffer, size_t additional) {
+    if (buffer->length + additional <= buffer->capacity) {
+        return true;
+    }
+
+    size_t capacity = buffer->capacity ? buffer->capacity : 256;
+    while (capacity < buffer->length + additional) {
+        capacity *= 2;
+    }
+
+    char *data = engine_realloc(buffer->data, capacity);
+    if (!data) return false;
+
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return true;
+}
+
+bool buffer_append(OutputBuffer *buffer, const char *data, size_t length) {
+    if (!buffer_reserve(buffer, length)) return false;
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    return true;
+}
+
+bool buffer_append_str(OutputBuffer *buffer, const char *str) {
+    return buffer_append(buffer, str, strlen(str));
+}
+
+bool buffer_appendf(OutputBuffer *buffer, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    va_list copy;
+    va_copy(copy, args);
+
+    size_t available = buffer->capacity - buffer->length;
+    int needed = vsnprintf(buffer->data ? buffer->data + buffer->length : NULL, available, format, args);
+    va_end(args);
+
+    if (needed < 0) {
+        va_end(copy);
+        return false;
+    }
+
+    if ((size_t)needed >= available) {
+        if (!buffer_reserve(buffer, (size_t)needed + 1)) {
+            va_end(copy);
+            return false;
+        }
+        vsnprintf(buffer->data + buffer->length, (size_t)needed + 1, format, copy);
+    }
+    va_end(copy);
+
+    buffer->length += (size_t)needed;
+    return true;
+}
+
+void buffer_consume(OutputBuffer *buffer, size_t length) {
+    if (length >= buffer->length) {
+        buffer->length = 0;
+        return;
+    }
+    memmove(buffer->data, buffer->data + length, buffer->length - length);
+    buffer->length -= length;
+}
+
+// Second character of each byte's escape; 0 for bytes copied as-is, 'u' for \u00XX
+static const char escape_table[256] = {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    ['"'] = '"',
+    ['\\'] = '\\'
+};
+
+// Length of the prefix that needs no escaping
+static size_t clean_run(const unsigned char *ptr, size_t length) {
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control_max = _mm_set1_epi8(0x1F);
+    for (; i + 16 <= length; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(ptr + i));
+        __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(chunk, control_max), chunk);
+        __m128i special = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash));
+        int mask = _mm_movemask_epi8(_mm_or_si128(control, special));
+        if (mask) return i + (size_t)__builtin_ctz((unsigned)mask);
+    }
+#endif
+    while (i < length && !escape_table[ptr[i]]) {
+        i++;
+    }
+    return i;
+}
+
+bool json_append_string(OutputBuffer *buffer, const char *value) {
+    static const char hex[] = "0123456789abcdef";
+    size_t length = value ? strlen(value) : 0;
+    const unsigned char *ptr = (const unsigned char *)value;
+
+    // Capacity always covers the unread input plus the closing quote
+    if (!buffer_reserve(buffer, length + 2)) return false;
+    buffer->data[buffer->length++] = '"';
+
+    size_t pos = 0;
+    while (pos < length) {
+        size_t run = clean_run(ptr + pos, length - pos);
+        memcpy(buffer->data + buffer->length, ptr + pos, run);
+        buffer->length += run;
+        pos += run;
+        if (pos == length) break;
+
+        unsigned char byte = ptr[pos++];
+        if (!buffer_reserve(buffer, 6 + (length - pos) + 1)) return false;
+        char *out = buffer->data + buffer->length;
+        out[0] = '\\';
+        out[1] = escape_table[byte];
+        if (out[1] == 'u') {
+            out[2] = '0';
+            out[3] = '0';
+            out[4] = hex[byte >> 4];
+            out[5] = hex[byte & 0xF];
+            buffer->length += 6;
+        } else {
+            buffer->length += 2;
+        }
+    }
+
+    buffer->data[buffer->length++] = '"';
+    return true;
+}
+
+bool buffer_write(const OutputBuffer *buffer, int fd) {
+    size_t written = 0;
+    while (written < buffer->length) {
+        ssize_t result = write(fd, buffer->data + written, buffer->length - written);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        written += (size_t)result;
+    }
+    return true;
+}
+
+static const char *skip_whitespace(const char *ptr, const char *end) {
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t' || *ptr == '\n' || *ptr == '\r')) {
+        ptr++;
+    }
+    return ptr;
+}
+
+// Returns a pointer just past the closing quote, or NULL if unterminated.
+static const char *skip_string(const char *ptr, const char *end) {
+    ptr++;
+    while (ptr < end) {
+        if (*ptr == '\\') {
+            ptr += 2;
+        } else if (*ptr == '"') {
+            return ptr + 1;
+        } else {
+            ptr++;
+        }
+    }
+    return NULL;
+}
+
+static const char *skip_value(const char *ptr, const char *end) {
+    if (ptr >= end) return NULL;
+
+    if (*ptr == '"') {
+        return skip_string(ptr, end);
+    }
+
+    if (*ptr == '{' || *ptr == '[') {
+        int depth = 0;
+        while (ptr < end) {
+            if (*ptr == '"') {
+                ptr = skip_string(ptr, end);
+                if (!ptr) return NULL;
+                continue;
+            }
+            if (*ptr == '{' || *ptr == '[') depth++;
+            if (*ptr == '}' || *ptr == ']') {
+                depth--;
+                if (depth == 0) return ptr + 1;
+            }
+            ptr++;
+        }
+        return NULL;
+    }
+
+    while (ptr < end && *ptr != ',' && *ptr != '}' && *ptr != ']' &&
+           *ptr != ' ' && *ptr != '\t' && *ptr != '\n' && *ptr != '\r') {
+        ptr++;
+    }
+    return ptr;
+}
+
+static bool key_equals(const char *start, const char *end, const char *key) {
+    size_t key_length = strlen(key);
+    // start/end bracket the raw key including quotes; keys with escapes never match
+    return (size_t)(end - start) == key_length + 2 && memcmp(start + 1, key, key_length) == 0;
+}
+
+// Locates the raw value for key in a top-level object.
+static const char *find_value(const char *json, size_t length, const char *key, const char **value_end) {
+    if (!json || !key) return NULL;
+
+    const char *end = json + length;
+    const char *ptr = skip_whitespace(json, end);
+    if (ptr >= end || *ptr != '{') return NULL;
+    ptr++;
+
+    while (ptr < end) {
+        ptr = skip_whitespace(ptr, end);
+        if (ptr < end && *ptr == '}') return NULL;
+        if (ptr >= end || *ptr != '"') return NULL;
+
+        const char *key_start = ptr;
+        ptr = skip_string(ptr, end);
+        if (!ptr) return NULL;
+        const char *key_end = ptr;
+
+        ptr = skip_whitespace(ptr, end);
+        if (ptr >= end || *ptr != ':') return NULL;
+        ptr = skip_whitespace(ptr + 1, end);
+
+        const char *value = ptr;
+        ptr = skip_value(ptr, end);
+        if (!ptr) return NULL;
+
+        if (key_equals(key_start, key_end, key)) {
+            *value_end = ptr;
+            return value;
+        }
+
+        ptr = skip_whitespace(ptr, end);
+        if (ptr < end && *ptr == ',') ptr++;
+    }
+
+    return NULL;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static size_t encode_utf8(unsigned int codepoint, char *out) {
+    if (codepoint < 0x80) {
+        out[0] = (char)codepoint;
+        return 1;
+    }
+    if (codepoint < 0x800) {
+        out[0] = (char)(0xC0 | (codepoint >> 6));
+        out[1] = (char)(0x80 | (codepoint & 0x3F));
+        return 2;
+    }
+    if (codepoint < 0x10000) {
+        out[0] = (char)(0xE0 | (codepoint >> 12));
+        out[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (codepoint >> 18));
+    out[1] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+static bool read_hex4(const char *ptr, const char *end, unsigned int *out) {
+    if (end - ptr < 4) return false;
+    unsigned int value = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = hex_value(ptr[i]);
+        if (digit < 0) return false;
+        value = (value << 4) | (unsigned int)digit;
+    }
+    *out = value;
+    return true;
+}
+
+int json_get_string(const char *json, size_t length, const char *key, char *out, size_t out_size) {
+    const char *value_end;
+    const char *ptr = find_value(json, length, key, &value_end);
+    if (!ptr) return 0;
+    if (*ptr != '"' || out_size == 0) return -1;
+
+    const char *end = value_end - 1;
+    size_t written = 0;
+    ptr++;
+
+    while (ptr < end) {
+        char decoded[4];
+        size_t decoded_length = 1;
+
+        if (*ptr != '\\') {
+            decoded[0] = *ptr++;
+        } else {
+            ptr++;
+            if (ptr >= end) return -1;
+            char escape = *ptr++;
+            switch (escape) {
+                case '"': decoded[0] = '"'; break;
+                case '\\': decoded[0] = '\\'; break;
+                case '/': decoded[0] = '/'; break;
+                case 'b': decoded[0] = '\b'; break;
+                case 'f': decoded[0] = '\f'; break;
+                case 'n': decoded[0] = '\n'; break;
+                case 'r': decoded[0] = '\r'; break;
+                case 't': decoded[0] = '\t'; break;
+                case 'u': {
+                    unsigned int codepoint;
+                    if (!read_hex4(ptr, end, &codepoint)) return -1;
+                    ptr += 4;
+                    if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+                        unsigned int low;
+                        if (end - ptr < 6 || ptr[0] != '\\' || ptr[1] != 'u' ||
+                            !read_hex4(ptr + 2, end, &low) || low < 0xDC00 || low > 0xDFFF) {
+                            return -1;
+                        }
+                        ptr += 6;
+                        codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    decoded_length = encode_utf8(codepoint, decoded);
+                    break;
+                }
+                default:
+                    return -1;
+            }
+        }
+
+        if (written + decoded_length >= out_size) return -1;
+        memcpy(out + written, decoded, decoded_length);
+        written += decoded_length;
+    }
+
+    out[written] = '\0';
+    return 1;
+}
+
+bool json_get_raw(const char *json, size_t length, const char *key, const char **value, size_t *value_length) {
+    const char *value_end;
+    const char *ptr = find_value(json, length, key, &value_end);
+    if (!ptr) return false;
+
+    *value = ptr;
+    *value_length = (size_t)(value_end - ptr);
+    return true;
+}
@@ -2,35 +2,324 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <time.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
 
-char *get_timestamp(void) {
-    static char timestamp[20];
-    time_t now = time(NULL);
-    struct tm *tm_info = localtime(&now);
+#define LOG_RING_SLOTS 128
+#define LOG_RECORD_TEXT 496
+#define LOG_BATCH_SIZE 65536
+#define LOG_IDLE_WAIT_MS 20
 
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", tm_info);
-    return timestamp;
+typedef struct {
+    time_t time;
+    LogLevel level;
+    int length;
+    char text[LOG_RECORD_TEXT];
+} LogRecord;
+
+// Single-producer ring owned by one thread at a time, drained by the writer.
+// Rings are never freed; a thread's ring is handed to the next new thread
+// once it exits.
+typedef struct LogRing {
+    _Alignas(64) atomic_size_t head;
+    _Alignas(64) atomic_size_t tail;
+    atomic_bool claimed;
+    atomic_ulong dropped;
+    struct LogRing *next;
+    LogRecord records[LOG_RING_SLOTS];
+} LogRing;
+
+LogLevel log_runtime_level = LOG_LEVEL_INFO;
+
+static _Atomic(LogRing *) rings;
+static _Thread_local LogRing *thread_ring;
+static pthread_key_t ring_key;
+static pthread_once_t logger_once = PTHREAD_ONCE_INIT;
+
+static int log_fd = STDERR_FILENO;
+static atomic_bool writer_running;
+static bool writer_stopping;
+static bool logger_stopped;     // after logger_shutdown the writer stays down
+static bool writer_wake_pending;
+static pthread_t writer_thread;
+static pthread_mutex_t start_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t wake_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake_cond = PTHREAD_COND_INITIALIZER;
+
+// Serialises draining between the writer thread and explicit flushes
+static pthread_mutex_t drain_lock = PTHREAD_MUTEX_INITIALIZER;
+static char batch[LOG_BATCH_SIZE];
+static size_t batch_length;
+static time_t cached_second = -1;
+static char cached_timestamp[20];
+
+static const char *level_name(LogLevel level) {
+    switch (level) {
+        case LOG_LEVEL_DEBUG: return "DEBUG";
+        case LOG_LEVEL_INFO: return "INFO";
+        case LOG_LEVEL_WARN: return "WARN";
+        default: return "ERROR";
+    }
+}
+
+bool parse_log_level(const char *name, LogLevel *level) {
+    static const char *names[] = {"debug", "info", "warn", "error", "off"};
+    for (int i = 0; i <= LOG_LEVEL_OFF; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *level = (LogLevel)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool logger_set_file(const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    if (log_fd != STDERR_FILENO) close(log_fd);
+    log_fd = fd;
+    return true;
+}
+
+static void write_batch(void) {
+    size_t written = 0;
+    while (written < batch_length) {
+        ssize_t result = write(log_fd, batch + written, batch_length - written);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        written += (size_t)result;
+    }
+    batch_length = 0;
+}
+
+static void append_line(time_t when, LogLevel level, const char *text, int length) {
+    if (when != cached_second) {
+        struct tm tm_info;
+        localtime_r(&when, &tm_info);
+        strftime(cached_timestamp, sizeof(cached_timestamp), "%Y-%m-%d %H:%M:%S", &tm_info);
+        cached_second = when;
+    }
+
+    if (batch_length + LOG_RECORD_TEXT + 64 > sizeof(batch)) {
+        write_batch();
+    }
+    int added = snprintf(batch + batch_length, sizeof(batch) - batch_length, "[%s] [%s] %.*s\n",
+                         cached_timestamp, level_name(level), length, text);
+    if (added > 0) batch_length += (size_t)added;
+}
+
+static void drain_rings(void) {
+    pthread_mutex_lock(&drain_lock);
+    for (LogRing *ring = atomic_load_explicit(&rings, memory_order_acquire); ring; ring = ring->next) {
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        for (; tail != head; tail++) {
+            const LogRecord *record = &ring->records[tail % LOG_RING_SLOTS];
+            append_line(record->time, record->level, record->text, record->length);
+        }
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+
+        unsigned long dropped = atomic_exchange_explicit(&ring->dropped, 0, memory_order_relaxed);
+        if (dropped > 0) {
+            char text[64];
+            int length = snprintf(text, sizeof(text), "Dropped %lu log records", dropped);
+            append_line(time(NULL), LOG_LEVEL_WARN, text, length);
+        }
+    }
+    write_batch();
+    pthread_mutex_unlock(&drain_lock);
+}
+
+static void wake_writer(void) {
+    pthread_mutex_lock(&wake_lock);
+    writer_wake_pending = true;
+    pthread_cond_signal(&wake_cond);
+    pthread_mutex_unlock(&wake_lock);
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    for (;;) {
+        drain_rings();
+
+        pthread_mutex_lock(&wake_lock);
+        if (writer_stopping) {
+            pthread_mutex_unlock(&wake_lock);
+            break;
+        }
+        if (!writer_wake_pending) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += LOG_IDLE_WAIT_MS * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&wake_cond, &wake_lock, &deadline);
+        }
+        writer_wake_pending = false;
+        pthread_mutex_unlock(&wake_lock);
+    }
+
+    drain_rings();
+    return NULL;
+}
+
+static void release_ring(void *ring) {
+    atomic_store_explicit(&((LogRing *)ring)->claimed, false, memory_order_release);
 }
 
-void log_message(const char *level, const char *format, ...) {
-    if (!level || !format) return;
+// Holding drain_lock keeps the writer out of localtime_r, whose lock a
+// child would otherwise inherit taken
+static void lock_for_fork(void) {
+    pthread_mutex_lock(&drain_lock);
+}
+
+static void unlock_after_fork(void) {
+    pthread_mutex_unlock(&drain_lock);
+}
+
+// The forking thread keeps its ring; records the parent still owes are its to write
+static void reset_after_fork(void) {
+    pthread_mutex_init(&start_lock, NULL);
+    pthread_mutex_init(&wake_lock, NULL);
+    pthread_mutex_init(&drain_lock, NULL);
+    pthread_cond_init(&wake_cond, NULL);
+    atomic_store(&writer_running, false);
+    writer_stopping = false;
+    writer_wake_pending = false;
+    batch_length = 0;
+
+    for (LogRing *ring = atomic_load(&rings); ring; ring = ring->next) {
+        atomic_store(&ring->tail, atomic_load(&ring->head));
+        atomic_store(&ring->dropped, 0);
+        atomic_store(&ring->claimed, ring == thread_ring);
+    }
+}
+
+static void init_logger_once(void) {
+    pthread_key_create(&ring_key, release_ring);
+    pthread_atfork(lock_for_fork, unlock_after_fork, reset_after_fork);
+    atexit(logger_shutdown);
+}
+
+static void start_writer(void) {
+    pthread_mutex_lock(&start_lock);
+    if (!logger_stopped && !atomic_load_explicit(&writer_running, memory_order_acquire)) {
+        // Signals stay with the threads that handle them
+        sigset_t all, previous;
+        sigfillset(&all);
+        pthread_sigmask(SIG_SETMASK, &all, &previous);
+        if (pthread_create(&writer_thread, NULL, writer_main, NULL) == 0) {
+            atomic_store_explicit(&writer_running, true, memory_order_release);
+        }
+        pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    }
+    pthread_mutex_unlock(&start_lock);
+}
+
+static LogRing *attach_ring(void) {
+    pthread_once(&logger_once, init_logger_once);
+    if (!atomic_load_explicit(&writer_running, memory_order_acquire)) {
+        start_writer();
+    }
+
+    if (thread_ring) return thread_ring;
+
+    LogRing *ring = NULL;
+    for (LogRing *candidate = atomic_load_explicit(&rings, memory_order_acquire); candidate; candidate = candidate->next) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong_explicit(&candidate->claimed, &expected, true,
+                                                    memory_order_acquire, memory_order_relaxed)) {
+            ring = candidate;
+            break;
+        }
+    }
 
-    char *timestamp = get_timestamp();
+    if (!ring) {
+        ring = aligned_alloc(64, sizeof(LogRing));
+        if (!ring) return NULL;
+        atomic_init(&ring->head, 0);
+        atomic_init(&ring->tail, 0);
+        atomic_init(&ring->claimed, true);
+        atomic_init(&ring->dropped, 0);
+        ring->next = atomic_load_explicit(&rings, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&rings, &ring->next, ring,
+                                                      memory_order_release, memory_order_relaxed)) {
+        }
+    }
+
+    pthread_setspecific(ring_key, ring);
+    thread_ring = ring;
+    return ring;
+}
+
+void log_record(LogLevel level, const char *format, ...) {
+    // A forked child restarts the writer on its first record
+    LogRing *ring = thread_ring;
+    if (!ring || !atomic_load_explicit(&writer_running, memory_order_relaxed)) {
+        ring = attach_ring();
+    }
+    if (!ring || !format) return;
+
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail >= LOG_RING_SLOTS) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    LogRecord *record = &ring->records[head % LOG_RING_SLOTS];
+    record->time = time(NULL);
+    record->level = level;
 
     va_list args;
     va_start(args, format);
+    int length = vsnprintf(record->text, sizeof(record->text), format, args);
+    va_end(args);
+    if (length < 0) length = 0;
+    if (length >= (int)sizeof(record->text)) length = (int)sizeof(record->text) - 1;
+    record->length = length;
 
-    printf("[%s] [%s] ", timestamp, level);
-    vprintf(format, args);
-    printf("\n");
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
 
-    va_end(args);
+    // The writer polls; only a filling ring is worth a wakeup
+    if (head + 1 - tail == LOG_RING_SLOTS / 2) {
+        wake_writer();
+    }
+}
+
+void logger_flush(void) {
+    drain_rings();
+}
+
+void logger_shutdown(void) {
+    pthread_mutex_lock(&start_lock);
+    logger_stopped = true;
+    if (atomic_load_explicit(&writer_running, memory_order_acquire)) {
+        pthread_mutex_lock(&wake_lock);
+        writer_stopping = true;
+        pthread_cond_signal(&wake_cond);
+        pthread_mutex_unlock(&wake_lock);
+
+        pthread_join(writer_thread, NULL);
+        atomic_store_explicit(&writer_running, false, memory_order_release);
+        writer_stopping = false;
+    }
+    pthread_mutex_unlock(&start_lock);
+    drain_rings();
 }
 
 char *generate_uuid(void) {
-    char *uuid = malloc(37);
+    char *uuid = engine_malloc(37);
     if (!uuid) return NULL;
 
     snprintf(uuid, 37, "%04x%04x-%04x-%04x-%04x-%04x%04x%04x",
@@ -41,4 +330,4 @@ char *generate_uuid(void) {
              rand() % 0xFFFF, rand() % 0xFFFF, rand() % 0xFFFF);
 
     return uuid;
-}
\ No newline at end of file
+}
@@ -3,175 +3,249 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
-static PatternCache cache;
+#define READ_ATTEMPTS 3
 
-void init_pattern_cache(void) {
-    memset(&cache, 0, sizeof(PatternCache));
-    cache.next_slot = 0;
-    cache.total_hits = 0;
-    cache.total_misses = 0;
-    
-    log_message("INFO", "Pattern cache initialized (size: %d entries)", CACHE_SIZE);
+static PatternCache *cache;
+
+static void normalize_query(const char *query, char *out) {
+    size_t i = 0;
+    for (; query[i] && i < CACHE_QUERY_MAX - 1; i++) {
+        char c = query[i];
+        out[i] = (c >= 'A' && c <= 'Z') ? (char)(c + 32) : c;
+    }
+    out[i] = '\0';
 }
 
-ResponsePattern *cache_lookup(const char *query, const char *role, const char *language) {
-    if (!query || !role || !language) return NULL;
-    
-    char normalized_query[256];
-    strncpy(normalized_query, query, sizeof(normalized_query) - 1);
-    normalized_query[sizeof(normalized_query) - 1] = '\0';
-    
-    for (int i = 0; normalized_query[i]; i++) {
-        if (normalized_query[i] >= 'A' && normalized_query[i] <= 'Z') {
-            normalized_query[i] = normalized_query[i] + 32;
+static uint64_t hash_key(const char *query, const char *role, const char *language, uint64_t scope) {
+    uint64_t hash = (1469598103934665603ULL ^ scope) * 1099511628211ULL;
+    const char *parts[3] = {query, role, language};
+    for (int part = 0; part < 3; part++) {
+        for (const unsigned char *ptr = (const unsigned char *)parts[part]; *ptr; ptr++) {
+            hash ^= *ptr;
+            hash *= 1099511628211ULL;
         }
+        hash ^= 0xff;
+        hash *= 1099511628211ULL;
     }
-    
-    for (int i = 0; i < CACHE_SIZE; i++) {
-        CacheEntry *entry = &cache.entries[i];
-        
-        if (entry->query && 
-            strcmp(entry->query, normalized_query) == 0 &&
-            strcmp(entry->role, role) == 0 &&
-            strcmp(entry->language, language) == 0) {
-            
-            entry->hit_count++;
-            entry->timestamp = time(NULL);
-            cache.total_hits++;
-            
-            log_message("INFO", "Cache HIT: '%s' (hits: %d, cache rate: %.1f%%)", 
-                       query, entry->hit_count,
-                       (cache.total_hits * 100.0f) / (cache.total_hits + cache.total_misses));
-            
-            return entry->pattern;
-        }
+    return hash ? hash : 1;
+}
+
+// One allocation holds the pattern, its keyword list and the keyword text, so
+// freeing the pattern itself releases them too
+static ResponsePattern *copy_entry(const CacheEntry *entry) {
+    size_t keyword_length = strlen(entry->keyword);
+    ResponsePattern *copy = engine_malloc(sizeof(ResponsePattern) + sizeof(char *) + keyword_length + 1);
+    if (!copy) return NULL;
+
+    char **keywords = (char **)(copy + 1);
+    char *keyword = (char *)(keywords + 1);
+    memcpy(keyword, entry->keyword, keyword_length + 1);
+    keywords[0] = keyword;
+
+    copy->keywords = keyword_length ? keywords : NULL;
+    copy->keyword_count = keyword_length ? 1 : 0;
+    copy->user_role = NULL;
+    copy->language = NULL;
+    copy->confidence_threshold = entry->confidence_threshold;
+    copy->response = engine_strdup(entry->response);
+    copy->category = engine_strdup(entry->category);
+    if (!copy->response || !copy->category) {
+        engine_free(copy->response);
+        engine_free(copy->category);
+        engine_free(copy);
+        return NULL;
     }
-    
-    cache.total_misses++;
-    log_message("INFO", "Cache MISS: '%s' (cache rate: %.1f%%)", 
-               query,
-               (cache.total_hits * 100.0f) / (cache.total_hits + cache.total_misses));
-    
-    return NULL;
+    return copy;
 }
 
-void cache_store(const char *query, const char *role, const char *language, ResponsePattern *pattern) {
-    if (!query || !role || !language || !pattern) return;
-    
-    char normalized_query[256];
-    strncpy(normalized_query, query, sizeof(normalized_query) - 1);
-    normalized_query[sizeof(normalized_query) - 1] = '\0';
-    
-    for (int i = 0; normalized_query[i]; i++) {
-        if (normalized_query[i] >= 'A' && normalized_query[i] <= 'Z') {
-            normalized_query[i] = normalized_query[i] + 32;
+void init_pattern_cache(void) {
+    if (cache) return;
+
+    // memfd keeps the segment anonymous; an anonymous shared mapping is the fallback
+    void *memory = MAP_FAILED;
+    int fd = memfd_create("bricllm-cache", MFD_CLOEXEC);
+    if (fd >= 0) {
+        if (ftruncate(fd, sizeof(PatternCache)) == 0) {
+            memory = mmap(NULL, sizeof(PatternCache), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
         }
+        close(fd);
     }
-    
-    for (int i = 0; i < CACHE_SIZE; i++) {
-        if (cache.entries[i].query && 
-            strcmp(cache.entries[i].query, normalized_query) == 0) {
-            return;
-        }
+    if (memory == MAP_FAILED) {
+        memory = mmap(NULL, sizeof(PatternCache), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
     }
-    
-    int slot = cache.next_slot;
-    time_t oldest_time = time(NULL);
-    int oldest_slot = cache.next_slot;
-    
-    for (int i = 0; i < CACHE_SIZE; i++) {
-        if (!cache.entries[i].query) {
-            slot = i;
-            break;
+    if (memory == MAP_FAILED) {
+        LOG_ERROR("Failed to map pattern cache");
+        exit(1);
+    }
+    cache = memory;
+
+    LOG_INFO("Pattern cache initialized (%d shared slots)", CACHE_SLOTS);
+}
+
+// Copies a consistent snapshot of entry into out; false if a writer kept it busy
+static bool read_entry(const CacheEntry *entry, CacheEntry *out) {
+    for (int attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+        uint32_t before = atomic_load_explicit(&entry->sequence, memory_order_acquire);
+        if (before & 1) continue;
+
+        out->scope = entry->scope;
+        out->confidence_threshold = entry->confidence_threshold;
+        memcpy(out->query, entry->query, sizeof(out->query));
+        memcpy(out->role, entry->role, sizeof(out->role));
+        memcpy(out->language, entry->language, sizeof(out->language));
+        memcpy(out->response, entry->response, sizeof(out->response));
+        memcpy(out->category, entry->category, sizeof(out->category));
+        memcpy(out->keyword, entry->keyword, sizeof(out->keyword));
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&entry->sequence, memory_order_relaxed) == before) {
+            return true;
         }
-        if (cache.entries[i].timestamp < oldest_time) {
-            oldest_time = cache.entries[i].timestamp;
-            oldest_slot = i;
+    }
+    return false;
+}
+
+ResponsePattern *cache_lookup(const char *query, const char *role, const char *language, uint64_t scope) {
+    if (!cache || !query || !role || !language) return NULL;
+    // Keys are not truncated: long queries sharing a prefix must not share an answer
+    if (strnlen(query, CACHE_QUERY_MAX) == CACHE_QUERY_MAX) return NULL;
+
+    char normalized_query[CACHE_QUERY_MAX];
+    normalize_query(query, normalized_query);
+    uint64_t hash = hash_key(normalized_query, role, language, scope);
+
+    for (int i = 0; i < CACHE_PROBE; i++) {
+        CacheEntry *entry = &cache->entries[(hash + (uint64_t)i) & (CACHE_SLOTS - 1)];
+        if (atomic_load_explicit(&entry->key_hash, memory_order_relaxed) != hash) continue;
+
+        CacheEntry snapshot;
+        if (!read_entry(entry, &snapshot)) continue;
+        if (snapshot.scope != scope ||
+            strcmp(snapshot.query, normalized_query) != 0 ||
+            strcmp(snapshot.role, role) != 0 ||
+            strcmp(snapshot.language, language) != 0) {
+            continue;
         }
+
+        uint32_t hits = atomic_fetch_add_explicit(&entry->hit_count, 1, memory_order_relaxed) + 1;
+        atomic_store_explicit(&entry->last_used, (int64_t)time(NULL), memory_order_relaxed);
+        atomic_fetch_add_explicit(&cache->total_hits, 1, memory_order_relaxed);
+        LOG_DEBUG("Cache HIT: '%s' (hits: %u)", query, hits);
+        return copy_entry(&snapshot);
     }
-    
-    if (cache.entries[slot].query) {
-        slot = oldest_slot;
+
+    atomic_fetch_add_explicit(&cache->total_misses, 1, memory_order_relaxed);
+    LOG_DEBUG("Cache MISS: '%s'", query);
+    return NULL;
+}
+
+void cache_store(const char *query, const char *role, const char *language, uint64_t scope,
+                 ResponsePattern *pattern) {
+    if (!cache || !query || !role || !language || !pattern) return;
+
+    const char *keyword = pattern->keywords && pattern->keyword_count > 0 ? pattern->keywords[0] : "";
+    // Text that would not fit is not cached rather than cached truncated
+    if (strnlen(query, CACHE_QUERY_MAX) == CACHE_QUERY_MAX ||
+        strlen(pattern->response) >= CACHE_RESPONSE_MAX ||
+        strlen(pattern->category) >= CACHE_CATEGORY_MAX ||
+        strlen(keyword) >= CACHE_KEYWORD_MAX ||
+        strlen(role) >= sizeof(cache->entries[0].role) ||
+        strlen(language) >= sizeof(cache->entries[0].language)) {
+        return;
     }
-    
-    CacheEntry *entry = &cache.entries[slot];
-    if (entry->query) {
-        free(entry->query);
-        free(entry->role);
-        free(entry->language);
-        if (entry->pattern) {
-            free(entry->pattern->response);
-            free(entry->pattern->category);
-            free(entry->pattern);
+
+    char normalized_query[CACHE_QUERY_MAX];
+    normalize_query(query, normalized_query);
+    uint64_t hash = hash_key(normalized_query, role, language, scope);
+
+    // Reuse an empty slot in the probe window, otherwise the least recently used
+    CacheEntry *victim = NULL;
+    int64_t oldest = INT64_MAX;
+    for (int i = 0; i < CACHE_PROBE; i++) {
+        CacheEntry *entry = &cache->entries[(hash + (uint64_t)i) & (CACHE_SLOTS - 1)];
+        uint64_t entry_hash = atomic_load_explicit(&entry->key_hash, memory_order_relaxed);
+        if (entry_hash == hash) return;
+        if (entry_hash == 0) {
+            victim = entry;
+            break;
+        }
+        int64_t used = atomic_load_explicit(&entry->last_used, memory_order_relaxed);
+        if (used < oldest) {
+            oldest = used;
+            victim = entry;
         }
     }
-    
-    entry->query = strdup(normalized_query);
-    entry->role = strdup(role);
-    entry->language = strdup(language);
-    
-    entry->pattern = malloc(sizeof(ResponsePattern));
-    if (entry->pattern) {
-        entry->pattern->response = strdup(pattern->response);
-        entry->pattern->category = strdup(pattern->category);
-        entry->pattern->keywords = pattern->keywords;
-        entry->pattern->keyword_count = pattern->keyword_count;
-        entry->pattern->user_role = pattern->user_role;
-        entry->pattern->language = pattern->language;
-        entry->pattern->confidence_threshold = pattern->confidence_threshold;
+
+    // Another writer owns the slot; losing this store only costs a later miss
+    uint32_t sequence = atomic_load_explicit(&victim->sequence, memory_order_relaxed);
+    if ((sequence & 1) ||
+        !atomic_compare_exchange_strong_explicit(&victim->sequence, &sequence, sequence + 1,
+                                                 memory_order_acquire, memory_order_relaxed)) {
+        return;
     }
-    
-    entry->timestamp = time(NULL);
-    entry->hit_count = 0;
-    
-    log_message("INFO", "Cache STORE: '%s' in slot %d", query, slot);
-    
-    cache.next_slot = (cache.next_slot + 1) % CACHE_SIZE;
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_explicit(&victim->key_hash, hash, memory_order_relaxed);
+    victim->scope = scope;
+    victim->confidence_threshold = pattern->confidence_threshold;
+    snprintf(victim->query, sizeof(victim->query), "%s", normalized_query);
+    snprintf(victim->role, sizeof(victim->role), "%s", role);
+    snprintf(victim->language, sizeof(victim->language), "%s", language);
+    snprintf(victim->response, sizeof(victim->response), "%s", pattern->response);
+    snprintf(victim->category, sizeof(victim->category), "%s", pattern->category);
+    snprintf(victim->keyword, sizeof(victim->keyword), "%s", keyword);
+    atomic_store_explicit(&victim->hit_count, 0, memory_order_relaxed);
+    atomic_store_explicit(&victim->last_used, (int64_t)time(NULL), memory_order_relaxed);
+
+    atomic_store_explicit(&victim->sequence, sequence + 2, memory_order_release);
+    LOG_DEBUG("Cache STORE: '%s' in slot %ld", query, (long)(victim - cache->entries));
 }
 
 void cache_stats(void) {
+    if (!cache) return;
+
     int occupied = 0;
-    int total_hits_sum = 0;
-    
-    for (int i = 0; i < CACHE_SIZE; i++) {
-        if (cache.entries[i].query) {
+    unsigned long total_hits_sum = 0;
+    for (int i = 0; i < CACHE_SLOTS; i++) {
+        if (atomic_load_explicit(&cache->entries[i].key_hash, memory_order_relaxed)) {
             occupied++;
-            total_hits_sum += cache.entries[i].hit_count;
+            total_hits_sum += atomic_load_explicit(&cache->entries[i].hit_count, memory_order_relaxed);
         }
     }
-    
-    float hit_rate = (cache.total_hits + cache.total_misses > 0) 
-        ? (cache.total_hits * 100.0f) / (cache.total_hits + cache.total_misses)
-        : 0.0f;
-    
+
+    unsigned long hits = (unsigned long)atomic_load(&cache->total_hits);
+    unsigned long misses = (unsigned long)atomic_load(&cache->total_misses);
+    float hit_rate = hits + misses > 0 ? (hits * 100.0f) / (hits + misses) : 0.0f;
+
     printf("\n=== Pattern Cache Statistics ===\n");
-    printf("Cache size: %d entries\n", CACHE_SIZE);
+    printf("Cache size: %d entries (shared)\n", CACHE_SLOTS);
     printf("Occupied slots: %d\n", occupied);
-    printf("Total lookups: %d\n", cache.total_hits + cache.total_misses);
-    printf("Cache hits: %d\n", cache.total_hits);
-    printf("Cache misses: %d\n", cache.total_misses);
+    printf("Total lookups: %lu\n", hits + misses);
+    printf("Cache hits: %lu\n", hits);
+    printf("Cache misses: %lu\n", misses);
     printf("Hit rate: %.1f%%\n", hit_rate);
-    printf("Average hits per entry: %.1f\n", 
+    printf("Average hits per entry: %.1f\n",
            occupied > 0 ? (float)total_hits_sum / occupied : 0.0f);
     printf("\n");
 }
 
+void cache_counters(uint64_t *hits, uint64_t *misses) {
+    *hits = cache ? atomic_load_explicit(&cache->total_hits, memory_order_relaxed) : 0;
+    *misses = cache ? atomic_load_explicit(&cache->total_misses, memory_order_relaxed) : 0;
+}
+
 void cleanup_cache(void) {
-    for (int i = 0; i < CACHE_SIZE; i++) {
-        CacheEntry *entry = &cache.entries[i];
-        if (entry->query) {
-            free(entry->query);
-            free(entry->role);
-            free(entry->language);
-            if (entry->pattern) {
-                free(entry->pattern->response);
-                free(entry->pattern->category);
-                free(entry->pattern);
-            }
-        }
-    }
-    
-    log_message("INFO", "Cache cleanup complete. Final hit rate: %.1f%%",
-               (cache.total_hits * 100.0f) / (cache.total_hits + cache.total_misses));
+    if (!cache) return;
+
+    unsigned long hits = (unsigned long)atomic_load(&cache->total_hits);
+    unsigned long misses = (unsigned long)atomic_load(&cache->total_misses);
+    LOG_INFO("Cache cleanup complete. Final hit rate: %.1f%%",
+             hits + misses > 0 ? (hits * 100.0f) / (hits + misses) : 0.0f);
+
+    munmap(cache, sizeof(PatternCache));
+    cache = NULL;
 }
@@ -0,0 +1,31 @@
+#include "../../include/tokenizer.h"
+#include <ctype.h>
+#include <string.h>
+
+static bool word_char(char c) {
+    return isalnum((unsigned char)c);
+}
+
+void tokenize_message(const char *message, TokenStream *stream) {
+    stream->count = 0;
+    if (!message) return;
+
+    const char *c = message;
+    while (*c && stream->count < MAX_MESSAGE_TOKENS) {
+        while (*c && !word_char(*c)) c++;
+        if (!*c) break;
+
+        const char *start = c;
+        while (word_char(*c) || (*c == '\'' && word_char(c[1]))) c++;
+        stream->tokens[stream->count].text = start;
+        stream->tokens[stream->count].length = (int)(c - start);
+        stream->count++;
+    }
+}
+
+bool token_is(const Token *token, const char *word) {
+    for (int i = 0; i < token->length; i++) {
+        if (tolower((unsigned char)token->text[i]) != word[i]) return false;
+    }
+    return word[token->length] == '\0';
+}
@@ -0,0 +1,436 @@
+#include "../../include/worker_pool.h"
+#include "../../include/bricllm.h"
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <signal.h>
+
+#define DEQUE_INITIAL_SIZE 256
+#define INJECTOR_BATCH 16
+#define STRAND_COUNT 1024
+#define STRAND_BUDGET 32
+
+// Chase-Lev work-stealing deque (Le et al., "Correct and Efficient
+// Work-Stealing for Weak Memory Models"). The owner pushes and takes at the
+// bottom; thieves steal from the top.
+typedef struct DequeArray {
+    long size;
+    struct DequeArray *retired;
+    _Atomic(Task *) slots[];
+} DequeArray;
+
+typedef struct {
+    atomic_long top;
+    atomic_long bottom;
+    _Atomic(DequeArray *) array;
+} Deque;
+
+typedef struct {
+    pthread_mutex_t lock;
+    Task *head;
+    Task *tail;
+    bool scheduled;
+    Task runner;
+    WorkerPool *pool;
+} Strand;
+
+typedef struct {
+    WorkerPool *pool;
+    int index;
+    Deque deque;
+    unsigned int seed;
+    pthread_t thread;
+} Worker;
+
+struct WorkerPool {
+    Worker *workers;
+    int worker_count;
+
+    // Tasks from threads outside the pool
+    pthread_mutex_t injector_lock;
+    Task *injector_head;
+    Task *injector_tail;
+    atomic_long injected;
+
+    pthread_mutex_t sleep_lock;
+    pthread_cond_t wake;
+    atomic_int sleeping;
+    atomic_bool stopping;
+
+    Strand strands[STRAND_COUNT];
+};
+
+static _Thread_local Worker *current_worker = NULL;
+
+#define STEAL_ABORT ((Task *)1)
+
+static DequeArray *deque_array_create(long size) {
+    DequeArray *array = malloc(sizeof(DequeArray) + (size_t)size * sizeof(_Atomic(Task *)));
+    if (!array) return NULL;
+    array->size = size;
+    array->retired = NULL;
+    return array;
+}
+
+static bool deque_init(Deque *deque) {
+    DequeArray *array = deque_array_create(DEQUE_INITIAL_SIZE);
+    if (!array) return false;
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    atomic_init(&deque->array, array);
+    return true;
+}
+
+static void deque_destroy(Deque *deque) {
+    DequeArray *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    while (array) {
+        DequeArray *retired = array->retired;
+        free(array);
+        array = retired;
+    }
+}
+
+// Thieves may still be reading the old array, so it is kept until destroy.
+static DequeArray *deque_grow(Deque *deque, DequeArray *old, long top, long bottom) {
+    DequeArray *array = deque_array_create(old->size * 2);
+    if (!array) return NULL;
+
+    for (long i = top; i < bottom; i++) {
+        Task *task = atomic_load_explicit(&old->slots[i % old->size], memory_order_relaxed);
+        atomic_store_explicit(&array->slots[i % array->size], task, memory_order_relaxed);
+    }
+    array->retired = old;
+    atomic_store_explicit(&deque->array, array, memory_order_release);
+    return array;
+}
+
+static bool deque_push(Deque *deque, Task *task) {
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    DequeArray *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+
+    if (bottom - top > array->size - 1) {
+        array = deque_grow(deque, array, top, bottom);
+        if (!array) return false;
+    }
+
+    atomic_store_explicit(&array->slots[bottom % array->size], task, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return true;
+}
+
+static Task *deque_take(Deque *deque) {
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    DequeArray *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if (top > bottom) {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    Task *task = atomic_load_explicit(&array->slots[bottom % array->size], memory_order_relaxed);
+    if (top == bottom) {
+        // Last element: race the thieves for it
+        if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                     memory_order_seq_cst, memory_order_relaxed)) {
+            task = NULL;
+        }
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+static Task *deque_steal(Deque *deque) {
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+    if (top >= bottom) return NULL;
+
+    DequeArray *array = atomic_load_explicit(&deque->array, memory_order_acquire);
+    Task *task = atomic_load_explicit(&array->slots[top % array->size], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed)) {
+        return STEAL_ABORT;
+    }
+    return task;
+}
+
+static bool deque_empty(Deque *deque) {
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    return top >= bottom;
+}
+
+static void wake_one(WorkerPool *pool) {
+    // Orders the caller's publish before the sleeper check (see worker_main)
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&pool->sleeping) > 0) {
+        pthread_mutex_lock(&pool->sleep_lock);
+        pthread_cond_signal(&pool->wake);
+        pthread_mutex_unlock(&pool->sleep_lock);
+    }
+}
+
+static void inject(WorkerPool *pool, Task *task) {
+    task->next = NULL;
+    pthread_mutex_lock(&pool->injector_lock);
+    if (pool->injector_tail) {
+        pool->injector_tail->next = task;
+    } else {
+        pool->injector_head = task;
+    }
+    pool->injector_tail = task;
+    atomic_fetch_add(&pool->injected, 1);
+    pthread_mutex_unlock(&pool->injector_lock);
+
+    wake_one(pool);
+}
+
+void worker_pool_submit(WorkerPool *pool, Task *task) {
+    Worker *worker = current_worker;
+    if (worker && worker->pool == pool && deque_push(&worker->deque, task)) {
+        wake_one(pool);
+        return;
+    }
+    inject(pool, task);
+}
+
+// Moves a batch from the injector into the worker's deque and returns one task.
+static Task *take_injected(Worker *worker) {
+    WorkerPool *pool = worker->pool;
+    if (atomic_load(&pool->injected) == 0) return NULL;
+
+    pthread_mutex_lock(&pool->injector_lock);
+    Task *first = pool->injector_head;
+    Task *task = first;
+    long taken = 0;
+    while (task && taken < INJECTOR_BATCH) {
+        task = task->next;
+        taken++;
+    }
+    pool->injector_head = task;
+    if (!task) pool->injector_tail = NULL;
+    atomic_fetch_sub(&pool->injected, taken);
+    pthread_mutex_unlock(&pool->injector_lock);
+
+    if (taken == 0) return NULL;
+
+    // The rest become stealable by idle workers
+    Task *extra = first->next;
+    for (long i = 1; i < taken; i++) {
+        Task *next = extra->next;
+        if (!deque_push(&worker->deque, extra)) {
+            inject(pool, extra);
+        }
+        extra = next;
+    }
+    if (taken > 1) wake_one(pool);
+    return first;
+}
+
+static Task *steal_work(Worker *worker) {
+    WorkerPool *pool = worker->pool;
+    int count = pool->worker_count;
+    int start = (int)(rand_r(&worker->seed) % (unsigned int)count);
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        for (int i = 0; i < count; i++) {
+            Worker *victim = &pool->workers[(start + i) % count];
+            if (victim == worker) continue;
+
+            Task *task = deque_steal(&victim->deque);
+            if (task && task != STEAL_ABORT) return task;
+        }
+    }
+    return NULL;
+}
+
+static bool work_available(WorkerPool *pool) {
+    if (atomic_load(&pool->injected) > 0) return true;
+    for (int i = 0; i < pool->worker_count; i++) {
+        if (!deque_empty(&pool->workers[i].deque)) return true;
+    }
+    return false;
+}
+
+static Task *find_task(Worker *worker) {
+    Task *task = deque_take(&worker->deque);
+    if (!task) task = take_injected(worker);
+    if (!task) task = steal_work(worker);
+    return task;
+}
+
+static void *worker_main(void *arg) {
+    Worker *worker = arg;
+    WorkerPool *pool = worker->pool;
+    current_worker = worker;
+
+    while (!atomic_load(&pool->stopping)) {
+        Task *task = find_task(worker);
+        if (task) {
+            task->run(task);
+            continue;
+        }
+
+        // Announce the sleep before the final check so a submitter either
+        // sees us sleeping or we see its task.
+        pthread_mutex_lock(&pool->sleep_lock);
+        atomic_fetch_add(&pool->sleeping, 1);
+        if (!work_available(pool) && !atomic_load(&pool->stopping)) {
+            pthread_cond_wait(&pool->wake, &pool->sleep_lock);
+        }
+        atomic_fetch_sub(&pool->sleeping, 1);
+        pthread_mutex_unlock(&pool->sleep_lock);
+    }
+
+    return NULL;
+}
+
+static void run_strand(Task *task) {
+    Strand *strand = (Strand *)((char *)task - offsetof(Strand, runner));
+
+    for (int budget = 0; budget < STRAND_BUDGET; budget++) {
+        pthread_mutex_lock(&strand->lock);
+        Task *next = strand->head;
+        if (!next) {
+            strand->scheduled = false;
+            pthread_mutex_unlock(&strand->lock);
+            return;
+        }
+        strand->head = next->next;
+        if (!strand->head) strand->tail = NULL;
+        pthread_mutex_unlock(&strand->lock);
+
+        next->run(next);
+    }
+
+    // Yield so one chatty session cannot monopolise a worker
+    worker_pool_submit(strand->pool, &strand->runner);
+}
+
+void worker_pool_submit_keyed(WorkerPool *pool, uint64_t key, Task *task) {
+    Strand *strand = &pool->strands[key % STRAND_COUNT];
+    task->next = NULL;
+
+    pthread_mutex_lock(&strand->lock);
+    if (strand->tail) {
+        strand->tail->next = task;
+    } else {
+        strand->head = task;
+    }
+    strand->tail = task;
+    bool schedule = !strand->scheduled;
+    strand->scheduled = true;
+    pthread_mutex_unlock(&strand->lock);
+
+    if (schedule) {
+        worker_pool_submit(pool, &strand->runner);
+    }
+}
+
+WorkerPool *worker_pool_create(int thread_count) {
+    if (thread_count <= 0) return NULL;
+
+    WorkerPool *pool = calloc(1, sizeof(WorkerPool));
+    if (!pool) return NULL;
+
+    pool->workers = calloc((size_t)thread_count, sizeof(Worker));
+    if (!pool->workers) {
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->injector_lock, NULL);
+    pthread_mutex_init(&pool->sleep_lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    atomic_init(&pool->injected, 0);
+    atomic_init(&pool->sleeping, 0);
+    atomic_init(&pool->stopping, false);
+
+    for (int i = 0; i < STRAND_COUNT; i++) {
+        pthread_mutex_init(&pool->strands[i].lock, NULL);
+        pool->strands[i].runner.run = run_strand;
+        pool->strands[i].pool = pool;
+    }
+
+    for (int i = 0; i < thread_count; i++) {
+        Worker *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i;
+        worker->seed = (unsigned int)(i * 2654435761u + 1);
+        if (!deque_init(&worker->deque)) {
+            break;
+        }
+        pool->worker_count++;
+    }
+
+    // Workers inherit a fully blocked mask so process signals reach the IO thread
+    sigset_t all_signals, previous;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &previous);
+
+    // Workers steal from every deque, so all must exist before any thread starts
+    int started = 0;
+    for (int i = 0; i < pool->worker_count; i++) {
+        if (pthread_create(&pool->workers[i].thread, NULL, worker_main, &pool->workers[i]) != 0) {
+            break;
+        }
+        started++;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+    if (started < pool->worker_count) {
+        LOG_ERROR("Started only %d of %d worker threads", started, thread_count);
+        atomic_store(&pool->stopping, true);
+        pthread_mutex_lock(&pool->sleep_lock);
+        pthread_cond_broadcast(&pool->wake);
+        pthread_mutex_unlock(&pool->sleep_lock);
+        for (int i = 0; i < started; i++) {
+            pthread_join(pool->workers[i].thread, NULL);
+        }
+        for (int i = 0; i < pool->worker_count; i++) {
+            deque_destroy(&pool->workers[i].deque);
+        }
+        free(pool->workers);
+        free(pool);
+        return NULL;
+    }
+
+    LOG_INFO("Worker pool started with %d threads", pool->worker_count);
+    return pool;
+}
+
+int worker_pool_size(const WorkerPool *pool) {
+    return pool ? pool->worker_count : 0;
+}
+
+void worker_pool_destroy(WorkerPool *pool) {
+    if (!pool) return;
+
+    atomic_store(&pool->stopping, true);
+    pthread_mutex_lock(&pool->sleep_lock);
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->sleep_lock);
+
+    for (int i = 0; i < pool->worker_count; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+        deque_destroy(&pool->workers[i].deque);
+    }
+
+    for (int i = 0; i < STRAND_COUNT; i++) {
+        pthread_mutex_destroy(&pool->strands[i].lock);
+    }
+    pthread_mutex_destroy(&pool->injector_lock);
+    pthread_mutex_destroy(&pool->sleep_lock);
+    pthread_cond_destroy(&pool->wake);
+    free(pool->workers);
+    free(pool);
+}
@@ -0,0 +1,215 @@
+// Allocation budgets for the request path. Every case runs once to warm up,
+// then again under the engine allocator's counters, and fails unless it made
+// exactly its budgeted number of allocations. A tracking allocator installed
+// through set_engine_allocator also checks that each case frees everything
+// it allocated.
+//
+// A budget that drops is good news: lower it here in the same change.
+#include "../include/bricllm.h"
+#include "../include/chat_engine.h"
+#include "../include/catalog.h"
+#include "../include/pattern_cache.h"
+#include "../include/conversation_context.h"
+#include "../include/request_handler.h"
+#include "../include/route_types.h"
+#include "../include/tokenizer.h"
+#include "../include/json_io.h"
+#include <stdint.h>
+
+typedef struct {
+    int64_t live;       // blocks allocated and not yet released
+} Tracker;
+
+static Tracker tracker;
+
+static void *track_allocate(size_t size, void *context) {
+    void *memory = malloc(size);
+    if (memory) ((Tracker *)context)->live++;
+    return memory;
+}
+
+static void *track_reallocate(void *pointer, size_t size, void *context) {
+    void *memory = realloc(pointer, size);
+    if (memory && !pointer) ((Tracker *)context)->live++;
+    return memory;
+}
+
+static void track_release(void *pointer, void *context) {
+    ((Tracker *)context)->live--;
+    free(pointer);
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(void);
+    uint64_t budget;
+} AllocationCase;
+
+static OutputBuffer json;
+static ConversationContext *context;
+
+static void free_pattern_copy(ResponsePattern *pattern) {
+    if (!pattern) return;
+    engine_free(pattern->response);
+    engine_free(pattern->category);
+    engine_free(pattern);
+}
+
+// Cases bracket the part under budget, leaving out their own set-up
+static AllocationCount measured_start;
+static AllocationCount measured;
+
+static void begin(void) {
+    engine_allocations(&measured_start);
+}
+
+static void end(void) {
+    AllocationCount now;
+    engine_allocations(&now);
+    measured.allocations += now.allocations - measured_start.allocations;
+    measured.bytes += now.bytes - measured_start.bytes;
+}
+
+// A fresh session each time, so no dialog or follow-up state carries over
+static void answer(const char *role, const char *route, const char *message) {
+    ChatSession *session = create_detached_session("alloc_test", role, "en");
+    engine_free(session->context);
+    session->context = engine_strdup(route);
+
+    begin();
+    free_response(process_message(session, message));
+    end();
+    free_session(session);
+}
+
+static void case_tokenize(void) {
+    TokenStream tokens;
+    begin();
+    tokenize_message("the kitchen tap is leaking, can you send someone?", &tokens);
+    end();
+}
+
+static void case_fingerprint(void) {
+    TokenStream tokens;
+    tokenize_message("how do I pay it?", &tokens);
+    begin();
+    context_fingerprint(context, &tokens);
+    end();
+}
+
+static void case_cache_miss(void) {
+    begin();
+    free_pattern_copy(cache_lookup("a question nobody has asked", "tenant", "en", 1));
+    end();
+}
+
+static void case_cache_hit(void) {
+    begin();
+    free_pattern_copy(cache_lookup("How do I pay my rent?", "tenant", "en", 2));
+    end();
+}
+
+static void case_route_lookup(void) {
+    begin();
+    catalog_acquire();
+    find_route_guide("/tenant/requests/42", "tenant");
+    get_navigation_context("/caretaker/tasks", "caretaker");
+    catalog_release();
+    end();
+}
+
+static void case_json_escape(void) {
+    buffer_reset(&json);
+    begin();
+    json_append_string(&json, "Tap \"Payments\", then \\Pay Rent\\.\n");
+    end();
+}
+
+static void case_uncached(void) {
+    // A new wording each run, so the cache never answers
+    static int run;
+    char message[64];
+    snprintf(message, sizeof(message), "where do I pay rent %c", 'a' + run++ % 26);
+    answer("tenant", "/tenant", message);
+}
+
+static void case_cached(void) {
+    answer("tenant", "/tenant", "How do I pay my rent?");
+}
+
+static void case_unmatched(void) {
+    answer("tenant", "/tenant", "what's the weather like today?");
+}
+
+static void case_directions(void) {
+    answer("caretaker", "/caretaker", "how do I get to history");
+}
+
+static void case_request(void) {
+    ChatRequest request;
+    const char *error;
+    const char *body = "{\"message\":\"How do I pay my rent?\",\"role\":\"tenant\",\"route\":\"/tenant\"}";
+    parse_chat_request(body, strlen(body), &request, &error);
+    ChatSession *session = create_detached_session("alloc_test", "tenant", "en");
+    buffer_reset(&json);
+    begin();
+    run_chat_request(session, true, &request, &json);
+    end();
+    free_session(session);
+}
+
+static const AllocationCase cases[] = {
+    {"tokenize_message", case_tokenize, 0},
+    {"context_fingerprint", case_fingerprint, 0},
+    {"cache_lookup miss", case_cache_miss, 0},
+    {"cache_lookup hit", case_cache_hit, 3},
+    {"route lookup", case_route_lookup, 0},
+    {"json_append_string", case_json_escape, 0},
+    {"message uncached", case_uncached, 18},
+    {"message cached", case_cached, 10},
+    {"message unmatched", case_unmatched, 10},
+    {"message directions", case_directions, 16},
+    {"run_chat_request", case_request, 11},
+};
+
+int main(void) {
+    log_runtime_level = LOG_LEVEL_OFF;
+    EngineAllocator allocator = {track_allocate, track_reallocate, track_release, &tracker};
+    set_engine_allocator(&allocator);
+
+    init_chat_engine();
+    init_route_system();
+    context = create_conversation_context();
+    update_context(context, "payment", "the Payments section", "pay rent");
+    buffer_init(&json);
+    buffer_reserve(&json, 4096);
+
+    ResponsePattern pattern = {NULL, 0, "Use the Payments page.", "payment", "tenant", "en", 0.8f};
+    cache_store("How do I pay my rent?", "tenant", "en", 2, &pattern);
+
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const AllocationCase *test = &cases[i];
+        test->run();
+
+        int64_t live_before = tracker.live;
+        memset(&measured, 0, sizeof(measured));
+        test->run();
+        uint64_t made = measured.allocations;
+        int64_t leaked = tracker.live - live_before;
+
+        bool passed = made == test->budget && leaked == 0;
+        printf("%-4s %-22s %4llu allocations (budget %llu), %llu bytes", passed ? "ok" : "FAIL", test->name,
+               (unsigned long long)made, (unsigned long long)test->budget,
+               (unsigned long long)measured.bytes);
+        if (leaked != 0) printf(", %lld blocks not freed", (long long)leaked);
+        printf("\n");
+        if (!passed) failures++;
+    }
+
+    buffer_free(&json);
+    free_conversation_context(context);
+    printf("%d of %zu allocation budgets met\n", (int)(sizeof(cases) / sizeof(cases[0])) - failures,
+           sizeof(cases) / sizeof(cases[0]));
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,56 @@
+// Checks which search answers a routed match: a page rule that no rule
+// from elsewhere can outscore must answer without looking further, and a
+// message another rule could win must still look and get that rule.
+#include "../include/bricllm.h"
+#include "../include/chat_engine.h"
+#include "../include/route_types.h"
+
+typedef struct {
+    const char *message;
+    const char *role;
+    const char *route;
+    const char *category;
+    bool page_only;             // answered without looking beyond the page's rules
+} PageCase;
+
+static const PageCase cases[] = {
+    {"hello there", "tenant", "/tenant", "greeting", true},
+    {"hello", "caretaker", "/caretaker", "greeting", true},
+    {"How do I pay my rent?", "tenant", "/tenant/payments", "payment", true},
+    {"hello, where do I pay rent", "tenant", "/tenant/payments", "payment", true},
+    {"thanks for the help", "tenant", "/tenant/payments", "thanks", true},
+    {"the kitchen tap is broken", "tenant", "/tenant/requests", "maintenance", true},
+    {"where can I find my requests", "tenant", "/tenant", "navigation", false},
+    {"How do I pay rent?", "tenant", "/tenant", "payment", false},
+    {"tell me a joke please", "tenant", "/tenant/payments", "entertainment", false},
+    {"hello there", "tenant", NULL, "greeting", false},
+};
+
+#define CASE_COUNT (sizeof(cases) / sizeof(cases[0]))
+
+int main(void) {
+    log_runtime_level = LOG_LEVEL_OFF;
+    init_chat_engine();
+    init_route_system();
+
+    int failed = 0;
+    for (size_t i = 0; i < CASE_COUNT; i++) {
+        const PageCase *test = &cases[i];
+        uint64_t page_before, full_before, page_after, full_after;
+        match_counters(&page_before, &full_before);
+        ResponsePattern *pattern = find_matching_pattern(test->message, test->role, "en", test->route);
+        match_counters(&page_after, &full_after);
+
+        const char *category = pattern && pattern->category ? pattern->category : "";
+        bool page_only = page_after == page_before + 1 && full_after == full_before;
+        bool full_search = full_after == full_before + 1 && page_after == page_before;
+        bool ok = strcmp(category, test->category) == 0 && (test->page_only ? page_only : full_search);
+        printf("%-4s %-16s %-30s %-13s %s\n", ok ? "ok" : "FAIL", test->route ? test->route : "-",
+               test->message, category, page_only ? "page rules" : "looked further");
+        if (!ok) failed++;
+        free_pattern(pattern);
+    }
+
+    printf("%zu cases, %d failed\n", CASE_COUNT, failed);
+    return failed == 0 ? 0 : 1;
+}
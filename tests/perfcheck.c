@@ -0,0 +1,442 @@
+// Performance regression gate. Replays a golden corpus of chat requests
+// through the engine, checks each answer's category and text, and compares
+// its median latency and allocation count with a stored baseline.
+//
+// Every query is measured twice: cold, with the pattern cache unmapped so the
+// matcher answers every time, and warm, after the cache has seen it. Each pass
+// sweeps the corpus for several rounds and keeps a query's fastest round
+// median, so a burst of noise on a shared machine has to last all run. A
+// fixed workload that never calls the engine is timed next to every query,
+// and each query counts in units of it, so a machine that is slower for a
+// while, or throughout, does not read as a regression. A run
+// fails when an answer is wrong, when any query allocates more than its
+// baseline, or when the summed medians of either pass grow by more than the
+// threshold. Single queries past the threshold are marked but only fail when
+// they also slow down by more than the noise floor.
+//
+// Latencies are only comparable on one machine: write the baseline with -w
+// on the machine that runs the check, before making the change.
+#include "../include/bricllm.h"
+#include "../include/chat_engine.h"
+#include "../include/pattern_cache.h"
+#include "../include/request_handler.h"
+#include "../include/route_types.h"
+#include "../include/json_io.h"
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_REPEATS 1001
+
+typedef struct {
+    int line;
+    uint32_t hash;              // of the corpus line, so edits invalidate its baseline
+    ChatRequest request;
+    char category[32];
+    char contains[256];         // expected somewhere in the response, may be empty
+    int first_turn;             // index of this conversation's first query
+} GoldenQuery;
+
+typedef struct {
+    uint64_t p50_ns;            // relative times the calibration, in baseline or this run's ns
+    uint64_t allocations;
+    double relative;            // median over the calibration timed next to it
+} PassResult;
+
+typedef enum {
+    PASS_COLD,
+    PASS_WARM,
+    PASS_COUNT
+} Pass;
+
+typedef struct {
+    bool present;
+    uint32_t hash;
+    PassResult pass[PASS_COUNT];
+} Baseline;
+
+typedef struct {
+    const char *corpus_path;
+    const char *baseline_path;
+    double threshold_percent;
+    uint64_t noise_floor_ns;
+    int repeats;
+    int rounds;
+    bool write_baseline;
+} CheckOptions;
+
+static CheckOptions options = {"tests/golden.jsonl", "tests/perf_baseline.txt", 10.0, 2000, 21, 15, false};
+
+static GoldenQuery *queries;
+static int query_count;
+static uint64_t baseline_calibration_ns;
+
+static const char *pass_names[PASS_COUNT] = {"cold", "warm"};
+
+static uint32_t hash_line(const char *line, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)line[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool load_corpus(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    int capacity = 64;
+    queries = malloc((size_t)capacity * sizeof(GoldenQuery));
+    char *line = NULL;
+    size_t line_capacity = 0;
+    ssize_t length;
+    int line_number = 0;
+    bool ok = queries != NULL;
+    while (ok && (length = getline(&line, &line_capacity, file)) >= 0) {
+        line_number++;
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) line[--length] = '\0';
+        if (length == 0) continue;
+        if (query_count == capacity) {
+            capacity *= 2;
+            GoldenQuery *grown = realloc(queries, (size_t)capacity * sizeof(GoldenQuery));
+            if (!grown) {
+                ok = false;
+                break;
+            }
+            queries = grown;
+        }
+
+        GoldenQuery *query = &queries[query_count];
+        memset(query, 0, sizeof(*query));
+        query->line = line_number;
+        query->hash = hash_line(line, (size_t)length);
+        const char *error = NULL;
+        if (!parse_chat_request(line, (size_t)length, &query->request, &error)) {
+            fprintf(stderr, "%s:%d: %s\n", path, line_number, error);
+            ok = false;
+            break;
+        }
+        if (json_get_string(line, (size_t)length, "category", query->category, sizeof(query->category)) != 1 ||
+            json_get_string(line, (size_t)length, "contains", query->contains, sizeof(query->contains)) < 0) {
+            fprintf(stderr, "%s:%d: needs a \"category\" and an optional \"contains\" string\n", path, line_number);
+            ok = false;
+            break;
+        }
+
+        // Earlier lines with the same sessionId are replayed before this one
+        query->first_turn = query_count;
+        if (query->request.session_id[0]) {
+            for (int i = 0; i < query_count; i++) {
+                if (strcmp(queries[i].request.session_id, query->request.session_id) == 0) {
+                    query->first_turn = queries[i].first_turn;
+                    break;
+                }
+            }
+        }
+        query_count++;
+    }
+    free(line);
+    fclose(file);
+    if (ok && query_count == 0) {
+        fprintf(stderr, "%s has no queries\n", path);
+        ok = false;
+    }
+    return ok;
+}
+
+// Lines are "line hash cold_p50_ns warm_p50_ns cold_allocations warm_allocations"
+static bool load_baseline(const char *path, Baseline *baseline) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Cannot open %s: %s (write one with make perfbaseline)\n", path, strerror(errno));
+        return false;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        unsigned long long calibration;
+        if (sscanf(line, "calibration %llu", &calibration) == 1) {
+            baseline_calibration_ns = calibration;
+            continue;
+        }
+        int number;
+        unsigned int hash;
+        unsigned long long cold_ns, warm_ns, cold_allocations, warm_allocations;
+        if (sscanf(line, "%d %x %llu %llu %llu %llu", &number, &hash, &cold_ns, &warm_ns, &cold_allocations,
+                   &warm_allocations) != 6) {
+            continue;
+        }
+        for (int i = 0; i < query_count; i++) {
+            if (queries[i].line != number) continue;
+            Baseline *entry = &baseline[i];
+            entry->present = true;
+            entry->hash = hash;
+            entry->pass[PASS_COLD].p50_ns = cold_ns;
+            entry->pass[PASS_WARM].p50_ns = warm_ns;
+            entry->pass[PASS_COLD].allocations = cold_allocations;
+            entry->pass[PASS_WARM].allocations = warm_allocations;
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static bool write_baseline(const char *path, PassResult (*results)[PASS_COUNT], uint64_t calibration_ns) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Cannot write %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    fprintf(file, "# Written by tests/perfcheck -w for %s; only comparable on the machine that wrote it\n",
+            options.corpus_path);
+    fprintf(file, "calibration %llu\n", (unsigned long long)calibration_ns);
+    fprintf(file, "# line hash cold_p50_ns warm_p50_ns cold_allocations warm_allocations\n");
+    for (int i = 0; i < query_count; i++) {
+        fprintf(file, "%d %08x %llu %llu %llu %llu\n", queries[i].line, queries[i].hash,
+                (unsigned long long)results[i][PASS_COLD].p50_ns, (unsigned long long)results[i][PASS_WARM].p50_ns,
+                (unsigned long long)results[i][PASS_COLD].allocations,
+                (unsigned long long)results[i][PASS_WARM].allocations);
+    }
+    return fclose(file) == 0;
+}
+
+static uint64_t monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+static int compare_u64(const void *left, const void *right) {
+    uint64_t a = *(const uint64_t *)left;
+    uint64_t b = *(const uint64_t *)right;
+    return a < b ? -1 : a > b;
+}
+
+// Median time to hash every corpus line a few times over
+static uint64_t calibrate(void) {
+    static uint64_t samples[MAX_REPEATS];
+    volatile uint32_t sink = 0;
+    for (int run = 0; run <= options.repeats; run++) {
+        uint64_t start = monotonic_ns();
+        for (int pass = 0; pass < 8; pass++) {
+            for (int i = 0; i < query_count; i++) {
+                sink ^= hash_line(queries[i].request.message, strlen(queries[i].request.message));
+            }
+        }
+        if (run > 0) samples[run - 1] = monotonic_ns() - start;
+    }
+    (void)sink;
+    qsort(samples, (size_t)options.repeats, sizeof(uint64_t), compare_u64);
+    return samples[options.repeats / 2];
+}
+
+static ChatSession *open_session(const GoldenQuery *query) {
+    const ChatRequest *request = &query->request;
+    ChatSession *session = create_detached_session("perfcheck", request_role(request), request_language(request));
+    engine_free(session->context);
+    session->context = engine_strdup(request->route[0] ? request->route : default_route_for_role(session->role));
+    return session;
+}
+
+static bool answer_matches(const GoldenQuery *query, const ChatResponse *response) {
+    return response && response->response_type && strcmp(response->response_type, query->category) == 0 &&
+           response->response && strstr(response->response, query->contains) != NULL;
+}
+
+// A fresh session per run, replaying the conversation up to this query.
+// Returns the median of the measured runs.
+static uint64_t measure(const GoldenQuery *query, bool check, bool *correct, uint64_t *allocations) {
+    static uint64_t samples[MAX_REPEATS];
+
+    // The first run warms up and is not counted
+    for (int run = 0; run <= options.repeats; run++) {
+        ChatSession *session = open_session(query);
+        for (const GoldenQuery *turn = &queries[query->first_turn]; turn != query; turn++) {
+            if (strcmp(turn->request.session_id, query->request.session_id) != 0) continue;
+            if (turn->request.route[0]) {
+                engine_free(session->context);
+                session->context = engine_strdup(turn->request.route);
+            }
+            free_response(process_message(session, turn->request.message));
+        }
+        if (query->request.route[0]) {
+            engine_free(session->context);
+            session->context = engine_strdup(query->request.route);
+        }
+
+        AllocationCount before, after;
+        engine_allocations(&before);
+        uint64_t start = monotonic_ns();
+        ChatResponse *response = process_message(session, query->request.message);
+        uint64_t elapsed = monotonic_ns() - start;
+        if (check && run == 1 && !answer_matches(query, response)) {
+            printf("FAIL line %d \"%s\": got %s \"%.72s\"\n", query->line, query->request.message,
+                   response && response->response_type ? response->response_type : "(none)",
+                   response && response->response ? response->response : "");
+            *correct = false;
+        }
+        free_response(response);
+        engine_allocations(&after);
+        free_session(session);
+
+        if (run > 0) {
+            samples[run - 1] = elapsed;
+            *allocations = after.allocations - before.allocations;
+        }
+    }
+
+    qsort(samples, (size_t)options.repeats, sizeof(uint64_t), compare_u64);
+    return samples[options.repeats / 2];
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [-f corpus.jsonl] [-b baseline] [-t percent] [-s ns] [-n repeats] [-r rounds] [-w]\n"
+            "  -f  golden queries, POST /chat bodies with \"category\" and \"contains\" (default: tests/golden.jsonl)\n"
+            "  -b  baseline file (default: tests/perf_baseline.txt)\n"
+            "  -t  allowed growth of a pass's summed median latency, in percent (default: 10)\n"
+            "  -s  noise floor: a single query also fails only when this many ns slower (default: 2000)\n"
+            "  -n  measured runs per query in each round (default: 21)\n"
+            "  -r  rounds over the corpus per pass; the fastest round median counts (default: 15)\n"
+            "  -w  write the baseline from this run instead of checking against it\n",
+            program);
+}
+
+int main(int argc, char **argv) {
+    int option;
+    while ((option = getopt(argc, argv, "f:b:t:s:n:r:wh")) != -1) {
+        switch (option) {
+            case 'f': options.corpus_path = optarg; break;
+            case 'b': options.baseline_path = optarg; break;
+            case 't': options.threshold_percent = atof(optarg); break;
+            case 's': options.noise_floor_ns = strtoull(optarg, NULL, 10); break;
+            case 'n': options.repeats = atoi(optarg); break;
+            case 'r': options.rounds = atoi(optarg); break;
+            case 'w': options.write_baseline = true; break;
+            default:
+                usage(argv[0]);
+                return option == 'h' ? 0 : 2;
+        }
+    }
+    if (options.repeats < 1 || options.repeats > MAX_REPEATS || options.rounds < 1 || options.threshold_percent < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    log_runtime_level = LOG_LEVEL_OFF;
+    if (!load_corpus(options.corpus_path)) return 2;
+    Baseline *baseline = calloc((size_t)query_count, sizeof(Baseline));
+    PassResult (*results)[PASS_COUNT] = calloc((size_t)query_count, sizeof(*results));
+    if (!baseline || !results) return 2;
+    if (!options.write_baseline && !load_baseline(options.baseline_path, baseline)) return 2;
+
+    init_chat_engine();
+    init_route_system();
+
+    int failures = 0;
+    uint64_t calibration_ns = 0;
+    for (Pass pass = PASS_COLD; pass < PASS_COUNT; pass++) {
+        // Unmapping the cache makes every lookup miss and every store a no-op
+        if (pass == PASS_COLD) {
+            cleanup_cache();
+        } else {
+            init_pattern_cache();
+        }
+        for (int round = 0; round < options.rounds; round++) {
+            for (int i = 0; i < query_count; i++) {
+                uint64_t calibration = calibrate();
+                if (calibration_ns == 0 || calibration < calibration_ns) calibration_ns = calibration;
+
+                bool correct = true;
+                PassResult *result = &results[i][pass];
+                double relative = (double)measure(&queries[i], round == 0, &correct, &result->allocations) /
+                                  (double)calibration;
+                if (round == 0 || relative < result->relative) result->relative = relative;
+                if (!correct) failures++;
+            }
+        }
+    }
+
+    // Latencies are reported in the baseline machine's time when there is one
+    uint64_t reference_ns = baseline_calibration_ns ? baseline_calibration_ns : calibration_ns;
+    for (int i = 0; i < query_count; i++) {
+        for (Pass pass = PASS_COLD; pass < PASS_COUNT; pass++) {
+            results[i][pass].p50_ns = (uint64_t)(results[i][pass].relative * (double)reference_ns);
+        }
+    }
+
+    if (options.write_baseline) {
+        if (failures > 0) {
+            printf("%d wrong answers; baseline not written\n", failures);
+            return 1;
+        }
+        if (!write_baseline(options.baseline_path, results, calibration_ns)) return 2;
+        printf("Wrote %s for %d queries\n", options.baseline_path, query_count);
+        return 0;
+    }
+
+    printf("calibration %.1f us, baseline %.1f us\n", (double)calibration_ns / 1000.0,
+           (double)baseline_calibration_ns / 1000.0);
+
+    uint64_t total[PASS_COUNT] = {0};
+    uint64_t baseline_total[PASS_COUNT] = {0};
+    bool compared[PASS_COUNT] = {true, true};
+    printf("%-5s %-40s %-4s %9s %9s %7s %6s\n", "line", "message", "pass", "p50 us", "base us", "change", "allocs");
+    for (int i = 0; i < query_count; i++) {
+        const GoldenQuery *query = &queries[i];
+        const Baseline *entry = &baseline[i];
+        bool stale = !entry->present || entry->hash != query->hash;
+        if (stale) {
+            printf("FAIL line %d has no baseline or was edited since; run make perfbaseline\n", query->line);
+            failures++;
+        }
+
+        for (Pass pass = PASS_COLD; pass < PASS_COUNT; pass++) {
+            const PassResult *now = &results[i][pass];
+            total[pass] += now->p50_ns;
+            if (stale) {
+                compared[pass] = false;
+                continue;
+            }
+            const PassResult *then = &entry->pass[pass];
+            baseline_total[pass] += then->p50_ns;
+
+            double change = then->p50_ns ? ((double)now->p50_ns / (double)then->p50_ns - 1.0) * 100.0 : 0.0;
+            bool slower = change > options.threshold_percent;
+            bool failed_latency = slower && now->p50_ns > then->p50_ns + options.noise_floor_ns;
+            bool failed_allocations = now->allocations > then->allocations;
+            printf("%-5d %-40.40s %-4s %9.1f %9.1f %+6.1f%% %3llu/%-3llu%s%s%s\n", query->line,
+                   query->request.message, pass_names[pass], (double)now->p50_ns / 1000.0,
+                   (double)then->p50_ns / 1000.0, change, (unsigned long long)now->allocations,
+                   (unsigned long long)then->allocations, slower ? " slower" : "",
+                   failed_latency ? " FAIL" : "", failed_allocations ? " FAIL more allocations" : "");
+            if (now->allocations < then->allocations) {
+                printf("      fewer allocations than the baseline: run make perfbaseline to lock them in\n");
+            }
+            if (failed_latency || failed_allocations) failures++;
+        }
+    }
+
+    for (Pass pass = PASS_COLD; pass < PASS_COUNT; pass++) {
+        if (!compared[pass] || baseline_total[pass] == 0) continue;
+        double change = ((double)total[pass] / (double)baseline_total[pass] - 1.0) * 100.0;
+        bool passed = change <= options.threshold_percent;
+        printf("%-4s %s summed p50 %.1f us, baseline %.1f us (%+.1f%%, allowed +%.1f%%)\n", passed ? "ok" : "FAIL",
+               pass_names[pass], (double)total[pass] / 1000.0, (double)baseline_total[pass] / 1000.0, change,
+               options.threshold_percent);
+        if (!passed) failures++;
+    }
+
+    free(results);
+    free(baseline);
+    free(queries);
+    printf("%s: %d queries, %d failures\n", failures == 0 ? "perfcheck passed" : "perfcheck FAILED", query_count,
+           failures);
+    return failures == 0 ? 0 : 1;
+}
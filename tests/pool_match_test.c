@@ -0,0 +1,93 @@
+// Runs the matcher on the server's work-stealing pool, many messages at a
+// time, and fails unless every answer has the category the same message
+// gets when matched alone. Catches shared state in the request path, such
+// as a tokenizer that keeps its position between calls.
+#include "../include/bricllm.h"
+#include "../include/chat_engine.h"
+#include "../include/route_types.h"
+#include "../include/worker_pool.h"
+#include <stdatomic.h>
+#include <time.h>
+
+#define WORKERS 8
+#define ROUNDS 20000
+
+typedef struct {
+    const char *message;
+    const char *role;
+    const char *route;
+    char category[32];          // answered alone, "" when nothing matches
+} MatchCase;
+
+static MatchCase cases[] = {
+    {"tell me a joke now please", "tenant", "/tenant", ""},
+    {"where can I find maintenance requests today", "tenant", "/tenant", ""},
+    {"How do I pay my rent?", "tenant", "/tenant/payments", ""},
+    {"the kitchen tap is broken and needs repair", "tenant", "/tenant/requests", ""},
+    {"hello there, are you a robot", "tenant", "/tenant", ""},
+    {"thanks for the help with everything", "tenant", "/tenant", ""},
+    {"what's the weather like today?", "caretaker", "/caretaker", ""},
+    {"how do I find my schedule", "caretaker", "/caretaker/tasks", ""},
+    {"where do I navigate for leases", "manager", "/manager", ""},
+    {"asdfgh qwerty zxcvb", "admin", "/admin", ""},
+};
+
+#define CASE_COUNT (sizeof(cases) / sizeof(cases[0]))
+
+typedef struct {
+    Task task;
+    const MatchCase *expected;
+} MatchTask;
+
+static MatchTask tasks[ROUNDS * CASE_COUNT];
+static atomic_int finished;
+static atomic_int mismatches;
+
+static void category_of(const MatchCase *test, char *out, size_t size) {
+    ResponsePattern *pattern = find_matching_pattern(test->message, test->role, "en", test->route);
+    snprintf(out, size, "%s", pattern && pattern->category ? pattern->category : "");
+    free_pattern(pattern);
+}
+
+static void run_match(Task *task) {
+    const MatchCase *test = ((MatchTask *)task)->expected;
+    char category[32];
+    category_of(test, category, sizeof(category));
+    if (strcmp(category, test->category) != 0) {
+        if (atomic_fetch_add(&mismatches, 1) < 5) {
+            fprintf(stderr, "\"%s\": got \"%s\", alone \"%s\"\n", test->message, category, test->category);
+        }
+    }
+    atomic_fetch_add(&finished, 1);
+}
+
+int main(void) {
+    log_runtime_level = LOG_LEVEL_OFF;
+    init_chat_engine();
+    init_route_system();
+
+    for (size_t i = 0; i < CASE_COUNT; i++) {
+        category_of(&cases[i], cases[i].category, sizeof(cases[i].category));
+    }
+
+    WorkerPool *pool = worker_pool_create(WORKERS);
+    if (!pool) {
+        fprintf(stderr, "Cannot start worker pool\n");
+        return 1;
+    }
+    int total = (int)(sizeof(tasks) / sizeof(tasks[0]));
+    for (int i = 0; i < total; i++) {
+        tasks[i].task.run = run_match;
+        tasks[i].expected = &cases[(size_t)i % CASE_COUNT];
+        worker_pool_submit(pool, &tasks[i].task);
+    }
+
+    struct timespec pause = {0, 1000000};
+    while (atomic_load(&finished) < total) nanosleep(&pause, NULL);
+    worker_pool_destroy(pool);
+
+    int wrong = atomic_load(&mismatches);
+    printf("%s %d concurrent matches on %d workers, %d with a different category\n", wrong == 0 ? "ok" : "FAIL",
+           total, WORKERS, wrong);
+    return wrong == 0 ? 0 : 1;
+}
@@ -0,0 +1,536 @@
+// Replays a JSONL corpus of chat requests against the engine in this process,
+// or against a running --serve over HTTP, and reports throughput, latency
+// percentiles, the cache hit rate and RSS over time.
+//
+// Corpus lines take the POST /chat fields. Lines that share a sessionId form
+// a conversation whose turns are replayed in order on a fresh session; other
+// lines are single-turn conversations. Workers take conversations round-robin
+// until the run ends. Over HTTP the replays cycle through -u session ids, as
+// returning users would, since the server keeps a bounded number of sessions.
+//
+// Closed loop (default): -c workers each send their next turn as soon as the
+// last one is answered. Open loop (-q): turns are scheduled at a fixed rate
+// and latency is measured from the scheduled time rather than the send, so a
+// stall also counts against every turn that should have been sent during it
+// (coordinated-omission correction). -c then bounds the turns in flight.
+#include "../include/bricllm.h"
+#include "../include/chat_engine.h"
+#include "../include/request_handler.h"
+#include "../include/pattern_cache.h"
+#include "../include/json_io.h"
+#include "../include/route_types.h"
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// Log-linear buckets: exact below 32ns, then 32 per power of two (~3%)
+#define HIST_SUB_BITS 5
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+#define MAX_WORKERS 4096
+#define MAX_REPLY (1024 * 1024)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+} Histogram;
+
+typedef struct {
+    int first;      // into turn_order
+    int turns;
+} Conversation;
+
+typedef struct {
+    pthread_t thread;
+    Histogram latency;
+    OutputBuffer out;       // engine payload, or the HTTP request
+    OutputBuffer reply;     // HTTP response
+    int fd;
+} Worker;
+
+typedef struct {
+    const char *corpus_path;
+    const char *host;
+    const char *port;       // NULL runs the engine in this process
+    double qps;             // 0 runs closed loop
+    int workers;
+    int duration;
+    int interval;
+    int pid;                // process whose RSS is sampled; 0 is this one
+    int users;              // distinct session ids sent to the server
+} LoadOptions;
+
+static LoadOptions options = {"tools/load_corpus.jsonl", "127.0.0.1", NULL, 0, 64, 10, 1, 0, 500};
+
+static ChatRequest *requests;
+static int request_count;
+static int *turn_order;
+static Conversation *conversations;
+static int conversation_count;
+static struct addrinfo *server_addr;
+
+static uint64_t run_start;
+static uint64_t run_deadline;
+static atomic_ullong next_conversation;
+static atomic_ullong next_ticket;
+static atomic_ullong completed;
+static atomic_ullong failed;
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static void sleep_until(uint64_t when) {
+    struct timespec target = {(time_t)(when / 1000000000ULL), (long)(when % 1000000000ULL)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target, NULL) == EINTR) {}
+}
+
+static int bucket_of(uint64_t value) {
+    if (value < HIST_SUB) return (int)value;
+    int shift = 63 - __builtin_clzll(value) - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB + (int)((value >> shift) - HIST_SUB);
+}
+
+// Largest value in the bucket, so percentiles never read low
+static uint64_t bucket_limit(int bucket) {
+    if (bucket < HIST_SUB) return (uint64_t)bucket;
+    int shift = bucket / HIST_SUB - 1;
+    uint64_t mantissa = (uint64_t)(bucket % HIST_SUB + HIST_SUB);
+    return ((mantissa + 1) << shift) - 1;
+}
+
+static void record(Histogram *histogram, uint64_t value) {
+    histogram->counts[bucket_of(value)]++;
+    histogram->total++;
+}
+
+static uint64_t percentile(const Histogram *histogram, double fraction) {
+    if (histogram->total == 0) return 0;
+    uint64_t rank = (uint64_t)(fraction * (double)histogram->total);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < HIST_BUCKETS; bucket++) {
+        seen += histogram->counts[bucket];
+        if (seen >= rank) return bucket_limit(bucket);
+    }
+    return bucket_limit(HIST_BUCKETS - 1);
+}
+
+static long rss_kb(int pid) {
+    char path[64];
+    if (pid > 0) {
+        snprintf(path, sizeof(path), "/proc/%d/statm", pid);
+    } else {
+        snprintf(path, sizeof(path), "/proc/self/statm");
+    }
+    FILE *file = fopen(path, "r");
+    if (!file) return -1;
+    long pages = -1;
+    long size;
+    long resident;
+    if (fscanf(file, "%ld %ld", &size, &resident) == 2) pages = resident;
+    fclose(file);
+    return pages < 0 ? -1 : pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static const char *session_key(int request) {
+    return requests[request].session_id;
+}
+
+// Conversation order: by sessionId, then by line; lines without one stand alone
+static int compare_turns(const void *left, const void *right) {
+    int a = *(const int *)left;
+    int b = *(const int *)right;
+    int order = strcmp(session_key(a), session_key(b));
+    return order != 0 ? order : a - b;
+}
+
+static bool load_corpus(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    int capacity = 256;
+    int count = 0;
+    requests = malloc((size_t)capacity * sizeof(ChatRequest));
+    char *line = NULL;
+    size_t line_capacity = 0;
+    ssize_t length;
+    int line_number = 0;
+    bool ok = requests != NULL;
+    while (ok && (length = getline(&line, &line_capacity, file)) >= 0) {
+        line_number++;
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) line[--length] = '\0';
+        if (length == 0) continue;
+        if (count == capacity) {
+            capacity *= 2;
+            ChatRequest *grown = realloc(requests, (size_t)capacity * sizeof(ChatRequest));
+            if (!grown) {
+                ok = false;
+                break;
+            }
+            requests = grown;
+        }
+        const char *error = NULL;
+        if (!parse_chat_request(line, (size_t)length, &requests[count], &error)) {
+            fprintf(stderr, "%s:%d: %s\n", path, line_number, error);
+            ok = false;
+            break;
+        }
+        count++;
+    }
+    free(line);
+    fclose(file);
+    if (!ok) return false;
+    if (count == 0) {
+        fprintf(stderr, "%s has no requests\n", path);
+        return false;
+    }
+    request_count = count;
+
+    turn_order = malloc((size_t)count * sizeof(int));
+    conversations = malloc((size_t)count * sizeof(Conversation));
+    if (!turn_order || !conversations) return false;
+    for (int i = 0; i < count; i++) turn_order[i] = i;
+    qsort(turn_order, (size_t)count, sizeof(int), compare_turns);
+
+    for (int i = 0; i < count; i++) {
+        const char *key = session_key(turn_order[i]);
+        if (i > 0 && key[0] && strcmp(key, session_key(turn_order[i - 1])) == 0) {
+            conversations[conversation_count - 1].turns++;
+            continue;
+        }
+        conversations[conversation_count].first = i;
+        conversations[conversation_count].turns = 1;
+        conversation_count++;
+    }
+    return true;
+}
+
+static int connect_server(void) {
+    int fd = socket(server_addr->ai_family, server_addr->ai_socktype, server_addr->ai_protocol);
+    if (fd < 0) return -1;
+    if (connect(fd, server_addr->ai_addr, server_addr->ai_addrlen) < 0) {
+        close(fd);
+        return -1;
+    }
+    int enable = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    return fd;
+}
+
+// Sends request and reads one Content-Length response into reply. Returns
+// the HTTP status, or -1 when the connection failed.
+static int http_exchange(int fd, const OutputBuffer *request, OutputBuffer *reply, size_t *body_offset) {
+    size_t sent_total = 0;
+    while (sent_total < request->length) {
+        ssize_t sent = send(fd, request->data + sent_total, request->length - sent_total, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        sent_total += (size_t)sent;
+    }
+
+    buffer_reset(reply);
+    for (;;) {
+        const char *end = reply->length ? memmem(reply->data, reply->length, "\r\n\r\n", 4) : NULL;
+        if (end) {
+            const char *length_header = memmem(reply->data, (size_t)(end - reply->data), "Content-Length:", 15);
+            if (!length_header) return -1;
+            *body_offset = (size_t)(end - reply->data) + 4;
+            if (reply->length >= *body_offset + strtoul(length_header + 15, NULL, 10)) {
+                return reply->length > 12 ? atoi(reply->data + 9) : -1;
+            }
+        }
+        if (reply->length >= MAX_REPLY || !buffer_reserve(reply, 4096)) return -1;
+        ssize_t received = recv(fd, reply->data + reply->length, 4096, 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return -1;
+        reply->length += (size_t)received;
+    }
+}
+
+static void append_field(OutputBuffer *body, const char *key, const char *value) {
+    if (!value[0]) return;
+    buffer_appendf(body, "%s\"%s\":", body->length > 1 ? "," : "", key);
+    json_append_string(body, value);
+}
+
+static bool http_turn(Worker *worker, const ChatRequest *request, const char *session_id) {
+    OutputBuffer body;
+    buffer_init(&body);
+    buffer_append_str(&body, "{");
+    append_field(&body, "sessionId", session_id);
+    append_field(&body, "userId", request->user_id);
+    append_field(&body, "message", request->message);
+    append_field(&body, "role", request->role);
+    append_field(&body, "lang", request->language);
+    append_field(&body, "route", request->route);
+    bool built = buffer_append_str(&body, "}");
+
+    buffer_reset(&worker->out);
+    built = built && buffer_appendf(&worker->out, "POST /chat HTTP/1.1\r\nHost: %s\r\nContent-Length: %zu\r\n\r\n",
+                                    options.host, body.length) &&
+            buffer_append(&worker->out, body.data, body.length);
+    buffer_free(&body);
+    if (!built) return false;
+
+    if (worker->fd < 0) worker->fd = connect_server();
+    if (worker->fd < 0) return false;
+    size_t body_offset;
+    int status = http_exchange(worker->fd, &worker->out, &worker->reply, &body_offset);
+    if (status < 0) {
+        close(worker->fd);
+        worker->fd = -1;
+    }
+    return status == 200;
+}
+
+static bool local_turn(Worker *worker, ChatSession **session, const ChatRequest *request) {
+    bool created = *session == NULL;
+    if (created) {
+        *session = create_detached_session(request_user_id(request), request_role(request),
+                                           request_language(request));
+        if (!*session) return false;
+    }
+    buffer_reset(&worker->out);
+    return run_chat_request(*session, created, request, &worker->out) == REQUEST_OK;
+}
+
+static void *worker_main(void *arg) {
+    Worker *worker = arg;
+    // Open-loop sends wake on time rather than up to 50us late
+    prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+    bool running = true;
+    while (running) {
+        unsigned long long replay = atomic_fetch_add(&next_conversation, 1);
+        const Conversation *conversation = &conversations[replay % (unsigned long long)conversation_count];
+        ChatSession *session = NULL;
+        char session_id[CHAT_REQUEST_MAX_ID + 1];
+        snprintf(session_id, sizeof(session_id), "load-%llu", replay % (unsigned long long)options.users);
+
+        for (int turn = 0; turn < conversation->turns; turn++) {
+            const ChatRequest *request = &requests[turn_order[conversation->first + turn]];
+            uint64_t start;
+            if (options.qps > 0) {
+                unsigned long long ticket = atomic_fetch_add(&next_ticket, 1);
+                start = run_start + (uint64_t)((double)ticket * 1e9 / options.qps);
+                if (start >= run_deadline || now_ns() >= run_deadline) {
+                    running = false;
+                    break;
+                }
+                sleep_until(start);
+            } else {
+                start = now_ns();
+                if (start >= run_deadline) {
+                    running = false;
+                    break;
+                }
+            }
+
+            bool ok = options.port ? http_turn(worker, request, session_id) : local_turn(worker, &session, request);
+            record(&worker->latency, now_ns() - start);
+            atomic_fetch_add(ok ? &completed : &failed, 1);
+        }
+        free_session(session);
+    }
+    return NULL;
+}
+
+// Reads the shared cache counters from /metrics; false when unavailable
+static bool server_cache_counters(uint64_t *hits, uint64_t *misses) {
+    int fd = connect_server();
+    if (fd < 0) return false;
+    OutputBuffer request;
+    OutputBuffer reply;
+    buffer_init(&request);
+    buffer_init(&reply);
+    buffer_appendf(&request, "GET /metrics HTTP/1.1\r\nHost: %s\r\nContent-Length: 0\r\n\r\n", options.host);
+    size_t body_offset;
+    bool ok = http_exchange(fd, &request, &reply, &body_offset) == 200 && buffer_append(&reply, "", 1);
+    const char *hit_field = ok ? strstr(reply.data + body_offset, "\"cacheHits\":") : NULL;
+    const char *miss_field = ok ? strstr(reply.data + body_offset, "\"cacheMisses\":") : NULL;
+    ok = hit_field && miss_field;
+    if (ok) {
+        *hits = strtoull(hit_field + 12, NULL, 10);
+        *misses = strtoull(miss_field + 14, NULL, 10);
+    }
+    buffer_free(&request);
+    buffer_free(&reply);
+    close(fd);
+    return ok;
+}
+
+static bool read_cache_counters(uint64_t *hits, uint64_t *misses) {
+    if (options.port) return server_cache_counters(hits, misses);
+    cache_counters(hits, misses);
+    return true;
+}
+
+static bool split_server(char *address) {
+    char *colon = strrchr(address, ':');
+    if (colon) {
+        *colon = '\0';
+        options.host = address;
+        options.port = colon + 1;
+    } else {
+        options.port = address;
+    }
+    return options.port[0] != '\0';
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [-f corpus.jsonl] [-s [host:]port] [-q qps] [-c concurrency] [-d seconds]\n"
+            "          [-i interval] [-p pid] [-u sessions]\n"
+            "  -f  corpus of POST /chat bodies, one per line (default: tools/load_corpus.jsonl)\n"
+            "  -s  replay against a running --serve instead of the engine in this process\n"
+            "  -q  open loop at this many requests per second (default: closed loop)\n"
+            "  -c  workers, and so the requests in flight (default: 64)\n"
+            "  -d  run time in seconds (default: 10)\n"
+            "  -i  seconds between progress lines (default: 1)\n"
+            "  -p  process whose RSS is sampled, e.g. the server (default: this one with -s unset)\n"
+            "  -u  session ids replayed over -s (default: 500)\n",
+            program);
+}
+
+int main(int argc, char **argv) {
+    int option;
+    while ((option = getopt(argc, argv, "f:s:q:c:d:i:p:u:h")) != -1) {
+        switch (option) {
+            case 'f': options.corpus_path = optarg; break;
+            case 's':
+                if (!split_server(optarg)) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'q': options.qps = atof(optarg); break;
+            case 'c': options.workers = atoi(optarg); break;
+            case 'd': options.duration = atoi(optarg); break;
+            case 'i': options.interval = atoi(optarg); break;
+            case 'p': options.pid = atoi(optarg); break;
+            case 'u': options.users = atoi(optarg); break;
+            default:
+                usage(argv[0]);
+                return option == 'h' ? 0 : 1;
+        }
+    }
+    if (options.workers <= 0 || options.workers > MAX_WORKERS || options.duration <= 0 ||
+        options.interval <= 0 || options.users <= 0 || options.qps < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    log_runtime_level = LOG_LEVEL_OFF;
+    if (!load_corpus(options.corpus_path)) return 1;
+
+    if (options.port) {
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(options.host, options.port, &hints, &server_addr) != 0) {
+            fprintf(stderr, "Cannot resolve %s:%s\n", options.host, options.port);
+            return 1;
+        }
+    } else {
+        init_chat_engine();
+        init_route_system();
+    }
+    // With a server and no pid, there is no process worth sampling
+    bool sample_rss = !options.port || options.pid > 0;
+
+    uint64_t hits_before = 0;
+    uint64_t misses_before = 0;
+    bool have_cache = read_cache_counters(&hits_before, &misses_before);
+
+    Worker *workers = calloc((size_t)options.workers, sizeof(Worker));
+    if (!workers) return 1;
+
+    printf("mode=%s loop=%s corpus=%s requests=%d conversations=%d workers=%d",
+           options.port ? "http" : "in-process", options.qps > 0 ? "open" : "closed", options.corpus_path,
+           request_count, conversation_count, options.workers);
+    if (options.qps > 0) printf(" target_qps=%.0f", options.qps);
+    printf("\n");
+    fflush(stdout);
+
+    run_start = now_ns();
+    run_deadline = run_start + (uint64_t)options.duration * 1000000000ULL;
+    int started = 0;
+    for (; started < options.workers; started++) {
+        buffer_init(&workers[started].out);
+        buffer_init(&workers[started].reply);
+        workers[started].fd = -1;
+        if (pthread_create(&workers[started].thread, NULL, worker_main, &workers[started]) != 0) {
+            fprintf(stderr, "Started only %d workers\n", started);
+            break;
+        }
+    }
+
+    // Progress: throughput over the last interval and resident memory
+    long rss_peak = sample_rss ? rss_kb(options.pid) : -1;
+    unsigned long long last_done = 0;
+    for (int second = options.interval; second <= options.duration; second += options.interval) {
+        sleep_until(run_start + (uint64_t)second * 1000000000ULL);
+        unsigned long long done = atomic_load(&completed) + atomic_load(&failed);
+        long rss = sample_rss ? rss_kb(options.pid) : -1;
+        if (rss > rss_peak) rss_peak = rss;
+        printf("t=%ds rps=%.0f errors=%llu", second, (double)(done - last_done) / options.interval,
+               (unsigned long long)atomic_load(&failed));
+        if (rss >= 0) printf(" rss_kb=%ld", rss);
+        printf("\n");
+        fflush(stdout);
+        last_done = done;
+    }
+
+    Histogram latency;
+    memset(&latency, 0, sizeof(latency));
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+        for (int bucket = 0; bucket < HIST_BUCKETS; bucket++) latency.counts[bucket] += workers[i].latency.counts[bucket];
+        latency.total += workers[i].latency.total;
+        buffer_free(&workers[i].out);
+        buffer_free(&workers[i].reply);
+        if (workers[i].fd >= 0) close(workers[i].fd);
+    }
+    double elapsed = (double)(now_ns() - run_start) / 1e9;
+
+    uint64_t hits_after = 0;
+    uint64_t misses_after = 0;
+    have_cache = have_cache && read_cache_counters(&hits_after, &misses_after);
+    uint64_t lookups = (hits_after - hits_before) + (misses_after - misses_before);
+
+    printf("requests=%llu errors=%llu rps=%.0f p50_us=%.1f p90_us=%.1f p99_us=%.1f p999_us=%.1f max_us=%.1f",
+           (unsigned long long)atomic_load(&completed), (unsigned long long)atomic_load(&failed),
+           (double)latency.total / elapsed, percentile(&latency, 0.50) / 1e3, percentile(&latency, 0.90) / 1e3,
+           percentile(&latency, 0.99) / 1e3, percentile(&latency, 0.999) / 1e3, percentile(&latency, 1.0) / 1e3);
+    if (have_cache && lookups > 0) {
+        printf(" cache_hit=%.1f%%", (double)(hits_after - hits_before) * 100.0 / (double)lookups);
+    }
+    if (rss_peak >= 0) printf(" rss_peak_kb=%ld", rss_peak);
+    printf("\n");
+
+    free(workers);
+    if (server_addr) freeaddrinfo(server_addr);
+    free(conversations);
+    free(turn_order);
+    free(requests);
+    return 0;
+}
@@ -0,0 +1,28 @@
+#!/bin/bash
+# Compares requests/sec and tail latency of the epoll and io_uring backends.
+# Usage: tools/compare_backends.sh [seconds] [connection counts...]
+
+set -e
+
+DURATION=${1:-10}
+shift || true
+COUNTS=${*:-"64 256 1024"}
+PORT=${PORT:-18080}
+WORKERS=${WORKERS:-$(nproc)}
+
+make --no-print-directory bricllm tools/netbench >/dev/null
+ulimit -n 65536 2>/dev/null || true
+
+for backend in epoll uring; do
+    ./bricllm --serve "127.0.0.1:$PORT" --workers "$WORKERS" --io-backend "$backend" --log-level warn &
+    server=$!
+    sleep 0.5
+
+    for count in $COUNTS; do
+        printf '%-6s ' "$backend"
+        tools/netbench -p "$PORT" -c "$count" -d "$DURATION"
+    done
+
+    kill -INT "$server"
+    wait "$server" || true
+done
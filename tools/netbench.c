@@ -0,0 +1,238 @@
+// Closed-loop HTTP load generator for comparing server IO backends.
+// Each connection keeps one POST /chat in flight and records its latency.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#define MAX_EVENTS 256
+#define RESPONSE_BUFFER 65536
+
+typedef struct {
+    int fd;
+    char request[2048];
+    size_t request_length;
+    uint64_t sent_at;
+    size_t received;
+    char buffer[RESPONSE_BUFFER];
+} Client;
+
+typedef struct {
+    uint32_t *values;
+    size_t count;
+    size_t capacity;
+} Samples;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void add_sample(Samples *samples, uint32_t value) {
+    if (samples->count == samples->capacity) {
+        size_t capacity = samples->capacity ? samples->capacity * 2 : 65536;
+        uint32_t *values = realloc(samples->values, capacity * sizeof(uint32_t));
+        if (!values) return;
+        samples->values = values;
+        samples->capacity = capacity;
+    }
+    samples->values[samples->count++] = value;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t percentile(const Samples *samples, double fraction) {
+    if (samples->count == 0) return 0;
+    size_t index = (size_t)(fraction * (double)(samples->count - 1));
+    return samples->values[index];
+}
+
+static int connect_to(const struct addrinfo *addr) {
+    int fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+    if (fd < 0) return -1;
+    if (connect(fd, addr->ai_addr, addr->ai_addrlen) < 0) {
+        close(fd);
+        return -1;
+    }
+    int enable = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    return fd;
+}
+
+static bool send_request(Client *client) {
+    const char *request = client->request;
+    size_t length = client->request_length;
+    client->received = 0;
+    client->sent_at = now_ns();
+    size_t sent_total = 0;
+    while (sent_total < length) {
+        ssize_t sent = send(client->fd, request + sent_total, length - sent_total, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        sent_total += (size_t)sent;
+    }
+    return true;
+}
+
+// Returns 1 when a full response has arrived, 0 when more is needed, -1 on error
+static int response_complete(const Client *client) {
+    const char *end = memmem(client->buffer, client->received, "\r\n\r\n", 4);
+    if (!end) return client->received < sizeof(client->buffer) ? 0 : -1;
+
+    const char *length_header = memmem(client->buffer, (size_t)(end - client->buffer), "Content-Length:", 15);
+    if (!length_header) return -1;
+    size_t body_length = strtoul(length_header + 15, NULL, 10);
+    size_t total = (size_t)(end - client->buffer) + 4 + body_length;
+    return client->received >= total ? 1 : 0;
+}
+
+// Status code of a complete response, 0 when the status line is malformed
+static int response_status(const Client *client) {
+    if (client->received < 12 || memcmp(client->buffer, "HTTP/1.", 7) != 0 || client->buffer[8] != ' ') return 0;
+    int status = 0;
+    for (int i = 9; i < 12; i++) {
+        if (client->buffer[i] < '0' || client->buffer[i] > '9') return 0;
+        status = status * 10 + (client->buffer[i] - '0');
+    }
+    return status;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [-H host] [-p port] [-c connections] [-d seconds] [-m message] [-u sessions]\n", program);
+}
+
+int main(int argc, char **argv) {
+    const char *host = "127.0.0.1";
+    const char *port = "8080";
+    const char *message = "How do I pay my rent?";
+    int connections = 64;
+    int duration = 10;
+    int sessions = 500;
+
+    int option;
+    while ((option = getopt(argc, argv, "H:p:c:d:m:u:h")) != -1) {
+        switch (option) {
+            case 'H': host = optarg; break;
+            case 'p': port = optarg; break;
+            case 'c': connections = atoi(optarg); break;
+            case 'd': duration = atoi(optarg); break;
+            case 'm': message = optarg; break;
+            case 'u': sessions = atoi(optarg); break;
+            default:
+                usage(argv[0]);
+                return option == 'h' ? 0 : 1;
+        }
+    }
+    if (connections <= 0 || duration <= 0 || sessions <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *addr;
+    if (getaddrinfo(host, port, &hints, &addr) != 0) {
+        fprintf(stderr, "Cannot resolve %s:%s\n", host, port);
+        return 1;
+    }
+
+    int epoll_fd = epoll_create1(0);
+    Client *clients = calloc((size_t)connections, sizeof(Client));
+    if (epoll_fd < 0 || !clients) return 1;
+
+    // Connections share -u session ids, since the server keeps a bounded
+    // number of sessions and refuses new ones past it
+    for (int i = 0; i < connections; i++) {
+        char body[1024];
+        int body_length = snprintf(body, sizeof(body), "{\"sessionId\":\"bench-%d\",\"message\":\"%s\"}", i % sessions,
+                               message);
+        int request_length = snprintf(clients[i].request, sizeof(clients[i].request),
+                                      "POST /chat HTTP/1.1\r\nHost: %s\r\nContent-Length: %d\r\n\r\n%s",
+                                      host, body_length, body);
+        if (body_length >= (int)sizeof(body) || request_length >= (int)sizeof(clients[i].request)) {
+            fprintf(stderr, "Message too long\n");
+            return 1;
+        }
+        clients[i].request_length = (size_t)request_length;
+
+        clients[i].fd = connect_to(addr);
+        if (clients[i].fd < 0) {
+            fprintf(stderr, "Connection %d failed: %s\n", i, strerror(errno));
+            return 1;
+        }
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = &clients[i];
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, clients[i].fd, &event);
+    }
+    freeaddrinfo(addr);
+
+    Samples samples = {NULL, 0, 0};
+    unsigned long errors = 0;
+    uint64_t start = now_ns();
+    uint64_t deadline = start + (uint64_t)duration * 1000000000ULL;
+
+    for (int i = 0; i < connections; i++) {
+        if (!send_request(&clients[i])) errors++;
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    uint64_t now = start;
+    while (now < deadline) {
+        int ready = epoll_wait(epoll_fd, events, MAX_EVENTS, 100);
+        now = now_ns();
+        for (int i = 0; i < ready; i++) {
+            Client *client = events[i].data.ptr;
+            ssize_t received = recv(client->fd, client->buffer + client->received,
+                                    sizeof(client->buffer) - client->received, 0);
+            if (received <= 0) {
+                errors++;
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+                continue;
+            }
+            client->received += (size_t)received;
+
+            int state = response_complete(client);
+            if (state == 0) continue;
+            if (state < 0 || response_status(client) != 200) {
+                errors++;
+            } else {
+                add_sample(&samples, (uint32_t)((now - client->sent_at) / 1000));
+            }
+            if (now < deadline && !send_request(client)) {
+                errors++;
+            }
+        }
+    }
+
+    double elapsed = (double)(now_ns() - start) / 1e9;
+    qsort(samples.values, samples.count, sizeof(uint32_t), compare_u32);
+    printf("connections=%d requests=%zu errors=%lu rps=%.0f p50_us=%u p99_us=%u p999_us=%u max_us=%u\n",
+           connections, samples.count, errors, (double)samples.count / elapsed,
+           percentile(&samples, 0.50), percentile(&samples, 0.99), percentile(&samples, 0.999),
+           percentile(&samples, 1.0));
+
+    for (int i = 0; i < connections; i++) close(clients[i].fd);
+    free(clients);
+    free(samples.values);
+    close(epoll_fd);
+    return 0;
+}
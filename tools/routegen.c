@@ -0,0 +1,299 @@
+// Compiles the route manifest into const C tables: the guides, their hashes,
+// a prebuilt route index and navigation graph, so the built-in routes need no
+// work at startup.
+#include "../include/route_index.h"
+#include "../include/nav_graph.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#define MAX_ROUTES NAV_GRAPH_MAX_ROUTES
+#define MAX_ITEMS 64
+#define MAX_MANIFEST (1024 * 1024)
+
+typedef struct {
+    char *items[MAX_ITEMS];
+    int count;
+} ItemList;
+
+typedef struct {
+    ItemList buttons;
+    ItemList actions;
+    ItemList patterns;
+} RouteLists;
+
+static RouteGuide guides[MAX_ROUTES];
+static RouteLists lists[MAX_ROUTES];
+static int route_count;
+static const char *manifest_path;
+static int line_number;
+
+static bool fail(const char *message, const char *detail) {
+    fprintf(stderr, "%s:%d: %s%s%s\n", manifest_path, line_number, message, detail ? " " : "", detail ? detail : "");
+    return false;
+}
+
+static char *trim(char *text) {
+    while (*text == ' ' || *text == '\t') text++;
+    size_t length = strlen(text);
+    while (length > 0 && (text[length - 1] == ' ' || text[length - 1] == '\t' || text[length - 1] == '\r')) {
+        text[--length] = '\0';
+    }
+    return text;
+}
+
+static char *next_word(char **cursor) {
+    char *word = *cursor;
+    while (*word == ' ' || *word == '\t') word++;
+    if (*word == '\0') return NULL;
+
+    char *end = word;
+    while (*end && *end != ' ' && *end != '\t') end++;
+    if (*end) *end++ = '\0';
+    *cursor = end;
+    return word;
+}
+
+static bool add_item(ItemList *list, char *item) {
+    if (*item == '\0') return fail("empty item", NULL);
+    if (list->count == MAX_ITEMS) return fail("too many items", NULL);
+    list->items[list->count++] = item;
+    return true;
+}
+
+static bool parse_items(ItemList *list, char *text, bool words) {
+    if (words) {
+        char *word;
+        while ((word = next_word(&text))) {
+            if (!add_item(list, word)) return false;
+        }
+        return true;
+    }
+    while (text) {
+        char *bar = strchr(text, '|');
+        if (bar) *bar = '\0';
+        if (!add_item(list, trim(text))) return false;
+        text = bar ? bar + 1 : NULL;
+    }
+    return true;
+}
+
+static bool valid_role(const char *role) {
+    return strcmp(role, "tenant") == 0 || strcmp(role, "caretaker") == 0 ||
+           strcmp(role, "manager") == 0 || strcmp(role, "admin") == 0;
+}
+
+static bool parse_line(char *line) {
+    line = trim(line);
+    if (*line == '\0' || *line == '#') return true;
+
+    char *rest = line;
+    char *directive = next_word(&rest);
+    rest = trim(rest);
+
+    if (strcmp(directive, "route") == 0) {
+        if (route_count > 0 && lists[route_count - 1].buttons.count == 0) return fail("previous route needs buttons", NULL);
+        char *path = next_word(&rest);
+        char *role = next_word(&rest);
+        if (!role || next_word(&rest)) return fail("expected 'route <path> <role>'", NULL);
+        if (path[0] != '/') return fail("route must start with '/':", path);
+        if (!valid_role(role)) return fail("unknown role", role);
+        if (route_count == MAX_ROUTES) return fail("too many routes", NULL);
+        guides[route_count].navigation.route = path;
+        guides[route_count].navigation.user_role = role;
+        guides[route_count].hash = route_hash(path);
+        route_count++;
+        return true;
+    }
+
+    if (route_count == 0) return fail("outside a route:", directive);
+    RouteLists *current = &lists[route_count - 1];
+    if (strcmp(directive, "buttons") == 0) return parse_items(&current->buttons, rest, false);
+    if (strcmp(directive, "actions") == 0) return parse_items(&current->actions, rest, false);
+    if (strcmp(directive, "patterns") == 0) return parse_items(&current->patterns, rest, true);
+    return fail("unknown directive", directive);
+}
+
+static void write_string(FILE *out, const char *text, int length) {
+    fputc('"', out);
+    for (int i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20 || c >= 0x7f) {
+            fprintf(out, "\\%03o", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void write_list(FILE *out, const char *name, int route, const ItemList *list) {
+    if (list->count == 0) return;
+    fprintf(out, "static char *%s_%d[] = {", name, route);
+    for (int i = 0; i < list->count; i++) {
+        if (i > 0) fputs(", ", out);
+        write_string(out, list->items[i], (int)strlen(list->items[i]));
+    }
+    fputs("};\n", out);
+}
+
+static void write_list_ref(FILE *out, const char *name, int route, const ItemList *list) {
+    if (list->count == 0) {
+        fputs("NULL, 0", out);
+    } else {
+        fprintf(out, "%s_%d, %d", name, route, list->count);
+    }
+}
+
+static void write_ints(FILE *out, const char *type, const char *name, const int *values, size_t count) {
+    fprintf(out, "static const %s %s[] = {", type, name);
+    for (size_t i = 0; i < count; i++) {
+        fprintf(out, "%s%s%d", i > 0 ? "," : "", i % 16 == 0 ? "\n    " : " ", values[i]);
+    }
+    fputs("\n};\n\n", out);
+}
+
+static void write_graph(FILE *out, const NavigationGraph *graph, int items) {
+    write_ints(out, "int", "builtin_item_offset", graph->item_offset, (size_t)route_count);
+    write_ints(out, "int", "builtin_item_target", graph->item_target, (size_t)items);
+
+    size_t hops = (size_t)route_count * (size_t)route_count;
+    int *next_hop = malloc(hops * sizeof(int));
+    if (!next_hop) return;
+    for (size_t i = 0; i < hops; i++) next_hop[i] = graph->next_hop[i];
+    write_ints(out, "int16_t", "builtin_next_hop", next_hop, hops);
+    free(next_hop);
+
+    fprintf(out, "static const NavigationGraph builtin_graph = {%d, builtin_item_offset, builtin_item_target, "
+            "builtin_next_hop};\n\n", route_count);
+}
+
+static void write_tables(FILE *out, const RouteIndex *index, const NavigationGraph *graph, int items) {
+    fprintf(out, "// Generated by tools/routegen from %s; do not edit.\n", manifest_path);
+    fputs("#include \"../../include/route_index.h\"\n", out);
+    fputs("#include \"../../include/nav_graph.h\"\n\n", out);
+
+    for (int i = 0; i < route_count; i++) {
+        write_list(out, "buttons", i, &lists[i].buttons);
+        write_list(out, "actions", i, &lists[i].actions);
+        write_list(out, "patterns", i, &lists[i].patterns);
+    }
+
+    fputs("\nstatic const RouteGuide builtin_guides[] = {\n", out);
+    for (int i = 0; i < route_count; i++) {
+        const RouteGuide *guide = &guides[i];
+        fputs("    {{", out);
+        write_string(out, guide->navigation.route, (int)strlen(guide->navigation.route));
+        fputs(", ", out);
+        write_string(out, guide->navigation.user_role, (int)strlen(guide->navigation.user_role));
+        fputs(", ", out);
+        write_list_ref(out, "buttons", i, &lists[i].buttons);
+        fputs(", ", out);
+        write_list_ref(out, "actions", i, &lists[i].actions);
+        fputs("}, ", out);
+        write_list_ref(out, "patterns", i, &lists[i].patterns);
+        fprintf(out, ", 0x%08xu}%s\n", (unsigned)guide->hash, i + 1 < route_count ? "," : "");
+    }
+    fputs("};\n\nstatic const int builtin_next_guide[] = {", out);
+    for (int i = 0; i < route_count; i++) {
+        fprintf(out, "%s%d", i > 0 ? ", " : "", index->next_guide[i]);
+    }
+    fputs("};\n\nstatic const RouteNode builtin_nodes[] = {\n", out);
+    for (int i = 0; i < index->node_count; i++) {
+        const RouteNode *node = &index->nodes[i];
+        fputs("    {", out);
+        write_string(out, node->label, node->label_length);
+        fprintf(out, ", %d, %s, %d, %d, %d, %d}%s\n", node->label_length, node->param ? "true" : "false",
+                node->first_child, node->next_sibling, node->param_child, node->first_guide,
+                i + 1 < index->node_count ? "," : "");
+    }
+    fprintf(out, "};\n\nstatic const RouteIndex builtin_index = {builtin_guides, builtin_next_guide, builtin_nodes, %d};\n\n",
+            index->node_count);
+    write_graph(out, graph, items);
+
+    fputs("void load_builtin_routes(const RouteGuide **guides, int *count, const RouteIndex **index,\n", out);
+    fputs("                         const NavigationGraph **graph) {\n", out);
+    fputs("    *guides = builtin_guides;\n", out);
+    fputs("    *count = (int)(sizeof(builtin_guides) / sizeof(builtin_guides[0]));\n", out);
+    fputs("    *index = &builtin_index;\n", out);
+    fputs("    *graph = &builtin_graph;\n", out);
+    fputs("}\n", out);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <routes.manifest> <output.c>\n", argv[0]);
+        return 1;
+    }
+    manifest_path = argv[1];
+
+    FILE *file = fopen(manifest_path, "rb");
+    if (!file) {
+        fprintf(stderr, "Cannot open %s: %s\n", manifest_path, strerror(errno));
+        return 1;
+    }
+    char *text = malloc(MAX_MANIFEST + 1);
+    if (!text) {
+        fclose(file);
+        return 1;
+    }
+    size_t size = fread(text, 1, MAX_MANIFEST + 1, file);
+    fclose(file);
+    if (size > MAX_MANIFEST) {
+        fprintf(stderr, "%s is larger than 1MB\n", manifest_path);
+        return 1;
+    }
+    text[size] = '\0';
+
+    char *line = text;
+    while (line) {
+        char *newline = strchr(line, '\n');
+        if (newline) *newline = '\0';
+        line_number++;
+        if (!parse_line(line)) return 1;
+        line = newline ? newline + 1 : NULL;
+    }
+    if (route_count == 0 || lists[route_count - 1].buttons.count == 0) {
+        fail(route_count == 0 ? "no routes" : "last route needs buttons", NULL);
+        return 1;
+    }
+
+    int params = 0;
+    for (int i = 0; i < route_count; i++) params += route_params(guides[i].navigation.route);
+    void *memory = malloc(route_index_size(route_count, params));
+    if (!memory) return 1;
+    const RouteIndex *index = build_route_index(memory, guides, route_count);
+
+    int items = 0;
+    for (int i = 0; i < route_count; i++) {
+        guides[i].navigation.available_buttons = lists[i].buttons.items;
+        guides[i].navigation.button_count = lists[i].buttons.count;
+        guides[i].navigation.suggested_actions = lists[i].actions.items;
+        guides[i].navigation.action_count = lists[i].actions.count;
+        items += lists[i].buttons.count + lists[i].actions.count;
+    }
+    void *graph_memory = malloc(navigation_graph_size(route_count, items));
+    if (!graph_memory) return 1;
+    const NavigationGraph *graph = build_navigation_graph(graph_memory, guides, route_count);
+    if (!graph) return 1;
+
+    // Written aside and renamed, so a failed run never leaves half a table
+    char temp_path[4096];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", argv[2]);
+    FILE *out = fopen(temp_path, "w");
+    if (!out) {
+        fprintf(stderr, "Cannot create %s: %s\n", temp_path, strerror(errno));
+        return 1;
+    }
+    write_tables(out, index, graph, items);
+    if (fclose(out) != 0 || rename(temp_path, argv[2]) != 0) {
+        fprintf(stderr, "Cannot write %s: %s\n", argv[2], strerror(errno));
+        remove(temp_path);
+        return 1;
+    }
+    return 0;
+}